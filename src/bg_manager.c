@@ -45,6 +45,7 @@ static SDL_Rect    _loop1SrcRec,   _loop1DstRec;
 static SDL_Rect    _loop2SrcRec,   _loop2DstRec;
 static SDL_Rect    _floorSrcRec,   _floorDstRec;
 static SDL_Rect    _ceilingSrcRec, _ceilingDstRec;
+static SCE_CmdList _bgList;   // drawn from the VBLANK thread
 
 static int _rLayerFrmCount;
 static int _wLayerFrmCount;
@@ -73,6 +74,7 @@ static int InitLevel1();
 void BG_Init()
 {
   _scr = MM_GetScreenPtr();
+  SCE_ListStart(&_bgList, _scr);
 }
 
 //------------------------------------------------------------------------------
@@ -360,7 +362,7 @@ int BG_EndReached(float dir)
 // Outputs:  None
 // Returns:  None
 // Cautions: This function uses SCE functions to draw the background images so
-//           proper clipping is vital.
+//           proper clipping is vital.  The copies go to the GU as 1 list.
 //------------------------------------------------------------------------------
 void BG_DrawBackground()
 {
@@ -371,34 +373,19 @@ void BG_DrawBackground()
   //SCE_BlitSurface(_loopImg, &_loop1SrcRec, _scr, &_loop1DstRec);
   //SCE_BlitSurface(_loopImg, &_loop2SrcRec, _scr, &_loop2DstRec);
   
-  sceGuStart(GU_DIRECT, _SCEBgList);
-  sceGuCopyImage(GU_PSM_5551, _floorSrcRec.x, _floorSrcRec.y, 
-                 _floorSrcRec.w, _floorSrcRec.h, 
-                 _floorImg->w,  _floorImg->pixels, 
-                 _floorDstRec.x, _floorDstRec.y, 512, _scr->pixels);
-  
-  sceGuCopyImage(GU_PSM_5551, _ceilingSrcRec.x, _ceilingSrcRec.y, 
-                 _ceilingSrcRec.w, _ceilingSrcRec.h, 
-                 _ceilingImg->w,  _ceilingImg->pixels, 
-                 _ceilingDstRec.x, _ceilingDstRec.y, 512, _scr->pixels);
+  SCE_ListCopy(&_bgList, _floorImg,   &_floorSrcRec,   &_floorDstRec);
+  SCE_ListCopy(&_bgList, _ceilingImg, &_ceilingSrcRec, &_ceilingDstRec);
                               
   if (_loop1SrcRec.x >=0 && _loop1SrcRec.x <  MM_SCREEN_WIDTH &&
       _loop1SrcRec.w > 0 && _loop1SrcRec.w <= MM_SCREEN_WIDTH &&
       _loop1DstRec.x >=0 && _loop1DstRec.x <  MM_SCREEN_WIDTH)
-    sceGuCopyImage(GU_PSM_5551, _loop1SrcRec.x, _loop1SrcRec.y, 
-                  _loop1SrcRec.w, _loop1SrcRec.h, 
-                  _loopImg->w,   _loopImg->pixels, 
-                  _loop1DstRec.x, _loop1DstRec.y, 512, _scr->pixels);
+    SCE_ListCopy(&_bgList, _loopImg, &_loop1SrcRec, &_loop1DstRec);
                  
   if (_loop2SrcRec.x >=0 && _loop2SrcRec.x <  MM_SCREEN_WIDTH &&
       _loop2SrcRec.w > 0 && _loop2SrcRec.w <= MM_SCREEN_WIDTH &&
       _loop2DstRec.x >=0 && _loop2DstRec.x <  MM_SCREEN_WIDTH)
-    sceGuCopyImage(GU_PSM_5551, _loop2SrcRec.x, _loop2SrcRec.y, 
-                   _loop2SrcRec.w, _loop2SrcRec.h, 
-                   _loopImg->w,   _loopImg->pixels, 
-                   _loop2DstRec.x, _loop2DstRec.y, 512, _scr->pixels);
-  sceGuFinish();
-  sceGuSync(0,0);
+    SCE_ListCopy(&_bgList, _loopImg, &_loop2SrcRec, &_loop2DstRec);
+  SCE_ListFlush(&_bgList);
 }
 
 //------------------------------------------------------------------------------
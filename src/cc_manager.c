@@ -109,11 +109,10 @@ void CC_ConfigureControls(SDL_Event *event)
 
   // Load reources
   ZIP_OpenZipFile(ZIP_MAIN);
-  f1  = ZIP_LoadFont(ZIP_FONT2, 12);
+  f1  = ZIP_LoadFontStyle(ZIP_FONT2, 12, TTF_STYLE_BOLD);
   tmp = ZIP_LoadImage("logo_big.bmp");
   ZIP_CloseZipFile();
   
-  TTF_SetFontStyle(f1->f, TTF_STYLE_BOLD);
   // Convert background image to screen format
   bgImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE); 
   SDL_FreeSurface(tmp);
@@ -121,10 +120,8 @@ void CC_ConfigureControls(SDL_Event *event)
   // Create Labels for Actions (one for idle color, one for selected color)
   for (index = 0; index < NUM_ACTIONS; index++)
   {
-    actionToImg[0][index] = TTF_RenderText_Blended(f1->f, 
-                                                   actionToText[index], color1);
-    actionToImg[1][index] = TTF_RenderText_Blended(f1->f, 
-                                                   actionToText[index], color2);
+    actionToImg[0][index] = ZIP_RenderText(f1, actionToText[index], color1);
+    actionToImg[1][index] = ZIP_RenderText(f1, actionToText[index], color2);
     if (actionToImg[0][index]->w > lineSpace)
     {
       lineSpace = actionToImg[0][index]->w;
@@ -135,25 +132,17 @@ void CC_ConfigureControls(SDL_Event *event)
   // Create Labels for Buttons
   for (index = 0; index < NUM_BUTTONS; index++)
   {
-    btnToImg[0][index] = TTF_RenderText_Blended(f1->f, 
-                                                btnToText[index], color1);
-    btnToImg[1][index] = TTF_RenderText_Blended(f1->f, 
-                                                btnToText[index], color2);
+    btnToImg[0][index] = ZIP_RenderText(f1, btnToText[index], color1);
+    btnToImg[1][index] = ZIP_RenderText(f1, btnToText[index], color2);
   }
   
   // Create Description Labels
-  resDefImg[0]  = 
-    TTF_RenderText_Blended(f1->f, "Restore Defaults", color1);
-  resDefImg[1]  = 
-    TTF_RenderText_Blended(f1->f, "Restore Defaults", color2);
-  ExitSave[0]   = 
-    TTF_RenderText_Blended(f1->f, "Exit (Save Changes)", color1);
-  ExitSave[1]   = 
-    TTF_RenderText_Blended(f1->f, "Exit (Save Changes)", color2);
-  ExitNoSave[0] = 
-    TTF_RenderText_Blended(f1->f, "Exit (Discard Changes)", color1);
-  ExitNoSave[1] = 
-    TTF_RenderText_Blended(f1->f, "Exit (Discard Changes)", color2);
+  resDefImg[0]  = ZIP_RenderText(f1, "Restore Defaults", color1);
+  resDefImg[1]  = ZIP_RenderText(f1, "Restore Defaults", color2);
+  ExitSave[0]   = ZIP_RenderText(f1, "Exit (Save Changes)", color1);
+  ExitSave[1]   = ZIP_RenderText(f1, "Exit (Save Changes)", color2);
+  ExitNoSave[0] = ZIP_RenderText(f1, "Exit (Discard Changes)", color1);
+  ExitNoSave[1] = ZIP_RenderText(f1, "Exit (Discard Changes)", color2);
   
   // Read controller data from file and verify it's valid.  Default values
   // will be returned if a controler configuration file does not exist
@@ -308,23 +297,23 @@ void CC_ConfigureControls(SDL_Event *event)
   // Free ALL SDL Surfaces
   for (index = 0; index < NUM_ACTIONS; index++)
   {
-    SDL_FreeSurface(actionToImg[0][index]);
-    SDL_FreeSurface(actionToImg[1][index]);
+    ZIP_ReleaseText(actionToImg[0][index]);
+    ZIP_ReleaseText(actionToImg[1][index]);
   }
 
   for (index = 0; index < NUM_BUTTONS; index++)
   {
-    SDL_FreeSurface(btnToImg[0][index]);
-    SDL_FreeSurface(btnToImg[1][index]);
+    ZIP_ReleaseText(btnToImg[0][index]);
+    ZIP_ReleaseText(btnToImg[1][index]);
   }
   
   SDL_FreeSurface(bgImg);
-  SDL_FreeSurface(resDefImg[0]);
-  SDL_FreeSurface(resDefImg[1]);
-  SDL_FreeSurface(ExitSave[0]);
-  SDL_FreeSurface(ExitSave[1]);
-  SDL_FreeSurface(ExitNoSave[0]);
-  SDL_FreeSurface(ExitNoSave[1]);
+  ZIP_ReleaseText(resDefImg[0]);
+  ZIP_ReleaseText(resDefImg[1]);
+  ZIP_ReleaseText(ExitSave[0]);
+  ZIP_ReleaseText(ExitSave[1]);
+  ZIP_ReleaseText(ExitNoSave[0]);
+  ZIP_ReleaseText(ExitNoSave[1]);
   
   ZIP_CloseFont(f1);
 }
@@ -516,9 +505,8 @@ void DrawWarning(char *txt, ZIP_Font *f1)
   
   sprintf(&buffer[0], "Please provide the [%s]", txt);
   
-  txt1Img = TTF_RenderText_Blended(f1->f, buffer, fgColor);
-  txt2Img = TTF_RenderText_Blended(f1->f, 
-                                   "action with a valid value.", fgColor);
+  txt1Img = ZIP_RenderText(f1, buffer, fgColor);
+  txt2Img = ZIP_RenderText(f1, "action with a valid value.", fgColor);
 
   // Determine width of rectangle based on width of logest text string
   if ( txt1Img->w > txt2Img->w)
@@ -552,8 +540,8 @@ void DrawWarning(char *txt, ZIP_Font *f1)
   sceDisplayWaitVblankStart();
   SDL_Flip(_scr);  
   
-  SDL_FreeSurface(txt1Img);
-  SDL_FreeSurface(txt2Img);
+  ZIP_ReleaseText(txt1Img);
+  ZIP_ReleaseText(txt2Img);
   
   // wait 3 seconds
   SDL_Delay(3000);
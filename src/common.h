@@ -40,6 +40,8 @@ SDL_Surface* MM_GetScreenPtr();
 void         MM_PressAnyKeyToContinue(SDL_Event *event);
 int          MM_Abs(int val);
 void         MM_TakeMenuScreenshot();
+unsigned int MM_GetMicroSeconds();
+int          MM_IsScreenFormat(SDL_Surface *s);
 
 //  Button Values
 //  0 Triangle
@@ -9,15 +9,71 @@
 //  sprites to be draw on screen in the proper order so that their overlapping
 //  behavior can be controlled.  All sprites used in the Power, Hero,& Sprite
 //  manager classes are added to this list and drawn from here
+//
+//  Nodes that share a key form a run in the list.  The last node of each run
+//  is kept in a small table of buckets sorted by key, so a sprite is added
+//  right after the last node of its run instead of walking the list from the
+//  head to find its place.
+//
+//  The list is walked with DL_Iterator objects owned by whoever is walking 
+//  it, so drawing, screenshots & any other thread can each walk the list at
+//  the same time as the game adds & removes sprites.  Every iterator in use 
+//  is kept on a list of its own so DL_Remove can move it off a node that is
+//  being removed.  Links are only changed or followed while holding the 
+//  list's lock.
 //-----------------------------------------------------------------------------
 
 
+#include <stdlib.h>
+#include <string.h>
+#include "SDL/SDL_mutex.h"
 #include "dl_manager.h"
 
+#define MAX_BUCKETS 32    // distinct keys in the list that get a bucket
+
+#ifdef MM_PROFILE
+#define PROFILE_MAX_NODES 5000
+#define PROFILE_KEYS      12
+#endif
+
+// The run of nodes in the list that have the same key
+typedef struct DL_Bucket
+{
+  float key;
+  DL_LinkedListNode *last;  // last node with this key, new ones go after it
+} DL_Bucket;
+
+#ifdef MM_PROFILE
+// Node used by the benchmark, remembers the order it was added in
+typedef struct ProfileNode
+{
+  DL_LinkedListNode node;
+  int order;
+} ProfileNode;
+#endif
+
 // Private data
 static DL_LinkedListNode _head;
 static DL_LinkedListNode _tail;
-static DL_LinkedListNode *_curPtr;
+static DL_Iterator *_iterators;         // iterators in use
+static DL_Bucket _buckets[MAX_BUCKETS];  // sorted by key, small keys first
+static int       _numBuckets;
+static SDL_mutex *_listLock;            // guards links, buckets & iterators
+
+#ifdef MM_PROFILE
+// keys the game uses, tents step down from 5.5, hero is 11, meter is 11.1
+static const float _profileKeys[PROFILE_KEYS] = 
+  { 1, 5.0, 5.1, 5.2, 5.3, 5.4, 5.5, 6.0, 11, 11.1, 11.2, 11.5 };
+static int _profileDrawn;
+#endif
+
+static int FindBucket(float key, int *index);
+
+#ifdef MM_PROFILE
+static void LinearAdd(DL_LinkedListNode *s);
+static int  CheckOrder(int count);
+static int  ProfileDraw(void *s);
+#endif
 
 
 //-----------------------------------------------------------------------------
@@ -31,13 +87,22 @@ static DL_LinkedListNode *_curPtr;
 //-----------------------------------------------------------------------------
 void DL_Init()
 {
-  _curPtr    = &_head;  // set current pointer to head
+  DL_Iterator *it;
+  
+  if (!_listLock)
+    _listLock = SDL_CreateMutex();
+    
+  SDL_mutexP(_listLock);
+  for (it=_iterators; it; it = it->nextIter)
+    it->cur = &_head;   // iterators in use start over on the empty list
   _head.prev = 0;       // head's previous is set to null
   _tail.next = 0;       // tail's next is set to null
   _head.next = &_tail;  // initialy head points to tail
   _tail.prev = &_head;  // and tail points to head
   _head.key  = 0;       // head gets small value, no smaller keys may exist
   _tail.key  = 1000000; // tail gets big value, bo bigger keys may exist
+  _numBuckets = 0;      // no runs of keys yet
+  SDL_mutexV(_listLock);
 }
 
 int DL_InitLevel(unsigned int level)
@@ -57,81 +122,171 @@ int DL_InitLevel(unsigned int level)
 // Cautions: Passed in structre need not be of type DL_LinkedListNode.  It IS
 //           required that the first 3 elements of the passed in structre be 
 //           the exact same 3 elements that appear in the DL_LinkedListNode 
-//           structure).
+//           structure).  The key of a node must not be changed while it is
+//           in the list, remove it & add it again instead.
 //-----------------------------------------------------------------------------
 void DL_Add(DL_LinkedListNode *s)
 {
-  DL_LinkedListNode *tmp = _head.next;
+  DL_LinkedListNode *tmp;
+  int index;
+  
+  SDL_mutexP(_listLock);
   
   // NOTE: the key value of the current node is used to determined the node's
   // value, I.E. where it gets inserted into the list.
-  // Search list for first node that is bigger or equal to node we are adding.
   // Small numbers get placed at head of list.  If new node is equal to an 
   // existing node (or series of nodes), the new node will be placed as the
   // last one in the list.  
-  while (s->key >= tmp->key)
+  if (FindBucket(s->key, &index))
   {
-    tmp = tmp->next;
+    // key is allready in the list, new node goes at the end of its run
+    tmp                  = _buckets[index].last;
+    _buckets[index].last = s;
+  }
+  else
+  {
+    // new key, goes after the run of the next smaller key
+    tmp = index > 0 ? _buckets[index-1].last : &_head;
+    if (_numBuckets < MAX_BUCKETS)
+    {
+      memmove(&_buckets[index+1], &_buckets[index], 
+              (_numBuckets - index) * sizeof(DL_Bucket));
+      _buckets[index].key  = s->key;
+      _buckets[index].last = s;
+      _numBuckets++;
+    }
+    
+    // when the buckets run out, keys without 1 are found by walking the 
+    // nodes between the buckets
+    while (((DL_LinkedListNode *) tmp->next)->key <= s->key)
+      tmp = tmp->next;
   }
   
   // arrange pointers of new node and the prev/next nodes
-  s->next   = tmp;
-  s->prev   = tmp->prev;
-  tmp->prev = s;
-  tmp       = s->prev;
+  s->prev   = tmp;
+  s->next   = tmp->next;
   tmp->next = s;
+  tmp       = s->next;
+  tmp->prev = s;
+  
+  SDL_mutexV(_listLock);
 }  
 
-//-----------------------------------------------------------------------------
-// Name:     DL_Next
-// Summary:  Points Iterator to the next element in the linked list
-// Inputs:   None
-// Outputs:  None
-// Returns:  0 if end of list is reached (I.E. no more data), 1 otherwise.
-// Cautions: When end of list is reached, iterator is set to head of list. 
-//           Thus, DL_Next must be called to set it to 1st element in list.
 //-----------------------------------------------------------------------------
-int DL_Next()
+// Name:     FindBucket
+// Summary:  Binary search of the buckets for a key
+// Inputs:   Key to find
+// Outputs:  index - index of key's bucket if found, else the index a bucket
+//           for it would be inserted at
+// Returns:  1 if the key has a bucket, 0 if not
+// Cautions: None
+//-----------------------------------------------------------------------------
+int FindBucket(float key, int *index)
 {
-  int ret             = 0;
-  DL_LinkedListNode *tmp = _curPtr;
-  if (tmp->next == &_tail)  // end of list is reached, reset list
+  int low  = 0;
+  int high = _numBuckets;
+  int mid;
+  
+  while (low < high)
   {
-    DL_ResetCurrentToStart();
-    ret = 0;
+    mid = (low + high) / 2;
+    if (_buckets[mid].key < key)
+      low = mid + 1;
+    else
+      high = mid;
   }
-  else  // not at end of list, simply move to next element
+  *index = low;
+  return(low < _numBuckets && _buckets[low].key == key);
+}
+
+//-----------------------------------------------------------------------------
+// Name:     DL_IterStart
+// Summary:  Points an iterator at the head/start of the list & puts it on the
+//           list of iterators in use
+// Inputs:   Iterator
+// Outputs:  None
+// Returns:  None
+// Cautions: DL_IterEnd must be called when done with the iterator, before it
+//           goes out of scope.  DL_IterNext must be called to move from head
+//           to 1st element in list.
+//-----------------------------------------------------------------------------
+void DL_IterStart(DL_Iterator *it)
+{
+  SDL_mutexP(_listLock);
+  it->cur      = &_head;
+  it->nextIter = _iterators;
+  _iterators   = it;
+  SDL_mutexV(_listLock);
+}
+
+//-----------------------------------------------------------------------------
+// Name:     DL_IterNext
+// Summary:  Moves an iterator to the next element in the list
+// Inputs:   Iterator
+// Outputs:  None
+// Returns:  The next element, 0 if end of list is reached (I.E. no more data)
+// Cautions: Once the end is reached the iterator stays there, DL_IterStart
+//           it again to walk the list again
+//-----------------------------------------------------------------------------
+void *DL_IterNext(DL_Iterator *it)
+{
+  DL_LinkedListNode *ret = 0;
+  
+  SDL_mutexP(_listLock);
+  if (it->cur->next != &_tail)  // not at end of list, move to next element
   {
-    _curPtr = tmp->next;
-    ret = 1;
+    it->cur = it->cur->next;
+    ret     = it->cur;
   }
+  SDL_mutexV(_listLock);
   return(ret);
 }
 
 //-----------------------------------------------------------------------------
-// Name:     DL_ResetCurrentToStart
-// Summary:  Points Iterator to head/start of linked list
-// Inputs:   None
+// Name:     DL_IterEnd
+// Summary:  Takes an iterator off the list of iterators in use
+// Inputs:   Iterator
 // Outputs:  None
 // Returns:  None
-// Cautions: DL_Next must be called to move from head to 1st element in list.
+// Cautions: None
 //-----------------------------------------------------------------------------
-void DL_ResetCurrentToStart()
+void DL_IterEnd(DL_Iterator *it)
 {
-  _curPtr = &_head;
+  DL_Iterator **tmp;
+  
+  SDL_mutexP(_listLock);
+  for (tmp=&_iterators; *tmp; tmp = &(*tmp)->nextIter)
+  {
+    if (*tmp == it)
+    {
+      *tmp = it->nextIter;
+      break;
+    }
+  }
+  SDL_mutexV(_listLock);
 }
 
 //-----------------------------------------------------------------------------
-// Name:     DL_GetCurrentData
-// Summary:  Returns the data stored at the current node in the list
-// Inputs:   None
-// Outputs:  None
-// Returns:  0 on failure or no data, an address to the data on success
-// Cautions: None
+// Name:     DL_Snapshot
+// Summary:  Copies the elements of the list, in draw order, into an array
+// Inputs:   1. nodes - array to copy into
+//           2. max - size of array
+// Outputs:  nodes - the elements of the list
+// Returns:  Number of elements copied
+// Cautions: The order is what it was when the snapshot was taken, the 
+//           elements themselves are not copied and may be removed from the
+//           list (and re-used) afterwards
 //-----------------------------------------------------------------------------
-void *DL_GetCurrentData()
+int DL_Snapshot(DL_LinkedListNode **nodes, int max)
 {
-  return(_curPtr); 
+  DL_LinkedListNode *tmp;
+  int count = 0;
+  
+  SDL_mutexP(_listLock);
+  for (tmp=_head.next; tmp != &_tail && count < max; tmp = tmp->next)
+    nodes[count++] = tmp;
+  SDL_mutexV(_listLock);
+  return(count);
 }
 
 //-----------------------------------------------------------------------------
@@ -140,22 +295,44 @@ void *DL_GetCurrentData()
 // Inputs:   Pointer to node that must be removed
 // Outputs:  None
 // Returns:  0 on success, non zero on failure
-// Cautions: If current node is the node being removed, the list iterator 
-//           (_curPtr) will be moved back 1, to the elemnt immedaitly before
-//           it in the list.  If this is the head, LL_Next must be called to 
-//           get the 1st element in the adjusted list.
+// Cautions: Any iterator on the node being removed will be moved back 1, to
+//           the elemnt immedaitly before it in the list.  If this is the 
+//           head, DL_IterNext must be called to get the 1st element in the 
+//           adjusted list.
 //-----------------------------------------------------------------------------
 void DL_Remove(DL_LinkedListNode *cur)
 {
-  // adjust Iterator if the node it points to is being removed
-  if (_curPtr == cur)
-    _curPtr = cur->prev;
+  DL_Iterator *it;
+  int index;
+  
+  SDL_mutexP(_listLock);
+  
+  // adjust Iterators if the node they point to is being removed
+  for (it=_iterators; it; it = it->nextIter)
+    if (it->cur == cur)
+      it->cur = cur->prev;
   
   // re-position pointers of current node's next and previous nodes
   // to each other
   DL_LinkedListNode *prevNode = cur->prev;
   DL_LinkedListNode *nextNode = cur->next;
   
+  // if this is the last node of its run, the run now ends at the node before
+  // it, or is gone if that node has a different key
+  if (nextNode && FindBucket(cur->key, &index) && _buckets[index].last == cur)
+  {
+    if (prevNode != &_head && prevNode->key == cur->key)
+    {
+      _buckets[index].last = prevNode;
+    }
+    else
+    {
+      _numBuckets--;
+      memmove(&_buckets[index], &_buckets[index+1], 
+              (_numBuckets - index) * sizeof(DL_Bucket));
+    }
+  }
+  
   // verify a previous and next node pointer exist 
   // if we attempt to remove the same element 2X this problem could occur
   if (prevNode)
@@ -166,6 +343,8 @@ void DL_Remove(DL_LinkedListNode *cur)
   cur->prev = 0;
   cur->next = 0;
   cur->key  = 5;
+  
+  SDL_mutexV(_listLock);
 }
 
 //-----------------------------------------------------------------------------
@@ -188,15 +367,196 @@ void DL_ClearList()
 // Inputs:   None
 // Outputs:  None
 // Returns:  None
-// Cautions: None
+// Cautions: The list's lock is not held while a sprite is drawn, sprites
+//           may be added & removed while the list is being drawn
 //-----------------------------------------------------------------------------
 void  DL_DrawImages()
 {
   DL_LinkedListNode *s;
-  while (DL_Next())
+  DL_Iterator it;
+  
+  DL_IterStart(&it);
+  while ((s = DL_IterNext(&it)))
   {
-    s = DL_GetCurrentData();
     s->DrawImage((void*)s);
   }
+  DL_IterEnd(&it);
 }
 
+#ifdef MM_PROFILE
+//-----------------------------------------------------------------------------
+// Name:     DL_ProfileDrawList
+// Summary:  Benchmark & self check, adds 50, 500 & 5000 nodes with the keys
+//           the game uses, draws them, removes & re-adds half of them, then
+//           removes them all, and reports the time taken by each step along 
+//           with the time walking the list from the head used to take
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Clears the draw list, call before a level is started
+//-----------------------------------------------------------------------------
+void DL_ProfileDrawList()
+{
+  static const int counts[] = { 50, 500, 5000 };
+  ProfileNode *nodes, *p;
+  DL_Iterator it;
+  unsigned int seed, walk, add, draw, remove;
+  int bad, c, x, count, kept;
+  
+  nodes = malloc(PROFILE_MAX_NODES * sizeof(ProfileNode));
+  if (!nodes)
+    return;
+    
+  for (c=0; c < sizeof(counts) / sizeof(counts[0]); c++)
+  {
+    count = counts[c];
+    seed  = 12345;
+    bad   = 0;
+    for (x=0; x < count; x++)
+    {
+      seed                     = seed * 1103515245 + 12345;
+      nodes[x].node.key        = _profileKeys[(seed >> 16) % PROFILE_KEYS];
+      nodes[x].node.DrawImage  = ProfileDraw;
+      nodes[x].order           = x;
+    }
+    
+    // the way nodes used to be added, for comparison
+    DL_ClearList();
+    walk = MM_GetMicroSeconds();
+    for (x=0; x < count; x++)
+      LinearAdd(&nodes[x].node);
+    walk = MM_GetMicroSeconds() - walk;
+    bad += CheckOrder(count);
+    
+    DL_ClearList();
+    add = MM_GetMicroSeconds();
+    for (x=0; x < count; x++)
+      DL_Add(&nodes[x].node);
+    add = MM_GetMicroSeconds() - add;
+    bad += CheckOrder(count);
+    
+    _profileDrawn = 0;
+    draw = MM_GetMicroSeconds();
+    DL_DrawImages();
+    draw = MM_GetMicroSeconds() - draw;
+    if (_profileDrawn != count)
+      bad++;
+    
+    // take out every other node while walking the list & put it back, it
+    // must go to the end of its run just like a newly created sprite
+    kept = 0;
+    DL_IterStart(&it);
+    while ((p = DL_IterNext(&it)))
+    {
+      if (p->order % 2)
+        DL_Remove(&p->node);
+      else
+        kept++;
+    }
+    DL_IterEnd(&it);
+    if (kept != count - count / 2)
+      bad++;
+    bad += CheckOrder(count - count / 2);
+    for (x=1; x < count; x += 2)
+    {
+      nodes[x].node.key = _profileKeys[x % PROFILE_KEYS];
+      nodes[x].order    = count + x;
+      DL_Add(&nodes[x].node);
+    }
+    bad += CheckOrder(count);
+    
+    // remove in a scattered order, 7919 is a prime so every node is hit
+    remove = MM_GetMicroSeconds();
+    for (x=0; x < count; x++)
+      DL_Remove(&nodes[(x * 7919) % count].node);
+    remove = MM_GetMicroSeconds() - remove;
+    if (_head.next != &_tail || _tail.prev != &_head || _numBuckets != 0)
+      bad++;
+      
+    EH_Error(EH_DEBUG, "DL %d nodes: add %uus (walk %uus), draw %uus, "
+             "remove %uus%s\n", count, add, walk, draw, remove, 
+             bad ? ", CHECK FAILED" : "");
+  }
+  
+  free(nodes);
+  DL_ClearList();
+}
+
+//-----------------------------------------------------------------------------
+// Name:     LinearAdd
+// Summary:  Adds a node by walking the list from the head, the way DL_Add 
+//           did before the buckets
+// Inputs:   Node to add
+// Outputs:  None
+// Returns:  None
+// Cautions: Does not keep the buckets, only for timing against DL_Add
+//-----------------------------------------------------------------------------
+void LinearAdd(DL_LinkedListNode *s)
+{
+  DL_LinkedListNode *tmp = _head.next;
+  
+  while (s->key >= tmp->key)
+  {
+    tmp = tmp->next;
+  }
+  s->next   = tmp;
+  s->prev   = tmp->prev;
+  tmp->prev = s;
+  tmp       = s->prev;
+  tmp->next = s;
+}
+
+//-----------------------------------------------------------------------------
+// Name:     CheckOrder
+// Summary:  Checks the benchmark's nodes are sorted by key, nodes with equal
+//           keys in the order they were added, & that every bucket points
+//           at the last node of its run
+// Inputs:   Number of nodes that should be in the list
+// Outputs:  None
+// Returns:  0 if the list is in order, 1 if not
+// Cautions: None
+//-----------------------------------------------------------------------------
+int CheckOrder(int count)
+{
+  DL_LinkedListNode *tmp;
+  ProfileNode *p, *prev = 0;
+  int found = 0;
+  int x;
+  
+  for (tmp=_head.next; tmp != &_tail; tmp = tmp->next)
+  {
+    p = (ProfileNode *) tmp;
+    if (prev && (prev->node.key > p->node.key || 
+        (prev->node.key == p->node.key && prev->order > p->order)))
+      return(1);
+    if (tmp->next && ((DL_LinkedListNode *) tmp->next)->prev != tmp)
+      return(1);
+    prev = p;
+    found++;
+  }
+  
+  for (x=0; x < _numBuckets; x++)
+  {
+    tmp = _buckets[x].last;
+    if (tmp->key != _buckets[x].key || 
+        ((DL_LinkedListNode *) tmp->next)->key == tmp->key ||
+        (x > 0 && _buckets[x-1].key >= _buckets[x].key))
+      return(1);
+  }
+  return(found != count);
+}
+
+//-----------------------------------------------------------------------------
+// Name:     ProfileDraw
+// Summary:  Draw function of the benchmark's nodes, counts the nodes drawn
+// Inputs:   Node
+// Outputs:  None
+// Returns:  0
+// Cautions: None
+//-----------------------------------------------------------------------------
+int ProfileDraw(void *s)
+{
+  _profileDrawn++;
+  return(0);
+}
+#endif
@@ -11,16 +11,28 @@ typedef struct DL_LinkedListNode
   MM_DrawImageFunction DrawImage;
 } DL_LinkedListNode;
 
+// Walks the draw list, each caller walking the list has its own
+typedef struct DL_Iterator
+{
+  DL_LinkedListNode  *cur;
+  struct DL_Iterator *nextIter;  // next iterator in use
+} DL_Iterator;
+
 
 // Public
 void DL_Init();
 int  DL_InitLevel(unsigned int level);
 void DL_ClearList();
 void DL_Remove(DL_LinkedListNode *cur);
-void *DL_GetCurrentData();
-void DL_ResetCurrentToStart();
 void DL_Add(DL_LinkedListNode *s);
-int  DL_Next();
+void DL_IterStart(DL_Iterator *it);
+void *DL_IterNext(DL_Iterator *it);
+void DL_IterEnd(DL_Iterator *it);
+int  DL_Snapshot(DL_LinkedListNode **nodes, int max);
 void DL_DrawImages();
 
+#ifdef MM_PROFILE
+void DL_ProfileDrawList();
+#endif
+
 #endif
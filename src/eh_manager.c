@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include "eh_manager.h"
 #include "zip_manager.h"
+#include "text_manager.h"
 #include "common.h"
 
 
@@ -26,6 +27,7 @@
 #define printf(args...) pspDebugScreenPrintf(args)
 
 #define MAX_BUFFER_SIZE 500
+#define MAX_LINES        32
 
 static SDL_Surface  *_scr;
 static char _buffer[MAX_BUFFER_SIZE];
@@ -33,7 +35,7 @@ static int _dataFlag;
 static SDL_Color _fgColor = {255,0,0};
 static SDL_Color _bgColor = {0,0,0};
 static int _init          = 0;
-static ZIP_Font  *_font;
+static TXT_Atlas *_atlas;
 
 //------------------------------------------------------------------------------
 // Name:     EH_Init
@@ -49,7 +51,7 @@ void EH_Init()
   _buffer[0] = 0; 
   _dataFlag  = 0;
   ZIP_OpenZipFile(ZIP_MAIN);
-  _font      = ZIP_LoadFont(ZIP_FONT1, 12);
+  _atlas     = TXT_GetAtlas(ZIP_FONT1, 12, TTF_STYLE_NORMAL, _fgColor);
   ZIP_CloseZipFile();
   _init      = 1;
 }
@@ -124,16 +126,11 @@ void EH_Error(int severity, const char *format, ...)
 //------------------------------------------------------------------------------
 void EH_DrawErrors()
 {
-  int i, w, h;
-  int lastSpace  = 0;
-  int start      = 0;
-  char *p        = _buffer;
-  SDL_Surface *s   = 0;
-  SDL_Surface *tmp = 0;
-  int length     = strlen(_buffer);
-  SDL_Rect dst   = { 0, 0, 0,0 };
+  TXT_Line lines[MAX_LINES];
+  SDL_Rect bg = { 0, 0, 0, 0 };
+  int i, count;
   
-  if (_init == 0)
+  if (_init == 0 || _atlas == 0)
   {
     pspDebugScreenClear();
     pspDebugScreenSetXY(0,0);
@@ -150,75 +147,20 @@ void EH_DrawErrors()
     _dataFlag = 0;
   }
   
-  for (i=0; i < length+1; i++)
+  count = TXT_WrapText(_atlas, _buffer, MM_SCREEN_WIDTH, lines, MAX_LINES);
+  if (count > MAX_LINES)
+    count = MAX_LINES;
+  
+  // fill a box behind each line, as TTF_RenderText_Shaded did
+  bg.h = TXT_GetHeight(_atlas);
+  for (i=0; i < count; i++)
   {
-    if (p[i] == ' ')  // break sentance on spaces
-    {
-      p[i] = 0;  // set end of string to current space
-      // get length of current string
-      TTF_SizeText(_font->f, &p[start], &w, &h); 
-      p[i] = ' '; // turn null back into space
-      // if string is too long, print what we have so far
-      if (w > MM_SCREEN_WIDTH) 
-      {
-        // Special check for cases where > SW consecutive characters appear
-        if (lastSpace<start) lastSpace = i;
-        // find last space that did NOT make the string too long
-        p[lastSpace] = 0; 
-        s = TTF_RenderText_Shaded(_font->f, &p[start], _fgColor, _bgColor);
-        start = lastSpace+1; // set new start of screen to the very next space
-      }
-      lastSpace = i; // allways set the last space to the last space seen
-    }
-    else if (p[i] == '\n') // handle newlines
-    {
-      p[i] = 0; // set end of string to curent newline
-      TTF_SizeText(_font->f, &p[start], &w, &h);
-      p[i] = '\n'; // set back to newline
-      if (w > MM_SCREEN_WIDTH) // if string is to long
-      {
-        // Special check for cases where > SW consecutive characters appear
-        if (lastSpace<start) lastSpace = i;
-        p[lastSpace] = 0;  // find previous space before newline.  
-        s = TTF_RenderText_Shaded(_font->f, &p[start], _fgColor, _bgColor);
-        start = lastSpace+1; // set new string start position
-        // Set string index back 1 so newline will be processed again
-        if (lastSpace != i) i--; 
-      }
-      else // string was not to long
-      {
-        p[i] = 0; // set null temrinator to where newline is and print string
-        s = TTF_RenderText_Shaded(_font->f, &p[start], _fgColor, _bgColor);
-        start = i+1; // set new start position
-      }
-    }
-    else if (p[i] == 0)  // if end of string is reached...
-    {
-      TTF_SizeText(_font->f, &p[start], &w, &h);
-      // if to long, print from start to previous space
-      if (w > MM_SCREEN_WIDTH)  
-      {
-        // Special check for cases where > SW consecutive characters appear
-        if (lastSpace<start) lastSpace = i;
-        p[lastSpace] = 0;
-        s = TTF_RenderText_Shaded(_font->f, &p[start], _fgColor, _bgColor);
-        start = i = lastSpace+1;
-      }
-      else  // if not to long, just print what is left
-        s = TTF_RenderText_Shaded(_font->f, &p[start], _fgColor, _bgColor);
-    }
-    
-    // draw only when there is something to draw
-    if (s && s->w > 0)
-    {
-      tmp = SDL_ConvertSurface(s, _scr->format, SDL_SWSURFACE);
-      SDL_BlitSurface(tmp, 0, _scr, &dst);
-      SDL_FreeSurface(tmp);
-      SDL_FreeSurface(s);
-      s = 0;
-      dst.y += h; // move down to next line
-    }
+    bg.w = lines[i].w;
+    SDL_FillRect(_scr, &bg, SDL_MapRGB(_scr->format, _bgColor.r, _bgColor.g,
+                                       _bgColor.b));
+    bg.y += bg.h;
   }
+  TXT_DrawLines(_atlas, _buffer, lines, count, _scr, 0, 0, 0);
   _buffer[0] = 0;
 }
 
@@ -16,6 +16,7 @@
 #include "resource_manager.h"
 #include "dl_manager.h"
 #include "sprite_manager.h"
+#include "sce_graphics.h"
 
 // Private Functions
 static void  UpdateHeroDeathSequence();
@@ -1136,11 +1137,10 @@ int DrawHero(void *hv)
   if ( _hero.show )
   { 
     sprRec.y = _hero.curImgFrm;
-    status   = SDL_BlitSurface(_hero.curImg, &sprRec, _scr, &scrRec);      
+    status   = SCE_Blit(_hero.curImg, &sprRec, &scrRec);      
   
     if (_hero.hasWeapon)
-      status = SDL_BlitSurface(_hero.weaponImg, &_hero.wSrcRec, 
-                               _scr,            &_hero.wDstRec);
+      status = SCE_Blit(_hero.weaponImg, &_hero.wSrcRec, &_hero.wDstRec);
   }
  
   return(status);
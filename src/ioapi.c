@@ -13,6 +13,21 @@
 #include "zlib.h"
 #include "ioapi.h"
 
+#if defined(unix) || defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define USE_MMAP
+#endif
+
+/* Largest archive the memory backend will read into a malloc'ed block where
+   mmap does not exist.  Bigger archives are refused (so they are read with
+   stdio), they would take too much of the heap. */
+#ifndef MEM_FILEFUNC_MAX_SIZE
+#define MEM_FILEFUNC_MAX_SIZE (8 * 1024 * 1024)
+#endif
+
 
 
 /* I've found an old Unix (a SunOS 4.1.3_U1) without all SEEK_* defined.... */
@@ -175,3 +190,292 @@ void fill_fopen_filefunc (pzlib_filefunc_def)
     pzlib_filefunc_def->zerror_file = ferror_file_func;
     pzlib_filefunc_def->opaque = NULL;
 }
+
+
+/* Memory backend.  The whole archive is mapped (or, where mmap does not
+   exist, read) into memory 1 time, and reads/seeks/tells become pointer
+   arithmetic on that block.  Each mapping is shared by every stream opened
+   on the same filename and is released when the last stream is closed. */
+
+typedef struct mem_archive_s
+{
+    struct mem_archive_s* next;
+    char*          filename;
+    unsigned char* base;
+    uLong          size;
+    int            refcount;
+} mem_archive;
+
+typedef struct mem_stream_s
+{
+    mem_archive* archive;
+    uLong        pos;
+    int          error;
+} mem_stream;
+
+static mem_archive* mem_archive_list = NULL;
+
+static mem_archive* mem_map_archive OF((const char* filename));
+static void mem_unmap_archive OF((mem_archive* archive));
+
+voidpf ZCALLBACK mem_open_file_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK mem_read_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK mem_write_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK mem_tell_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK mem_seek_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK mem_close_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK mem_error_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+
+static mem_archive* mem_map_archive (filename)
+   const char* filename;
+{
+    mem_archive* archive;
+    unsigned char* base = NULL;
+    uLong size = 0;
+#ifdef USE_MMAP
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+    {
+        size = (uLong)st.st_size;
+        base = (unsigned char*)mmap(NULL, (size_t)size, PROT_READ,
+                                    MAP_PRIVATE, fd, 0);
+        if (base == (unsigned char*)MAP_FAILED)
+            base = NULL;
+    }
+    close(fd);
+#else
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+        return NULL;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        long end = ftell(file);
+        if ((end > 0) && (end <= MEM_FILEFUNC_MAX_SIZE))
+        {
+            size = (uLong)end;
+            base = (unsigned char*)malloc((size_t)size);
+        }
+    }
+    if ((base != NULL) &&
+        ((fseek(file, 0, SEEK_SET) != 0) ||
+         (fread(base, 1, (size_t)size, file) != (size_t)size)))
+    {
+        free(base);
+        base = NULL;
+    }
+    fclose(file);
+#endif
+    if (base == NULL)
+        return NULL;
+
+    archive = (mem_archive*)malloc(sizeof(mem_archive));
+    if (archive != NULL)
+        archive->filename = (char*)malloc(strlen(filename) + 1);
+    if ((archive == NULL) || (archive->filename == NULL))
+    {
+#ifdef USE_MMAP
+        munmap(base, (size_t)size);
+#else
+        free(base);
+#endif
+        free(archive);
+        return NULL;
+    }
+    strcpy(archive->filename, filename);
+    archive->base     = base;
+    archive->size     = size;
+    archive->refcount = 0;
+    archive->next     = mem_archive_list;
+    mem_archive_list  = archive;
+    return archive;
+}
+
+static void mem_unmap_archive (archive)
+   mem_archive* archive;
+{
+    mem_archive** link = &mem_archive_list;
+    while ((*link != NULL) && (*link != archive))
+        link = &(*link)->next;
+    if (*link != NULL)
+        *link = archive->next;
+#ifdef USE_MMAP
+    munmap(archive->base, (size_t)archive->size);
+#else
+    free(archive->base);
+#endif
+    free(archive->filename);
+    free(archive);
+}
+
+voidpf ZCALLBACK mem_open_file_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+    mem_archive* archive;
+    mem_stream* stream;
+
+    /* the mapping is read only */
+    if ((filename == NULL) ||
+        ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) != ZLIB_FILEFUNC_MODE_READ))
+        return NULL;
+
+    for (archive = mem_archive_list; archive != NULL; archive = archive->next)
+        if (strcmp(archive->filename, filename) == 0)
+            break;
+    if (archive == NULL)
+        archive = mem_map_archive(filename);
+    if (archive == NULL)
+        return NULL;
+
+    stream = (mem_stream*)malloc(sizeof(mem_stream));
+    if (stream == NULL)
+    {
+        if (archive->refcount == 0)
+            mem_unmap_archive(archive);
+        return NULL;
+    }
+    archive->refcount++;
+    stream->archive = archive;
+    stream->pos     = 0;
+    stream->error   = 0;
+    return stream;
+}
+
+uLong ZCALLBACK mem_read_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+    mem_stream* s = (mem_stream*)stream;
+    uLong left = s->archive->size - s->pos;
+    if (size > left)
+        size = left;
+    memcpy(buf, s->archive->base + s->pos, (size_t)size);
+    s->pos += size;
+    return size;
+}
+
+uLong ZCALLBACK mem_write_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+    ((mem_stream*)stream)->error = 1;
+    return 0;
+}
+
+long ZCALLBACK mem_tell_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    return (long)((mem_stream*)stream)->pos;
+}
+
+long ZCALLBACK mem_seek_file_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+    mem_stream* s = (mem_stream*)stream;
+    uLong new_pos;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = s->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = s->archive->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+    if (new_pos > s->archive->size)
+        return -1;
+    s->pos = new_pos;
+    return 0;
+}
+
+int ZCALLBACK mem_close_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    mem_stream* s = (mem_stream*)stream;
+    if (--s->archive->refcount == 0)
+        mem_unmap_archive(s->archive);
+    free(s);
+    return 0;
+}
+
+int ZCALLBACK mem_error_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    return ((mem_stream*)stream)->error;
+}
+
+const void* memory_filefunc_data (filename, size)
+  const char* filename;
+  uLong* size;
+{
+    mem_archive* archive;
+    for (archive = mem_archive_list; archive != NULL; archive = archive->next)
+    {
+        if (strcmp(archive->filename, filename) == 0)
+        {
+            if (size != NULL)
+                *size = archive->size;
+            return archive->base;
+        }
+    }
+    return NULL;
+}
+
+void fill_memory_filefunc (pzlib_filefunc_def)
+  zlib_filefunc_def* pzlib_filefunc_def;
+{
+    pzlib_filefunc_def->zopen_file = mem_open_file_func;
+    pzlib_filefunc_def->zread_file = mem_read_file_func;
+    pzlib_filefunc_def->zwrite_file = mem_write_file_func;
+    pzlib_filefunc_def->ztell_file = mem_tell_file_func;
+    pzlib_filefunc_def->zseek_file = mem_seek_file_func;
+    pzlib_filefunc_def->zclose_file = mem_close_file_func;
+    pzlib_filefunc_def->zerror_file = mem_error_file_func;
+    pzlib_filefunc_def->opaque = NULL;
+}
@@ -59,6 +59,18 @@ typedef struct zlib_filefunc_def_s
 
 void fill_fopen_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
 
+/* Read only backend that keeps the whole file in memory (mmap where the
+   system has it).  Streams opened on the same filename share 1 mapping.
+   Without mmap the file is read into 1 malloc'ed block, and files bigger
+   than MEM_FILEFUNC_MAX_SIZE are refused.  zopen_file returns NULL if the
+   file can not be mapped, so callers can fall back on fill_fopen_filefunc. */
+void fill_memory_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
+
+/* Returns the start of the in memory copy of filename (and its size), or
+   NULL if no stream opened with fill_memory_filefunc has it open.  The
+   pointer stays valid until the last stream on the file is closed. */
+const void* memory_filefunc_data OF((const char* filename, uLong* size));
+
 #define ZREAD(filefunc,filestream,buf,size) ((*((filefunc).zread_file))((filefunc).opaque,filestream,buf,size))
 #define ZWRITE(filefunc,filestream,buf,size) ((*((filefunc).zwrite_file))((filefunc).opaque,filestream,buf,size))
 #define ZTELL(filefunc,filestream) ((*((filefunc).ztell_file))((filefunc).opaque,filestream))
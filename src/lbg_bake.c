@@ -0,0 +1,317 @@
+//-----------------------------------------------------------------------------
+//  Program:
+//  LBG Image Baker
+//
+//  Description:
+//  PC tool (build it with "make bake") that converts the BMP/PNG images
+//  the game converts to the screen format every time they are loaded into
+//  baked images (see lbg_image.h).  The baked files keep the name of the
+//  original image, so they can simply replace it in data.lbg.  The images
+//  are converted with the same SDL_ConvertSurface call the game uses, so
+//  the pixels are identical to what the game would have created.
+//
+//  Usage: lbg_bake <list file> <source dir> <output dir>
+//
+//  Each line of the list file names 1 image, optionally followed by "t" if
+//  the image uses the transparent (0xFF8080) colorkey.  Lines starting with
+//  # are ignored.
+//
+//  For every image the tool reports the time taken to load it the old way
+//  (decode + SDL_ConvertSurface) and the baked way, both from memory, and
+//  the totals for the whole list.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "SDL.h"
+#include "SDL_image.h"
+#include "lbg_image.h"
+
+#define MAX_PATH   255
+
+static unsigned int  GetMicroSeconds();
+static void          *ReadFile(const char *path, int *size);
+static void          PutShort(unsigned char *p, int value);
+static unsigned char *BakeImage(SDL_Surface *img, int colorkey, int *size);
+static SDL_Surface   *LoadBaked(unsigned char *data, int size);
+static int           SamePixels(SDL_Surface *a, SDL_Surface *b);
+
+//------------------------------------------------------------------------------
+// Name:     main
+// Summary:  Bakes every image in the list file
+// Inputs:   1.  Number or arguments
+//           2.  Char Pointer to each arg
+// Outputs:  None
+// Returns:  Program exit status, non-zero if any image could not be baked
+// Cautions: None
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  char line[MAX_PATH];
+  char name[MAX_PATH];
+  char path[MAX_PATH * 2];
+  char key[MAX_PATH];
+  FILE *list;
+  FILE *out;
+  SDL_Surface *fmt;
+  SDL_Surface *img;
+  SDL_Surface *conv;
+  SDL_Surface *baked;
+  unsigned char *blob;
+  void *data;
+  unsigned int start, before, after;
+  unsigned int totalBefore = 0;
+  unsigned int totalAfter  = 0;
+  int size, blobSize, fields;
+  int count  = 0;
+  int status = 0;
+
+  if (argc != 4)
+  {
+    fprintf(stderr, "usage: %s <list file> <source dir> <output dir>\n",
+            argv[0]);
+    return(1);
+  }
+
+  list = fopen(argv[1], "r");
+  if (list == 0)
+  {
+    fprintf(stderr, "Could not open %s\n", argv[1]);
+    return(1);
+  }
+
+  // surface used only for its pixel format, the same as the game's screen
+  fmt = SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, LBG_IMG_BPP,
+                             LBG_IMG_RMASK, LBG_IMG_GMASK,
+                             LBG_IMG_BMASK, LBG_IMG_AMASK);
+
+  while (fgets(line, sizeof(line), list))
+  {
+    key[0] = 0;
+    fields = sscanf(line, "%254s %254s", name, key);
+    if (fields < 1 || name[0] == '#')
+      continue;
+
+    sprintf(path, "%s/%s", argv[2], name);
+    data = ReadFile(path, &size);
+    if (data == 0)
+    {
+      fprintf(stderr, "Could not read %s\n", path);
+      status = 1;
+      continue;
+    }
+
+    // old way: decode then convert to screen format
+    start = GetMicroSeconds();
+    img   = IMG_Load_RW(SDL_RWFromConstMem(data, size), 1);
+    conv  = img ? SDL_ConvertSurface(img, fmt->format, SDL_SWSURFACE) : 0;
+    before = GetMicroSeconds() - start;
+    if (conv == 0)
+    {
+      fprintf(stderr, "Could not load %s: %s\n", path, SDL_GetError());
+      SDL_FreeSurface(img);
+      free(data);
+      status = 1;
+      continue;
+    }
+
+    blob = BakeImage(conv, strcmp(key, "t") == 0, &blobSize);
+
+    // new way: copy the baked pixels into a surface
+    start  = GetMicroSeconds();
+    baked  = LoadBaked(blob, blobSize);
+    after  = GetMicroSeconds() - start;
+
+    if (!SamePixels(conv, baked))
+    {
+      fprintf(stderr, "%s: baked pixels do not match\n", name);
+      status = 1;
+    }
+
+    sprintf(path, "%s/%s", argv[3], name);
+    out = fopen(path, "wb");
+    if (out == 0 || fwrite(blob, 1, blobSize, out) != (size_t) blobSize)
+    {
+      fprintf(stderr, "Could not write %s\n", path);
+      status = 1;
+    }
+    if (out)
+      fclose(out);
+
+    printf("%-24s %4ix%-4i %8uus -> %6uus\n", name, conv->w, conv->h,
+           before, after);
+    totalBefore += before;
+    totalAfter  += after;
+    count++;
+
+    SDL_FreeSurface(baked);
+    SDL_FreeSurface(conv);
+    SDL_FreeSurface(img);
+    free(blob);
+    free(data);
+  }
+
+  printf("%i images: %uus before, %uus after\n", count, totalBefore,
+         totalAfter);
+  SDL_FreeSurface(fmt);
+  fclose(list);
+  return(status);
+}
+
+//------------------------------------------------------------------------------
+// Name:     GetMicroSeconds
+// Summary:  Used to time image loads
+// Inputs:   None
+// Outputs:  None
+// Returns:  Current time in microseconds
+// Cautions: Wraps, only use it for short intervals
+//------------------------------------------------------------------------------
+unsigned int GetMicroSeconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return((unsigned int) (tv.tv_sec * 1000000 + tv.tv_usec));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadFile
+// Summary:  Reads an entire file into memory
+// Inputs:   Path of file to read
+// Outputs:  size - size of file
+// Returns:  Pointer to file data (caller must free), 0 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+void *ReadFile(const char *path, int *size)
+{
+  FILE *f    = fopen(path, "rb");
+  void *data = 0;
+
+  if (f == 0)
+    return(0);
+  fseek(f, 0, SEEK_END);
+  *size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  data = malloc(*size);
+  if (data && fread(data, 1, *size, f) != (size_t) *size)
+  {
+    free(data);
+    data = 0;
+  }
+  fclose(f);
+  return(data);
+}
+
+//------------------------------------------------------------------------------
+// Name:     PutShort
+// Summary:  Stores a 16 bit value (little endian)
+// Inputs:   1. Where to store value
+//           2. Value to store
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void PutShort(unsigned char *p, int value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+}
+
+//------------------------------------------------------------------------------
+// Name:     BakeImage
+// Summary:  Creates a baked image from a surface in screen format
+// Inputs:   1. img - surface to bake (must be in screen format)
+//           2. colorkey - if set, the image uses the transparent colorkey
+// Outputs:  size - size of baked image in bytes
+// Returns:  Pointer to baked image (caller must free)
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned char *BakeImage(SDL_Surface *img, int colorkey, int *size)
+{
+  int pitch = (img->w * 2 + LBG_IMG_ALLIGN - 1) & ~(LBG_IMG_ALLIGN - 1);
+  unsigned char *blob;
+  int y;
+
+  *size = LBG_IMG_HEADER_SIZE + pitch * img->h;
+  blob  = (unsigned char *) calloc(1, *size);
+
+  memcpy(blob, LBG_IMG_MAGIC, 4);
+  PutShort(&blob[LBG_IMG_OFS_WIDTH],  img->w);
+  PutShort(&blob[LBG_IMG_OFS_HEIGHT], img->h);
+  PutShort(&blob[LBG_IMG_OFS_PITCH],  pitch);
+  PutShort(&blob[LBG_IMG_OFS_FLAGS],  colorkey ? LBG_IMG_COLORKEY : 0);
+  PutShort(&blob[LBG_IMG_OFS_COLORKEY],
+           SDL_MapRGB(img->format, 0xFF, 0x80, 0x80));
+
+  // pixels are stored little endian, same as the PC & PSP hold them
+  SDL_LockSurface(img);
+  for (y=0; y < img->h; y++)
+  {
+    memcpy(&blob[LBG_IMG_HEADER_SIZE + y * pitch],
+           (unsigned char *) img->pixels + y * img->pitch, img->w * 2);
+  }
+  SDL_UnlockSurface(img);
+  return(blob);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LoadBaked
+// Summary:  Creates a surface from a baked image, the same way the game's
+//           ZIP_LoadImage does
+// Inputs:   1. Baked image
+//           2. Size of baked image
+// Outputs:  None
+// Returns:  SDL_Surface created, 0 if the baked image is too small
+// Cautions: None
+//------------------------------------------------------------------------------
+SDL_Surface *LoadBaked(unsigned char *data, int size)
+{
+  int w     = data[LBG_IMG_OFS_WIDTH]  | (data[LBG_IMG_OFS_WIDTH + 1] << 8);
+  int h     = data[LBG_IMG_OFS_HEIGHT] | (data[LBG_IMG_OFS_HEIGHT + 1] << 8);
+  int pitch = data[LBG_IMG_OFS_PITCH]  | (data[LBG_IMG_OFS_PITCH + 1] << 8);
+  SDL_Surface *img;
+  int y;
+
+  if (size < LBG_IMG_HEADER_SIZE + pitch * h)
+    return(0);
+
+  img = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, LBG_IMG_BPP,
+                             LBG_IMG_RMASK, LBG_IMG_GMASK,
+                             LBG_IMG_BMASK, LBG_IMG_AMASK);
+  if (pitch == img->pitch)
+  {
+    memcpy(img->pixels, &data[LBG_IMG_HEADER_SIZE], pitch * h);
+  }
+  else
+  {
+    for (y=0; y < h; y++)
+      memcpy((unsigned char *) img->pixels + y * img->pitch,
+             &data[LBG_IMG_HEADER_SIZE + y * pitch], w * 2);
+  }
+  return(img);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SamePixels
+// Summary:  Compares the pixels of 2 surfaces in screen format
+// Inputs:   Surfaces to compare
+// Outputs:  None
+// Returns:  1 if the surfaces are the same size and hold the same pixels
+// Cautions: None
+//------------------------------------------------------------------------------
+int SamePixels(SDL_Surface *a, SDL_Surface *b)
+{
+  int y;
+
+  if (b == 0 || a->w != b->w || a->h != b->h)
+    return(0);
+  for (y=0; y < a->h; y++)
+  {
+    if (memcmp((unsigned char *) a->pixels + y * a->pitch,
+               (unsigned char *) b->pixels + y * b->pitch, a->w * 2))
+      return(0);
+  }
+  return(1);
+}
@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+//  Baked Image Format
+//
+//  Description:
+//  Layout of the pre-converted images written by the lbg_bake tool.  A baked
+//  image replaces a BMP/PNG in data.lbg under the same name and holds the
+//  pixels already in the 15 bit (5551) screen format, so ZIP_LoadImage can
+//  copy them straight into an SDL_Surface with no decoding or conversion.
+//
+//  All values are little endian (same as the PSP).  The header is padded
+//  to 32 bytes, and each row of pixels to a multiple of 16 bytes, so the
+//  pixel data stays 16 byte alligned.
+//
+//  Offset  Size  Value
+//     0     4    LBG_IMG_MAGIC
+//     4     2    width (pixels)
+//     6     2    height (pixels)
+//     8     2    pitch (bytes per row)
+//    10     2    flags (LBG_IMG_COLORKEY)
+//    12     2    colorkey (5551 pixel value, if LBG_IMG_COLORKEY is set)
+//    14    18    reserved (0)
+//    32          pixels, height * pitch bytes
+//-----------------------------------------------------------------------------
+#ifndef __LBG_IMAGE_H__
+#define __LBG_IMAGE_H__
+
+#define LBG_IMG_MAGIC          "MMS1"
+#define LBG_IMG_HEADER_SIZE    32
+#define LBG_IMG_ALLIGN         16
+
+#define LBG_IMG_COLORKEY       1
+
+// 5551 screen format, must match the format the screen is set up with
+#define LBG_IMG_BPP            15
+#define LBG_IMG_RMASK          0x001F
+#define LBG_IMG_GMASK          0x03E0
+#define LBG_IMG_BMASK          0x7C00
+#define LBG_IMG_AMASK          0x0000
+
+#define LBG_IMG_OFS_WIDTH       4
+#define LBG_IMG_OFS_HEIGHT      6
+#define LBG_IMG_OFS_PITCH       8
+#define LBG_IMG_OFS_FLAGS      10
+#define LBG_IMG_OFS_COLORKEY   12
+
+#endif
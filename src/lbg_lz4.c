@@ -0,0 +1,359 @@
+//-----------------------------------------------------------------------------
+//  Module:
+//  LZ4 Codec
+//
+//  Description:
+//  A small LZ4 block compressor & decompressor used for zip entries stored
+//  with LBG_LZ4_METHOD (see lbg_lz4.h).  The decompressor is used by unzip
+//  when the game loads such an entry, the compressor by the lbg_pack tool
+//  (and the MM_PROFILE codec benchmark).  The blocks written are standard
+//  LZ4 blocks, the compressor is a simple greedy 1 that favours speed over
+//  compression ratio.
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include "lbg_lz4.h"
+
+#define HASH_LOG           12
+#define HASH_SIZE          (1 << HASH_LOG)
+#define MIN_MATCH           4
+#define MF_LIMIT           12     // last match must start this far from end
+#define LAST_LITERALS       5     // last bytes of a block are always literals
+#define MAX_OFFSET      65535
+#define RUN_MASK           15
+
+static unsigned int Read32(const unsigned char *p);
+static unsigned char *PutLength(unsigned char *op, int length);
+static int GetLength(const unsigned char **ip, const unsigned char *iend,
+                     int length);
+
+//------------------------------------------------------------------------------
+// Name:     LBG_LZ4Decompress
+// Summary:  Decompresses 1 LZ4 block
+// Inputs:   1. src - compressed block
+//           2. srcSize - size of compressed block
+//           3. dst - buffer to decompress into
+//           4. dstSize - size of dst buffer
+// Outputs:  None
+// Returns:  Number of bytes decompressed into dst, -1 if the block is bad or
+//           does not fit in dst
+// Cautions: Never reads or writes outside of src & dst, even if the block is
+//           corrupt
+//------------------------------------------------------------------------------
+int LBG_LZ4Decompress(const unsigned char *src, int srcSize,
+                      unsigned char *dst, int dstSize)
+{
+  const unsigned char *ip   = src;
+  const unsigned char *iend = src + srcSize;
+  const unsigned char *match;
+  unsigned char *op         = dst;
+  unsigned char *oend       = dst + dstSize;
+  int token, length, offset;
+
+  while (ip < iend)
+  {
+    token  = *ip++;
+
+    // literals
+    length = GetLength(&ip, iend, token >> 4);
+    if (length < 0 || length > iend - ip || length > oend - op)
+      return(-1);
+    memcpy(op, ip, length);
+    ip += length;
+    op += length;
+
+    if (ip == iend)  // last sequence has no match
+      break;
+
+    // match
+    if (iend - ip < 2)
+      return(-1);
+    offset = ip[0] | (ip[1] << 8);
+    ip    += 2;
+    if (offset == 0 || offset > op - dst)
+      return(-1);
+
+    length = GetLength(&ip, iend, token & RUN_MASK);
+    if (length < 0)
+      return(-1);
+    length += MIN_MATCH;
+    if (length > oend - op)
+      return(-1);
+
+    match = op - offset;
+    if (offset >= length)
+    {
+      memcpy(op, match, length);
+      op += length;
+    }
+    else  // match overlaps the bytes it is creating, copy 1 at a time
+    {
+      while (length--)
+        *op++ = *match++;
+    }
+  }
+  return(op - dst);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LBG_LZ4Compress
+// Summary:  Compresses data into 1 LZ4 block
+// Inputs:   1. src - data to compress
+//           2. srcSize - size of data (at most LBG_LZ4_BLOCK_SIZE)
+//           3. dst - buffer to compress into
+//           4. dstSize - size of dst buffer, LBG_LZ4_BOUND(srcSize) always
+//              holds the result
+// Outputs:  None
+// Returns:  Size of compressed block, 0 if it does not fit in dst
+// Cautions: None
+//------------------------------------------------------------------------------
+int LBG_LZ4Compress(const unsigned char *src, int srcSize,
+                    unsigned char *dst, int dstSize)
+{
+  int table[HASH_SIZE];   // last position each hashed 4 bytes were seen at
+  const unsigned char *ip         = src;
+  const unsigned char *anchor     = src;   // start of pending literals
+  const unsigned char *end        = src + srcSize;
+  const unsigned char *mflimit    = end - MF_LIMIT;
+  const unsigned char *matchlimit = end - LAST_LITERALS;
+  const unsigned char *match;
+  unsigned char *op   = dst;
+  unsigned char *oend = dst + dstSize;
+  unsigned char *token;
+  unsigned int hash;
+  int literals, length, x;
+
+  for (x=0; x < HASH_SIZE; x++)
+    table[x] = -1;
+
+  // blocks shorter than MF_LIMIT + 1 bytes can only hold literals
+  while (srcSize > MF_LIMIT && ip < mflimit)
+  {
+    hash        = (Read32(ip) * 2654435761u) >> (32 - HASH_LOG);
+    x           = table[hash];
+    table[hash] = ip - src;
+    if (x < 0 || (ip - src) - x > MAX_OFFSET || Read32(src + x) != Read32(ip))
+    {
+      ip++;
+      continue;
+    }
+
+    match  = src + x;
+    length = MIN_MATCH;
+    while (ip + length < matchlimit && ip[length] == match[length])
+      length++;
+
+    literals = ip - anchor;
+    if (op + 1 + literals + literals / 255 + 2 + length / 255 + 2 > oend)
+      return(0);
+
+    token  = op++;
+    *token = (literals >= RUN_MASK ? RUN_MASK : literals) << 4;
+    if (literals >= RUN_MASK)
+      op = PutLength(op, literals - RUN_MASK);
+    memcpy(op, anchor, literals);
+    op   += literals;
+    *op++ = (ip - match) & 0xFF;
+    *op++ = (ip - match) >> 8;
+
+    if (length - MIN_MATCH >= RUN_MASK)
+    {
+      *token |= RUN_MASK;
+      op      = PutLength(op, length - MIN_MATCH - RUN_MASK);
+    }
+    else
+    {
+      *token |= length - MIN_MATCH;
+    }
+
+    ip    += length;
+    anchor = ip;
+  }
+
+  // what is left goes out as literals
+  literals = end - anchor;
+  if (op + 1 + literals + literals / 255 + 1 > oend)
+    return(0);
+  token  = op++;
+  *token = (literals >= RUN_MASK ? RUN_MASK : literals) << 4;
+  if (literals >= RUN_MASK)
+    op = PutLength(op, literals - RUN_MASK);
+  memcpy(op, anchor, literals);
+  op += literals;
+
+  return(op - dst);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LBG_LZ4PackBound
+// Summary:  Returns the largest size LBG_LZ4Pack can produce for the given
+//           amount of data
+// Inputs:   Size of data to pack
+// Outputs:  None
+// Returns:  Size of buffer needed by LBG_LZ4Pack
+// Cautions: None
+//------------------------------------------------------------------------------
+int LBG_LZ4PackBound(int size)
+{
+  int blocks = (size + LBG_LZ4_BLOCK_SIZE - 1) / LBG_LZ4_BLOCK_SIZE;
+  return(size + blocks * LBG_LZ4_BLOCK_HEADER);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LBG_LZ4Pack
+// Summary:  Compresses the data of a whole zip entry into LBG_LZ4_BLOCK_SIZE
+//           blocks, each with its block header (see lbg_lz4.h)
+// Inputs:   1. src - data to compress
+//           2. srcSize - size of data
+//           3. dst - buffer to compress into
+//           4. dstSize - size of dst buffer (LBG_LZ4PackBound(srcSize))
+// Outputs:  None
+// Returns:  Size of packed data, -1 if dst is too small
+// Cautions: Blocks that do not get smaller are stored as is
+//------------------------------------------------------------------------------
+int LBG_LZ4Pack(const unsigned char *src, int srcSize,
+                unsigned char *dst, int dstSize)
+{
+  unsigned char *op = dst;
+  unsigned int header;
+  int pos, block, size;
+
+  for (pos=0; pos < srcSize; pos += block)
+  {
+    block = srcSize - pos;
+    if (block > LBG_LZ4_BLOCK_SIZE)
+      block = LBG_LZ4_BLOCK_SIZE;
+    if ((op - dst) + LBG_LZ4_BLOCK_HEADER + block > dstSize)
+      return(-1);
+
+    // only keep the compressed block if it is smaller than the data
+    size   = LBG_LZ4Compress(src + pos, block, op + LBG_LZ4_BLOCK_HEADER,
+                             block - 1);
+    header = size;
+    if (size == 0)
+    {
+      memcpy(op + LBG_LZ4_BLOCK_HEADER, src + pos, block);
+      size   = block;
+      header = block | LBG_LZ4_STORED;
+    }
+
+    op[0] = header & 0xFF;
+    op[1] = (header >> 8) & 0xFF;
+    op[2] = (header >> 16) & 0xFF;
+    op[3] = (header >> 24) & 0xFF;
+    op   += LBG_LZ4_BLOCK_HEADER + size;
+  }
+  return(op - dst);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LBG_LZ4Unpack
+// Summary:  Decompresses the data of a whole zip entry packed by LBG_LZ4Pack
+// Inputs:   1. src - packed data
+//           2. srcSize - size of packed data
+//           3. dst - buffer to decompress into
+//           4. dstSize - size of dst buffer
+// Outputs:  None
+// Returns:  Number of bytes decompressed into dst, -1 on error
+// Cautions: unzip decodes entries 1 block at a time itself, this is for the
+//           tools & benchmarks
+//------------------------------------------------------------------------------
+int LBG_LZ4Unpack(const unsigned char *src, int srcSize,
+                  unsigned char *dst, int dstSize)
+{
+  const unsigned char *ip   = src;
+  const unsigned char *iend = src + srcSize;
+  unsigned char *op         = dst;
+  unsigned int header;
+  int size, length;
+
+  while (ip < iend)
+  {
+    if (iend - ip < LBG_LZ4_BLOCK_HEADER)
+      return(-1);
+    header = Read32(ip);
+    ip    += LBG_LZ4_BLOCK_HEADER;
+    size   = header & ~LBG_LZ4_STORED;
+    if (size > iend - ip || size > LBG_LZ4_BOUND(LBG_LZ4_BLOCK_SIZE))
+      return(-1);
+
+    if (header & LBG_LZ4_STORED)
+    {
+      if (size > (dst + dstSize) - op)
+        return(-1);
+      memcpy(op, ip, size);
+      length = size;
+    }
+    else
+    {
+      length = LBG_LZ4Decompress(ip, size, op, (dst + dstSize) - op);
+      if (length < 0)
+        return(-1);
+    }
+    ip += size;
+    op += length;
+  }
+  return(op - dst);
+}
+
+//------------------------------------------------------------------------------
+// Name:     Read32
+// Summary:  Reads a little endian 32 bit value from any alignment
+// Inputs:   Pointer to value
+// Outputs:  None
+// Returns:  Value read
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned int Read32(const unsigned char *p)
+{
+  return(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24));
+}
+
+//------------------------------------------------------------------------------
+// Name:     PutLength
+// Summary:  Writes the extra bytes of a literal or match length that did not
+//           fit in the token (runs of 255, then the rest)
+// Inputs:   1. op - where to write
+//           2. length - length left over after the token's 15
+// Outputs:  None
+// Returns:  Pointer just past the bytes written
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned char *PutLength(unsigned char *op, int length)
+{
+  while (length >= 255)
+  {
+    *op++   = 255;
+    length -= 255;
+  }
+  *op++ = length;
+  return(op);
+}
+
+//------------------------------------------------------------------------------
+// Name:     GetLength
+// Summary:  Reads a literal or match length, the token's 4 bits followed by
+//           extra bytes if they are all set
+// Inputs:   1. ip - where the extra bytes start
+//           2. iend - end of block
+//           3. length - length from token
+// Outputs:  ip - moved past the extra bytes
+// Returns:  Length, -1 if the block ends in the middle of it
+// Cautions: None
+//------------------------------------------------------------------------------
+int GetLength(const unsigned char **ip, const unsigned char *iend, int length)
+{
+  int b;
+
+  if (length != RUN_MASK)
+    return(length);
+  do
+  {
+    if (*ip >= iend || length > LBG_LZ4_BLOCK_SIZE)
+      return(-1);
+    b       = *(*ip)++;
+    length += b;
+  }
+  while (b == 255);
+  return(length);
+}
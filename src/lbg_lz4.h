@@ -0,0 +1,41 @@
+//-----------------------------------------------------------------------------
+//  LZ4 Entry Format
+//
+//  Description:
+//  Zip entries can be compressed with LZ4 instead of deflate (the packer,
+//  lbg_pack, chooses per entry).  LZ4 decodes several times faster than
+//  inflate at the cost of a somewhat larger archive.  Such entries use
+//  compression method LBG_LZ4_METHOD, which no other zip tool knows about.
+//
+//  The uncompressed data is cut into blocks of LBG_LZ4_BLOCK_SIZE bytes
+//  (the last may be shorter), each compressed on its own as a plain LZ4
+//  block so unzip can decode an entry a block at a time.  Each block is
+//  written as:
+//
+//  Offset  Size  Value
+//     0     4    size of block data (little endian), the LBG_LZ4_STORED bit
+//                is set if the data did not compress and is stored as is
+//     4          block data
+//-----------------------------------------------------------------------------
+#ifndef __LBG_LZ4_H__
+#define __LBG_LZ4_H__
+
+#define LBG_LZ4_METHOD       0x4C34      // zip compression method ("4L")
+#define LBG_LZ4_BLOCK_SIZE   65536       // uncompressed bytes per block
+#define LBG_LZ4_BLOCK_HEADER 4
+#define LBG_LZ4_STORED       0x80000000
+
+// Largest size an LZ4 block of the given size can compress to
+#define LBG_LZ4_BOUND(size)  ((size) + (size) / 255 + 16)
+
+int LBG_LZ4Decompress(const unsigned char *src, int srcSize,
+                      unsigned char *dst, int dstSize);
+int LBG_LZ4Compress(const unsigned char *src, int srcSize,
+                    unsigned char *dst, int dstSize);
+int LBG_LZ4PackBound(int size);
+int LBG_LZ4Pack(const unsigned char *src, int srcSize,
+                unsigned char *dst, int dstSize);
+int LBG_LZ4Unpack(const unsigned char *src, int srcSize,
+                  unsigned char *dst, int dstSize);
+
+#endif
@@ -0,0 +1,815 @@
+//-----------------------------------------------------------------------------
+//  Program:
+//  LBG Archive Packer
+//
+//  Description:
+//  PC tool (build it with "make pack") that rewrites a game archive
+//  (data.lbg or a level archive) choosing the compression of each entry:
+//  stored, deflate or LZ4 (see lbg_lz4.h).  LZ4 entries are a bit larger
+//  than deflated ones but decode several times faster, so the assets
+//  loaded while a level starts are best kept in LZ4.
+//
+//  Usage: lbg_pack [-a <align>] [-o <order file>]... <list file>
+//                  <input archive> <output archive>
+//
+//  Each line of the list file names 1 entry followed by its method: "store",
+//  "deflate", "lz4" or "keep" (copy unchanged).  A line naming "*" sets the
+//  method of every entry not listed, by default they are kept.  Lines
+//  starting with # are ignored.
+//
+//  Entries are written in the order the game loads them, so a level load
+//  reads the archive from front to back instead of seeking all over it.
+//  The order comes from the -o files, in the order given: a trace written by
+//  a build with MM_TRACE_LOADS (load_trace.txt, 1 name per line), or C
+//  source files whose string literals name the entries (resource_manager.c
+//  lists them in its resource tables in the order they are loaded).  An
+//  entry goes where it is first named, entries never named go last in their
+//  old order.  With -a the data of every entry starts at a multiple of
+//  <align> bytes (e.g. 512 for memory stick sectors), the local header's
+//  extra field is padded to get there.
+//
+//  Entries keep their name, date & attributes.  Entries that are already in
+//  the method asked for are copied without being recompressed.  Once written
+//  the new archive is read back with unzip and every entry's CRC checked.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zlib.h"
+#include "unzip.h"
+#include "lbg_lz4.h"
+
+#define MAX_PATH       255
+#define METHOD_KEEP    -1       // copy entry as it is
+#define METHOD_BAD     -2
+
+#define LOCAL_HEADER   30
+#define CENTRAL_HEADER 46
+#define END_HEADER     22
+#define EXTRA_HEADER   4
+#define ALIGN_EXTRA_ID 0xD935   // id of padding extra field (as zipalign)
+
+typedef struct
+{
+  char          name[MAX_PATH];
+  unz_file_pos  pos;            // of entry in the input archive
+  int           order;          // position in output archive, -1 if not set
+  int           inMethod;
+  unsigned long inSize;         // compressed size in the input archive
+  unsigned long inOffset;       // of data in the input archive
+  int           method;
+  unsigned long crc;
+  unsigned long compressedSize;
+  unsigned long size;
+  unsigned long dosDate;
+  unsigned long internalAttr;
+  unsigned long externalAttr;
+  unsigned long offset;         // of local header in the output archive
+  unsigned long header;         // size of local header, name & padding
+} PackEntry;
+
+typedef struct
+{
+  char name[MAX_PATH];
+  int  method;
+} ListEntry;
+
+static int           ReadEntries(unzFile zip, PackEntry **entries);
+static int           ReadOrder(const char *path, PackEntry *entries, int count,
+                               int *ordered);
+static int           CompareOrder(const void *a, const void *b);
+static unsigned long Distance(unsigned long from, unsigned long to);
+static int           PackEntryData(unzFile zip, FILE *out, PackEntry *entry,
+                                   int want, int align);
+static int           ReadList(const char *path, ListEntry **list, int *count,
+                              int *defMethod);
+static int           ParseMethod(const char *method);
+static const char    *MethodName(int method);
+static unsigned char *ReadEntry(unzFile zip, unsigned long size);
+static unsigned char *Deflate(unsigned char *data, unsigned long size,
+                              unsigned long *packedSize);
+static unsigned char *Lz4(unsigned char *data, unsigned long size,
+                          unsigned long *packedSize);
+static int           WriteLocalHeader(FILE *out, PackEntry *entry, int pad);
+static int           WriteDirectory(FILE *out, PackEntry *entries, int count);
+static int           VerifyArchive(const char *path);
+static void          PutShort(unsigned char *p, unsigned long value);
+static void          PutLong(unsigned char *p, unsigned long value);
+
+//------------------------------------------------------------------------------
+// Name:     main
+// Summary:  Rewrites the input archive in load order with the methods from
+//           the list file
+// Inputs:   1.  Number or arguments
+//           2.  Char Pointer to each arg
+// Outputs:  None
+// Returns:  Program exit status, non-zero if the archive could not be written
+// Cautions: None
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  ListEntry *list    = 0;
+  PackEntry *entries = 0;
+  PackEntry *entry;
+  const char **orderFiles = (const char **) calloc(argc, sizeof(char *));
+  unzFile zip;
+  FILE *out;
+  unsigned long totalIn     = 0;
+  unsigned long totalOut    = 0;
+  unsigned long seekBefore  = 0;
+  unsigned long seekAfter   = 0;
+  int listCount, defMethod, want, x, y;
+  int orderCount = 0;
+  int ordered    = 0;
+  int align      = 1;
+  int arg        = 1;
+  int count      = 0;
+  int status     = 0;
+
+  while (arg + 1 < argc && argv[arg][0] == '-')
+  {
+    if (strcmp(argv[arg], "-a") == 0)
+      align = atoi(argv[arg + 1]);
+    else if (strcmp(argv[arg], "-o") == 0)
+      orderFiles[orderCount++] = argv[arg + 1];
+    else
+      break;
+    arg += 2;
+  }
+  if (argc - arg != 3 || align < 1)
+  {
+    fprintf(stderr, "usage: %s [-a <align>] [-o <order file>]... "
+            "<list file> <input archive> <output archive>\n", argv[0]);
+    return(1);
+  }
+
+  if (ReadList(argv[arg], &list, &listCount, &defMethod))
+    return(1);
+
+  zip = unzOpen(argv[arg + 1]);
+  if (zip == 0)
+  {
+    fprintf(stderr, "Could not open %s\n", argv[arg + 1]);
+    return(1);
+  }
+  count = ReadEntries(zip, &entries);
+  if (count < 0)
+  {
+    unzClose(zip);
+    return(1);
+  }
+
+  // entries named by the order files go first, in the order first named,
+  // the rest follow in their old order
+  for (x=0; x < orderCount; x++)
+  {
+    if (ReadOrder(orderFiles[x], entries, count, &ordered))
+      status = 1;
+  }
+  for (x=0, y=ordered; x < count; x++)
+  {
+    if (entries[x].order < 0)
+      entries[x].order = y++;
+  }
+  qsort(entries, count, sizeof(PackEntry), CompareOrder);
+
+  out = fopen(argv[arg + 2], "wb");
+  if (out == 0)
+  {
+    fprintf(stderr, "Could not create %s\n", argv[arg + 2]);
+    unzClose(zip);
+    return(1);
+  }
+
+  for (x=0; x < count && status == 0; x++)
+  {
+    entry = &entries[x];
+    want  = defMethod;
+    for (y=0; y < listCount; y++)
+    {
+      if (strcmp(list[y].name, entry->name) == 0)
+        want = list[y].method;
+    }
+
+    if (unzGoToFilePos(zip, &entry->pos) != UNZ_OK ||
+        PackEntryData(zip, out, entry, want, align))
+    {
+      fprintf(stderr, "Could not pack %s\n", entry->name);
+      status = 1;
+      break;
+    }
+
+    printf("%-28s %-7s %8lu -> %-7s %8lu\n", entry->name,
+           MethodName(entry->inMethod), entry->inSize,
+           MethodName(entry->method), entry->compressedSize);
+    totalIn  += entry->inSize;
+    totalOut += entry->compressedSize;
+
+    // distance the reader has to skip to get from 1 load to the next
+    if (x > 0 && x < ordered)
+    {
+      seekBefore += Distance(entries[x - 1].inOffset + entries[x - 1].inSize,
+                             entry->inOffset);
+      seekAfter  += Distance(entries[x - 1].offset + entries[x - 1].header +
+                             entries[x - 1].compressedSize, entry->offset);
+    }
+  }
+
+  if (status == 0 && WriteDirectory(out, entries, count))
+  {
+    fprintf(stderr, "Could not write %s\n", argv[arg + 2]);
+    status = 1;
+  }
+  fclose(out);
+  unzClose(zip);
+
+  if (status == 0)
+  {
+    printf("%i entries: %lu bytes before, %lu bytes after\n", count,
+           totalIn, totalOut);
+    if (ordered)
+      printf("%i entries in load order: skipped %lu bytes between them "
+             "before, %lu bytes after\n", ordered, seekBefore, seekAfter);
+    status = VerifyArchive(argv[arg + 2]);
+  }
+  free(orderFiles);
+  free(entries);
+  free(list);
+  return(status);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadEntries
+// Summary:  Reads the details of every entry in the input archive
+// Inputs:   zip - input archive
+// Outputs:  entries - entries read (caller must free), in archive order
+// Returns:  Number of entries, -1 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+int ReadEntries(unzFile zip, PackEntry **entries)
+{
+  unz_file_info info;
+  PackEntry *entry;
+  int method, level, err;
+  int count = 0;
+
+  *entries = 0;
+  for (err=unzGoToFirstFile(zip); err == UNZ_OK; err=unzGoToNextFile(zip))
+  {
+    *entries = (PackEntry *) realloc(*entries, (count + 1) * sizeof(PackEntry));
+    entry    = &(*entries)[count];
+    memset(entry, 0, sizeof(PackEntry));
+    if (unzGetCurrentFileInfo(zip, &info, entry->name, MAX_PATH,
+                              0, 0, 0, 0) != UNZ_OK ||
+        unzGetFilePos(zip, &entry->pos) != UNZ_OK ||
+        unzOpenCurrentFile2(zip, &method, &level, 1) != UNZ_OK)
+    {
+      fprintf(stderr, "Could not read entry %i\n", count);
+      return(-1);
+    }
+    entry->inOffset = unzGetCurrentFileZStreamPos(zip);
+    unzCloseCurrentFile(zip);
+
+    entry->inMethod       = info.compression_method;
+    entry->inSize         = info.compressed_size;
+    entry->crc            = info.crc;
+    entry->size           = info.uncompressed_size;
+    entry->dosDate        = info.dosDate;
+    entry->internalAttr   = info.internal_fa;
+    entry->externalAttr   = info.external_fa;
+    entry->order          = -1;
+    count++;
+  }
+  return(count);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadOrder
+// Summary:  Reads the order entries are loaded in from an order file.  A
+//           trace (load_trace.txt) holds 1 name per line, from a C source
+//           file (.c) every string literal naming an entry is used, so the
+//           order the resource tables list files in can be used as is.
+// Inputs:   1. path - order file
+//           2. entries - entries of input archive
+//           3. count - number of entries
+//           4. ordered - number of entries placed so far
+// Outputs:  1. entries - order of each entry named for the first time set
+//           2. ordered - updated
+// Returns:  0 on success, non-zero if the file could not be read
+// Cautions: Names that are not in the archive are skipped
+//------------------------------------------------------------------------------
+int ReadOrder(const char *path, PackEntry *entries, int count, int *ordered)
+{
+  char line[MAX_PATH * 4];
+  char name[MAX_PATH];
+  const char *ext = strrchr(path, '.');
+  int source      = ext && strcmp(ext, ".c") == 0;
+  char *p, *end;
+  FILE *f         = fopen(path, "r");
+  int x;
+
+  if (f == 0)
+  {
+    fprintf(stderr, "Could not open %s\n", path);
+    return(1);
+  }
+
+  while (fgets(line, sizeof(line), f))
+  {
+    p = line;
+    while (p)
+    {
+      name[0] = 0;
+      if (source)
+      {
+        // next string literal on the line
+        p   = strchr(p, '"');
+        end = p ? strchr(p + 1, '"') : 0;
+        if (end == 0)
+          break;
+        if (end - p - 1 < MAX_PATH)
+        {
+          memcpy(name, p + 1, end - p - 1);
+          name[end - p - 1] = 0;
+        }
+        p = end + 1;
+      }
+      else
+      {
+        if (sscanf(line, "%254s", name) != 1 || name[0] == '#')
+          name[0] = 0;
+        p = 0;
+      }
+
+      for (x=0; name[0] && x < count; x++)
+      {
+        if (entries[x].order < 0 && strcmp(entries[x].name, name) == 0)
+          entries[x].order = (*ordered)++;
+      }
+    }
+  }
+  fclose(f);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CompareOrder
+// Summary:  qsort callback, sorts entries by the order they are written in
+// Inputs:   Entries to compare
+// Outputs:  None
+// Returns:  < 0, 0 or > 0 as entry a goes before, with or after b
+// Cautions: None
+//------------------------------------------------------------------------------
+int CompareOrder(const void *a, const void *b)
+{
+  return(((const PackEntry *) a)->order - ((const PackEntry *) b)->order);
+}
+
+//------------------------------------------------------------------------------
+// Name:     Distance
+// Summary:  Returns how far apart 2 positions in an archive are
+// Inputs:   Positions
+// Outputs:  None
+// Returns:  Distance in bytes
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned long Distance(unsigned long from, unsigned long to)
+{
+  return(from > to ? from - to : to - from);
+}
+
+//------------------------------------------------------------------------------
+// Name:     PackEntryData
+// Summary:  Writes the current entry of the input archive to the output,
+//           recompressing it if it is not already in the method wanted
+// Inputs:   1. zip - input archive, positioned on the entry
+//           2. out - output archive
+//           3. entry - entry to write
+//           4. want - method wanted (or METHOD_KEEP)
+//           5. align - the entry's data is placed at a multiple of this
+// Outputs:  entry - method, compressed size & offsets set
+// Returns:  0 on success, non-zero on error
+// Cautions: None
+//------------------------------------------------------------------------------
+int PackEntryData(unzFile zip, FILE *out, PackEntry *entry, int want,
+                  int align)
+{
+  unsigned char *data;
+  unsigned char *packed;
+  unsigned long packedSize;
+  int method, level, pad;
+  int status = 0;
+
+  if (want == METHOD_KEEP || want == entry->inMethod)
+  {
+    // copy the compressed data as is
+    if (unzOpenCurrentFile2(zip, &method, &level, 1) != UNZ_OK)
+      return(1);
+    entry->method = entry->inMethod;
+    packed        = ReadEntry(zip, entry->inSize);
+    packedSize    = entry->inSize;
+  }
+  else
+  {
+    if (unzOpenCurrentFile(zip) != UNZ_OK)
+      return(1);
+    data = ReadEntry(zip, entry->size);
+    if (data == 0 || unzCloseCurrentFile(zip) != UNZ_OK)
+    {
+      fprintf(stderr, "%s: bad data\n", entry->name);
+      free(data);
+      return(1);
+    }
+
+    entry->method = want;
+    packedSize    = entry->size;
+    if (want == Z_DEFLATED)
+      packed = Deflate(data, entry->size, &packedSize);
+    else if (want == LBG_LZ4_METHOD)
+      packed = Lz4(data, entry->size, &packedSize);
+    else
+      packed = data;
+
+    // like other zip tools, store entries that deflate can not shrink
+    if (packed == 0 && want == Z_DEFLATED)
+    {
+      entry->method = 0;
+      packed        = data;
+      packedSize    = entry->size;
+    }
+    if (packed != data)
+      free(data);
+  }
+  unzCloseCurrentFile(zip);
+
+  if (packed == 0)
+    return(1);
+
+  // pad the local header's extra field so the data starts aligned, the
+  // padding needs room for an extra field header of its own
+  entry->offset         = ftell(out);
+  entry->compressedSize = packedSize;
+  pad = (align - (entry->offset + LOCAL_HEADER + strlen(entry->name)) % align)
+        % align;
+  if (pad > 0 && pad < EXTRA_HEADER)
+    pad += ((EXTRA_HEADER - pad + align - 1) / align) * align;
+  entry->header = LOCAL_HEADER + strlen(entry->name) + pad;
+
+  if (WriteLocalHeader(out, entry, pad) ||
+      (packedSize && fwrite(packed, 1, packedSize, out) != packedSize))
+  {
+    fprintf(stderr, "Could not write %s\n", entry->name);
+    status = 1;
+  }
+  free(packed);
+  return(status);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadList
+// Summary:  Reads the entries & methods to use from the list file
+// Inputs:   Path of list file
+// Outputs:  1. list - entries listed (caller must free)
+//           2. count - number of entries listed
+//           3. defMethod - method of entries not listed
+// Returns:  0 on success, non-zero if the file could not be read
+// Cautions: None
+//------------------------------------------------------------------------------
+int ReadList(const char *path, ListEntry **list, int *count, int *defMethod)
+{
+  char line[MAX_PATH * 2];
+  char name[MAX_PATH];
+  char method[MAX_PATH];
+  FILE *f = fopen(path, "r");
+  int status = 0;
+
+  *list      = 0;
+  *count     = 0;
+  *defMethod = METHOD_KEEP;
+  if (f == 0)
+  {
+    fprintf(stderr, "Could not open %s\n", path);
+    return(1);
+  }
+
+  while (fgets(line, sizeof(line), f))
+  {
+    if (sscanf(line, "%254s %254s", name, method) != 2 || name[0] == '#')
+      continue;
+    if (ParseMethod(method) == METHOD_BAD)
+    {
+      fprintf(stderr, "%s: unknown method %s\n", name, method);
+      status = 1;
+      continue;
+    }
+    if (strcmp(name, "*") == 0)
+    {
+      *defMethod = ParseMethod(method);
+      continue;
+    }
+    *list = (ListEntry *) realloc(*list, (*count + 1) * sizeof(ListEntry));
+    strcpy((*list)[*count].name, name);
+    (*list)[*count].method = ParseMethod(method);
+    (*count)++;
+  }
+  fclose(f);
+  return(status);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ParseMethod
+// Summary:  Converts a method name from the list file to a zip method
+// Inputs:   Method name
+// Outputs:  None
+// Returns:  Zip compression method, METHOD_KEEP or METHOD_BAD
+// Cautions: None
+//------------------------------------------------------------------------------
+int ParseMethod(const char *method)
+{
+  if (strcmp(method, "store") == 0)
+    return(0);
+  if (strcmp(method, "deflate") == 0)
+    return(Z_DEFLATED);
+  if (strcmp(method, "lz4") == 0)
+    return(LBG_LZ4_METHOD);
+  if (strcmp(method, "keep") == 0)
+    return(METHOD_KEEP);
+  return(METHOD_BAD);
+}
+
+//------------------------------------------------------------------------------
+// Name:     MethodName
+// Summary:  Returns the name of a zip compression method, for the report
+// Inputs:   Zip compression method
+// Outputs:  None
+// Returns:  Method name
+// Cautions: None
+//------------------------------------------------------------------------------
+const char *MethodName(int method)
+{
+  if (method == 0)
+    return("store");
+  if (method == Z_DEFLATED)
+    return("deflate");
+  if (method == LBG_LZ4_METHOD)
+    return("lz4");
+  return("?");
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadEntry
+// Summary:  Reads all the data of the current (open) entry
+// Inputs:   1. zip - archive
+//           2. size - number of bytes to read (the compressed size if the
+//              entry was opened raw)
+// Outputs:  None
+// Returns:  Pointer to data (caller must free), 0 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned char *ReadEntry(unzFile zip, unsigned long size)
+{
+  unsigned char *data = (unsigned char *) malloc(size ? size : 1);
+
+  if (data && size && unzReadCurrentFile(zip, data, size) != (int) size)
+  {
+    free(data);
+    data = 0;
+  }
+  return(data);
+}
+
+//------------------------------------------------------------------------------
+// Name:     Deflate
+// Summary:  Compresses data with raw deflate, as zip entries hold it
+// Inputs:   1. data - data to compress
+//           2. size - size of data
+// Outputs:  packedSize - size of compressed data
+// Returns:  Pointer to compressed data (caller must free), 0 if it does not
+//           get smaller
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned char *Deflate(unsigned char *data, unsigned long size,
+                       unsigned long *packedSize)
+{
+  unsigned char *packed = (unsigned char *) malloc(size ? size : 1);
+  z_stream stream;
+
+  memset(&stream, 0, sizeof(stream));
+  if (packed == 0 || deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED,
+                                  -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    free(packed);
+    return(0);
+  }
+  stream.next_in   = data;
+  stream.avail_in  = size;
+  stream.next_out  = packed;
+  stream.avail_out = size;
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+  {
+    free(packed);
+    packed = 0;
+  }
+  *packedSize = stream.total_out;
+  deflateEnd(&stream);
+  return(packed);
+}
+
+//------------------------------------------------------------------------------
+// Name:     Lz4
+// Summary:  Compresses data into LZ4 blocks (see lbg_lz4.h)
+// Inputs:   1. data - data to compress
+//           2. size - size of data
+// Outputs:  packedSize - size of compressed data
+// Returns:  Pointer to compressed data (caller must free), 0 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned char *Lz4(unsigned char *data, unsigned long size,
+                   unsigned long *packedSize)
+{
+  int bound             = LBG_LZ4PackBound(size);
+  unsigned char *packed = (unsigned char *) malloc(bound ? bound : 1);
+  int result;
+
+  if (packed == 0)
+    return(0);
+  result = LBG_LZ4Pack(data, size, packed, bound);
+  if (result < 0)
+  {
+    free(packed);
+    return(0);
+  }
+  *packedSize = result;
+  return(packed);
+}
+
+//------------------------------------------------------------------------------
+// Name:     WriteLocalHeader
+// Summary:  Writes the local header that comes before an entry's data
+// Inputs:   1. out - archive being written
+//           2. entry - entry to write header for
+//           3. pad - size of padding extra field, 0 or at least EXTRA_HEADER
+// Outputs:  None
+// Returns:  0 on success, non-zero on write error
+// Cautions: None
+//------------------------------------------------------------------------------
+int WriteLocalHeader(FILE *out, PackEntry *entry, int pad)
+{
+  unsigned char header[LOCAL_HEADER];
+  int nameLen = strlen(entry->name);
+
+  PutLong(&header[0], 0x04034b50);
+  PutShort(&header[4], 20);                    // version needed
+  PutShort(&header[6], 0);                     // flags
+  PutShort(&header[8], entry->method);
+  PutLong(&header[10], entry->dosDate);
+  PutLong(&header[14], entry->crc);
+  PutLong(&header[18], entry->compressedSize);
+  PutLong(&header[22], entry->size);
+  PutShort(&header[26], nameLen);
+  PutShort(&header[28], pad);                  // extra field length
+
+  if (fwrite(header, 1, LOCAL_HEADER, out) != LOCAL_HEADER ||
+      fwrite(entry->name, 1, nameLen, out) != (size_t) nameLen)
+    return(1);
+
+  if (pad)
+  {
+    PutShort(&header[0], ALIGN_EXTRA_ID);
+    PutShort(&header[2], pad - EXTRA_HEADER);
+    if (fwrite(header, 1, EXTRA_HEADER, out) != EXTRA_HEADER)
+      return(1);
+    for (pad -= EXTRA_HEADER; pad > 0; pad--)
+      fputc(0, out);
+  }
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     WriteDirectory
+// Summary:  Writes the central directory & end of central directory record
+// Inputs:   1. out - archive being written, positioned after the last entry
+//           2. entries - entries written
+//           3. count - number of entries
+// Outputs:  None
+// Returns:  0 on success, non-zero on write error
+// Cautions: None
+//------------------------------------------------------------------------------
+int WriteDirectory(FILE *out, PackEntry *entries, int count)
+{
+  unsigned char header[CENTRAL_HEADER];
+  unsigned long start = ftell(out);
+  int nameLen, x;
+
+  for (x=0; x < count; x++)
+  {
+    nameLen = strlen(entries[x].name);
+    PutLong(&header[0], 0x02014b50);
+    PutShort(&header[4], 20);                  // version made by
+    PutShort(&header[6], 20);                  // version needed
+    PutShort(&header[8], 0);                   // flags
+    PutShort(&header[10], entries[x].method);
+    PutLong(&header[12], entries[x].dosDate);
+    PutLong(&header[16], entries[x].crc);
+    PutLong(&header[20], entries[x].compressedSize);
+    PutLong(&header[24], entries[x].size);
+    PutShort(&header[28], nameLen);
+    PutShort(&header[30], 0);                  // extra field length
+    PutShort(&header[32], 0);                  // comment length
+    PutShort(&header[34], 0);                  // disk number
+    PutShort(&header[36], entries[x].internalAttr);
+    PutLong(&header[38], entries[x].externalAttr);
+    PutLong(&header[42], entries[x].offset);
+
+    if (fwrite(header, 1, CENTRAL_HEADER, out) != CENTRAL_HEADER ||
+        fwrite(entries[x].name, 1, nameLen, out) != (size_t) nameLen)
+      return(1);
+  }
+
+  PutLong(&header[0], 0x06054b50);
+  PutShort(&header[4], 0);                     // this disk
+  PutShort(&header[6], 0);                     // disk with directory
+  PutShort(&header[8], count);                 // entries on this disk
+  PutShort(&header[10], count);                // entries in total
+  PutLong(&header[12], ftell(out) - start);    // size of directory
+  PutLong(&header[16], start);
+  PutShort(&header[20], 0);                    // comment length
+  if (fwrite(header, 1, END_HEADER, out) != END_HEADER)
+    return(1);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     VerifyArchive
+// Summary:  Reads back every entry of an archive, checking its CRC
+// Inputs:   Path of archive
+// Outputs:  None
+// Returns:  0 if every entry is good, non-zero otherwise
+// Cautions: None
+//------------------------------------------------------------------------------
+int VerifyArchive(const char *path)
+{
+  unzFile zip = unzOpen(path);
+  unz_file_info info;
+  char name[MAX_PATH];
+  unsigned char *data;
+  int err;
+  int status = 0;
+
+  if (zip == 0)
+  {
+    fprintf(stderr, "Could not open %s\n", path);
+    return(1);
+  }
+  for (err=unzGoToFirstFile(zip); err == UNZ_OK; err=unzGoToNextFile(zip))
+  {
+    data = 0;
+    if (unzGetCurrentFileInfo(zip, &info, name, MAX_PATH,
+                              0, 0, 0, 0) != UNZ_OK ||
+        unzOpenCurrentFile(zip) != UNZ_OK ||
+        (data = ReadEntry(zip, info.uncompressed_size)) == 0 ||
+        unzCloseCurrentFile(zip) != UNZ_OK)
+    {
+      fprintf(stderr, "%s: verify failed\n", name);
+      unzCloseCurrentFile(zip);
+      status = 1;
+    }
+    free(data);
+  }
+  unzClose(zip);
+  unzFreeContextPool();
+  return(status);
+}
+
+//------------------------------------------------------------------------------
+// Name:     PutShort
+// Summary:  Stores a 16 bit value (little endian)
+// Inputs:   1. Where to store value
+//           2. Value to store
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void PutShort(unsigned char *p, unsigned long value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+}
+
+//------------------------------------------------------------------------------
+// Name:     PutLong
+// Summary:  Stores a 32 bit value (little endian)
+// Inputs:   1. Where to store value
+//           2. Value to store
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void PutLong(unsigned char *p, unsigned long value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
@@ -54,6 +54,7 @@
 #include "menu_manager.h"
 #include "cc_manager.h"
 #include "sce_graphics.h"
+#include "text_manager.h"
 
 // Structure used by PNG library to copy entire PNG image to memory
 // rather than to a file.
@@ -169,6 +170,8 @@ int main(int argc, char *argv[])
   // function exits (the user selects "start game" and this sound is played
   // as the function exits).  to combat this issue, we simply load it 1 time
   // in main and let it stay in memory throughout the entire game.
+  if (ZIP_Init())
+    EH_Error(EH_SEVERE, "ZIP_Init failed, could not open data.lbg.");
   ZIP_OpenZipFile(ZIP_MAIN);
   ding = ZIP_LoadMusic("ding.wav");
   ZIP_CloseZipFile();
@@ -185,6 +188,14 @@ int main(int argc, char *argv[])
   HM_Init();
   RM_Init();
   MUNU_Init(argv[0]); // argv[0] should be path and name of this program
+#ifdef MM_PROFILE
+  TXT_ProfileRender();
+  MENU_ProfileWrap();
+  MENU_ProfileText();
+  SCE_ProfileVram();
+  DL_ProfileDrawList();
+  SCE_ProfileCommands();
+#endif
 
   // Main Controll Loop (where all the majick takes place)
   while (_gameState != MM_STATE_EXIT)
@@ -193,6 +204,21 @@ int main(int argc, char *argv[])
     {
       gameLevel  = MENU_DrawMain(&event, gameLevel, ding);
       _gameState = MM_STATE_INITIALIZE;
+#ifdef MM_PROFILE
+      {
+        ZIP_Stats stats;
+        ZIP_GetStats(&stats);
+        EH_Error(EH_DEBUG, "ZIP sessions %u, archive opens %u, "
+                 "contexts created %u reused %u, cache hits %u misses %u "
+                 "evictions %u (%uK), text hits %u misses %u evictions %u "
+                 "(%uK)\n", stats.sessions, 
+                 stats.archiveOpens, stats.contextsCreated, 
+                 stats.contextsReused, stats.cacheHits, stats.cacheMisses,
+                 stats.cacheEvictions, stats.cacheBytes / 1024, 
+                 stats.textHits, stats.textMisses, stats.textEvictions,
+                 stats.textBytes / 1024);
+      }
+#endif
     }
     if (_gameState == MM_STATE_INITIALIZE)
     {
@@ -228,6 +254,8 @@ int main(int argc, char *argv[])
   }
 
   // Clean up your mess before exiting
+  TXT_FlushAtlases();
+  ZIP_Quit();
   if(_joystick)
     SDL_JoystickClose(_joystick);
   SDL_Quit();
@@ -342,6 +370,7 @@ void RunLevelOne(SDL_Event *event)
     // Afterwords it will be safe to draw to backbuffer.
     SDL_SemWait(_sem);
     DL_DrawImages();
+    SCE_FlushFrame();
     //EH_DrawErrors();  // Activate for debugging
 
     // manage game framerate
@@ -378,10 +407,19 @@ void InitializeLevel(unsigned int gameLevel, SDL_Event *event)
 
     // Only draw load screen if resources for level 1 are not allready loaded
     if (RM_GetLastLevelLoaded() != MM_LEVEL1)
+    {
       MENU_DrawLoadScreen();
+      RM_SetProgressFunction(MENU_UpdateLoadScreen);
+    }
 
-    ZIP_OpenZipFile(ZIP_MAIN);
+    ZIP_OpenZipFile(ZIP_MAIN | ZIP_LEVEL1);
     RM_InitLevel (gameLevel);
+    RM_SetProgressFunction(0);
+#ifdef MM_PROFILE
+    SCE_ProfileBlit("shelf", RM_GetImage(GEN_SHELF_B_SPRITE), 1);
+    SCE_ProfileBlit("tent",  RM_GetImage(TENT_GREEN),         2);
+    SCE_ProfileBlit("hero",  RM_GetImage(RM_IMG_HERO),        8);
+#endif
     BG_InitLevel (gameLevel);
     DL_InitLevel (gameLevel);
     PM_InitLevel (gameLevel);
@@ -391,8 +429,24 @@ void InitializeLevel(unsigned int gameLevel, SDL_Event *event)
     ZIP_CloseZipFile();
     _gameState = MM_STATE_RUNNING;
     RM_PlaySoundLoop(RM_SFX_LEVEL1_MUSIC);
+#ifdef MM_PROFILE
+    SCE_CmdStats before, after;
+    SCE_GetFrameStats(0, &before);
+#endif
     RunLevelOne(event);
     Mix_HaltChannel(-1);  // stop all music after exiting level 1 loop
+#ifdef MM_PROFILE
+    SCE_GetFrameStats(0, &after);
+    if (after.flushes > before.flushes)
+    {
+      unsigned int frames = after.flushes - before.flushes;
+      EH_Error(EH_DEBUG, "SCE %u frames: %u commands, %u pixels, %uus "
+               "flushing a frame\n", frames, 
+               (after.commands - before.commands) / frames,
+               (after.pixels - before.pixels) / frames,
+               (after.flushUs - before.flushUs) / frames);
+    }
+#endif
   }
   // initialize and start the final level
   else if (gameLevel == MM_LEVEL_FINAL)
@@ -581,6 +635,7 @@ void TakeScreenShot()
     SDL_SemWait(_sem);  // wait until background is drawn
     SDL_SemPost(_sem);  // post, so main thread is not effected
     DL_DrawImages();    // draw full frame
+    SCE_FlushFrame();
     // copy screen buffer to memory
     memcpy(_scrShotBuf, pixels, sizeof(_scrShotBuf));
     // create "Screenshot Started" sprite
@@ -784,6 +839,38 @@ int MM_Abs(int val)
   return(val);
 }
 
+//------------------------------------------------------------------------------
+// Name:     MM_IsScreenFormat
+// Summary:  Checks if a surface's pixels are allready in the screen format, 
+//           in which case there is no need to SDL_ConvertSurface it
+// Inputs:   Surface to check
+// Outputs:  None
+// Returns:  1 if surface is in screen format, else 0
+// Cautions: Does not look at the surface flags
+//------------------------------------------------------------------------------
+int MM_IsScreenFormat(SDL_Surface *s)
+{
+  SDL_PixelFormat *a = s->format;
+  SDL_PixelFormat *b = _scr->format;
+  
+  return(a->BitsPerPixel == b->BitsPerPixel && a->Rmask == b->Rmask && 
+         a->Gmask == b->Gmask && a->Bmask == b->Bmask && 
+         a->Amask == b->Amask);
+}
+
+//------------------------------------------------------------------------------
+// Name:     MM_GetMicroSeconds
+// Summary:  Debug function used to time sections of code
+// Inputs:   None
+// Outputs:  None
+// Returns:  Current value of the system timer (in microseconds)
+// Cautions: Timer wraps every ~71 minutes, only use it for short intervals
+//------------------------------------------------------------------------------
+unsigned int MM_GetMicroSeconds()
+{
+  return(sceKernelGetSystemTimeLow());
+}
+
 //------------------------------------------------------------------------------
 // Name:     MM_GetFreeRam
 // Summary:  Debug function used to determine how much free ram is available
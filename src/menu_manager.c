@@ -16,12 +16,63 @@
 #include "bg_manager.h"
 #include "SDL_framerate.h"
 #include "power_manager.h"
+#include "text_manager.h"
 #include <pspkernel.h>
+
+// Position of the progress bar on the load screen
+#define LOAD_BAR_X       40
+#define LOAD_BAR_Y      (MM_SCREEN_HEIGHT - 12)
+#define LOAD_BAR_WIDTH  (MM_SCREEN_WIDTH - 80)
+#define LOAD_BAR_HEIGHT  4
+#define LOAD_PULSE_WIDTH 24     // light band sweeping along the empty bar
+#define LOAD_PULSE_MS     4     // ms the band takes to move 1 pixel
 
+#define NUM_QUOTES       35     // quotes shown on the load screen
+
 
 static SDL_Surface *_scr;
 static char        _homeDir[255];
 
+// 1 of these is shown while a level loads
+static const char *_quotes[NUM_QUOTES] =
+{
+  "There is no theory of evolution. Just a list of animals Chuck Norris allows to live.\n-Unknown",
+  "The chief export of Chuck Norris is Pain.\n-Unknown",
+  "That's it man.  Game over man... Game over!\n-Bill Paxton (Aliens)",
+  "They mostly come out at night, mostly.\n-Newt (Aliens)",
+  "Zed's dead baby... Zed's dead.\n-Bruce Willis (Pulp Fiction)",
+  "Hello, my name is Inigo Montoya. You killed my father: prepare to die.\n-Inigo Montoya (Princess Bride)",
+  "When my people come to colonize this planet, you will be on the protected rolls, and no harm will come to you.\n-Dan Aykroyd (Coneheads)",
+  "I'm sorry, Dave. I'm afraid I can't do that.\n-HAL 9000 (2001 A Space Odyssey)",
+  "Oh not to worry Charlie, you'll go to Heaven.  All Dog's go to heaven...\n-Whippet Angel (All Dogs Go To Heaven)",
+  "Well, ain't this place a geographical oddity. Two weeks from everywhere!\n-George Clooney (O Brother Where Art Thou)",
+  "No thank you, Delmar. One third of a gopher would only arouse my appetite without bedding it down.\n-George Clooney (O Brother Where Art Thou)",
+  "We are not enemies, but friends. We must not be enemies. Though passion may have strained it must not break our bonds of affection. The mystic chords of memory, stretching from every battlefield and patriot grave to every living heart and hearthstone all over this broad land, will yet swell the chorus of the Union, when again touched, as surely they will be, by the better angels of our nature.\n-Abraham Lincoln (First Inaugural Address)",
+  "Both parties deprecated war; but one of them would make war rather than let the nation survive; and the other would accept war rather than let it perish. And the war came.\n-Abraham Lincoln (Second Inaugural Address)\n",
+  "It's not a tumor!\n-Arnold Schwarzenegger (Kindergarten Cop)",
+  "Based on the findings of the report, my conclusion was that this idea was not a practical deterrent for reasons which at this moment must be all too obvious.\n-Dr. Strangelove (Dr. Strangelove)",
+  "One hippo, alone once more, misses the other forty-four.\n-Sandra Boynton (Hippos Go Berserk)",
+  "Please God! We need a cab!\n-Randy Quaid (Quick Change)",
+  "This famous linguist once said that of all the phrases in the English language, of all the endless combinations of words in all of history, that Cellar Door is the most beautiful.\n-Drew Barrymore (Donnie Darko)",
+  "He Didn't fall? INCONCEIVABLE.\n-Vizzini\nYou keep using that word. I do not think it means what you think it means.\n-Inigo Montoya (The Princess Bride)",
+  "Hey, we all need friends in here. I could be a friend to you.\n-Boggs (The Shawshank Redemption)",
+  "I have to remind myself that some birds aren't meant to be caged. Their feathers are just too bright. And when they fly away, the part of you that knows it was a sin to lock them up DOES rejoice. Still, the place you live in is that much more drab and empty that they're gone.\n-Morgan Freeman (The Shawshank Redemption)",
+  "These aren't the droids you're looking for.\n-Sir Alec Guinness (Star Wars)",
+  "Aw, but I was going to Tashi station to pick up some power converters!\n-Mark Hamill (Star Wars)",
+  "LET'S ROCK!\n-Vasquez (Aliens)",
+  "You're my boy, Blue!\n-Will Ferrell (Old School)",
+  "What's the matter, Colonel Sandurz? CHICKEN?\n-Dark Helmet (Spaceballs)",
+  "You are right, I have always known about man. From the evidence, I believe his wisdom must walk hand and hand with his idiocy. His emotions must rule his brain. He must be a warlike creature who gives battle to everything around him, even himself.\n-Dr. Zaius (Planet Of The Apes)",
+  "Take your stinking paws off me, you damned dirty ape!\n-Charlton Heston (Planet Of The Apes)",
+  "This is for all you new people: I only have one rule. Everyone fights. No one quits. You don't do your job, I'll shoot you myself. You get me?\n-Jean Rasczak (Starship Troopers)",
+  "The Skynet Funding Bill is passed. The system goes on-line August 4th, 1997. Human decisions are removed from strategic defense. Skynet begins to learn at a geometric rate. It becomes self-aware at 2:14 a.m. Eastern time, August 29th. In a panic, they try to pull the plug.\n-Arnold Schwarzenegger (Terminator 2)",
+  "First of all, Papa Smurf didn't create Smurfette. Gargamel did. She was sent in as Gargamel's evil spy with the intention of destroying the Smurf village. But the overwhelming goodness of the Smurf way of life transformed her.\n-Jake Gyllenhaal (Donnie Darko)",
+  "Indy! Cover your heart! Cover your heart!\n-Short Round (Indiana Jones and the Temple of Doom)",
+  "Playing with my money is like playing with my emotions, Smokey.\n-Big Worm (Friday)",
+  "No sugar? Damn. Y'all ain't never got two things that match. Either ya got Kool-aid, no sugar. Peanut butter, no jelly. Ham, no burger. Daaamn.\n-Smokey (Friday)",
+  "Oh, the THINKS you can think up if only you try!\n-Dr. Seuss (Oh, The THINKS You Can Think)"
+};
+
 //------------------------------------------------------------------------------
 // Name:     MUNU_Init
 // Summary:  Initializes Menu Manager, called 1 time and 1 time only
@@ -76,7 +127,6 @@ unsigned int MENU_DrawMain(SDL_Event *event, unsigned int gameLevel,
   SDL_Surface *textImg;
   SDL_Surface *cursorImg;
   SDL_Surface *versionImg;
-  SDL_Surface *tmp;
   int         channel;
   int         chanSel       = -1;
   int         chanDing      = 5;
@@ -89,16 +139,15 @@ unsigned int MENU_DrawMain(SDL_Event *event, unsigned int gameLevel,
   SDL_Rect    cursorRecDst2 = {160, 180, 0, 0};
   SDL_Rect    *cursorRecDst = &cursorRecDst1;
   
+  // cached, so coming back to the menu does not load them again
   ZIP_OpenZipFile(ZIP_MAIN);
-  music          = ZIP_LoadMusic("theme.wav");
-  select         = ZIP_LoadMusic("menu_select.wav");
+  music          = ZIP_GetMusic(0, "theme.wav");
+  select         = ZIP_GetMusic(0, "menu_select.wav");
   channel        = Mix_PlayChannel(-1, music, 0);
-  tmp            = ZIP_LoadImage("startscreen.bmp");
-  textImg        = ZIP_LoadImage("start_text.png");
-  cursorImg      = ZIP_LoadImage("cursor.png");
-  versionImg     = ZIP_LoadImage("version.png");
-  startScreenImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE);  
-  SDL_FreeSurface(tmp);
+  startScreenImg = ZIP_GetImage(0, "startscreen.bmp", ZIP_IMG_SCREEN);
+  textImg        = ZIP_GetImage(0, "start_text.png", 0);
+  cursorImg      = ZIP_GetImage(0, "cursor.png", 0);
+  versionImg     = ZIP_GetImage(0, "version.png", 0);
   ZIP_CloseZipFile();
   
   // draw main menu
@@ -164,13 +213,13 @@ unsigned int MENU_DrawMain(SDL_Event *event, unsigned int gameLevel,
   Mix_HaltChannel(channel);
   if (chanSel != -1)  // only halt channel if it was started
     Mix_HaltChannel(chanSel);
-  Mix_FreeChunk(music);
-  Mix_FreeChunk(select);
+  ZIP_ReleaseMusic(music);
+  ZIP_ReleaseMusic(select);
   
-  SDL_FreeSurface(startScreenImg);
-  SDL_FreeSurface(textImg);
-  SDL_FreeSurface(cursorImg);
-  SDL_FreeSurface(versionImg);
+  ZIP_ReleaseImage(startScreenImg);
+  ZIP_ReleaseImage(textImg);
+  ZIP_ReleaseImage(cursorImg);
+  ZIP_ReleaseImage(versionImg);
   return(gameLevel);
 }
 
@@ -211,12 +260,10 @@ unsigned int MENU_DrawOptions(SDL_Event *event, SDL_Surface *startScreenImg,
   ZIP_CloseZipFile();
 
   // Create options text
-  mainMenuImg        = TTF_RenderText_Blended(f1->f, "Main Menu", fgColor);
-  enterCodeImg       = TTF_RenderText_Blended(f1->f, "Enter Code", fgColor);
-  configMenuImg      = TTF_RenderText_Blended(f1->f, 
-                                              "Configure Controls", fgColor);
-  viewScreenShotsImg = TTF_RenderText_Blended(f1->f, 
-                                              "View Screenshots", fgColor);
+  mainMenuImg        = ZIP_RenderText(f1, "Main Menu", fgColor);
+  enterCodeImg       = ZIP_RenderText(f1, "Enter Code", fgColor);
+  configMenuImg      = ZIP_RenderText(f1, "Configure Controls", fgColor);
+  viewScreenShotsImg = ZIP_RenderText(f1, "View Screenshots", fgColor);
   
   // fade start screen image
   SDL_SetAlpha(startScreenImg, SDL_SRCALPHA, 100);  
@@ -305,11 +352,11 @@ unsigned int MENU_DrawOptions(SDL_Event *event, SDL_Surface *startScreenImg,
       selection = 3;
   }
   
+  ZIP_ReleaseText(enterCodeImg);
+  ZIP_ReleaseText(viewScreenShotsImg);
+  ZIP_ReleaseText(mainMenuImg);
+  ZIP_ReleaseText(configMenuImg);
   ZIP_CloseFont(f1);
-  SDL_FreeSurface(enterCodeImg);
-  SDL_FreeSurface(viewScreenShotsImg);
-  SDL_FreeSurface(mainMenuImg);
-  SDL_FreeSurface(configMenuImg);
   SDL_SetAlpha(startScreenImg, SDL_SRCALPHA, 255);  
   return(gameLevel);
 }
@@ -338,7 +385,8 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
   SDL_Surface *img     = 0;
   SDL_Surface *infoImg = 0;
   SDL_Surface *txtImg  = 0; 
-  SDL_Surface *nameImg = 0;
+  TXT_Atlas *nameTxt   = 0;
+  int nameW, nameH;
   SDL_Color fgColor    = {255,0,0};
   SDL_Rect txtRecDst   = {0,0,0,0};
   SDL_Rect nameRecDst  = {0,0,0,0};
@@ -399,7 +447,8 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
   else
   {
     ZIP_OpenZipFile(ZIP_MAIN);
-    f1 = ZIP_LoadFont(ZIP_FONT1, 12);
+    f1      = ZIP_LoadFont(ZIP_FONT1, 12);
+    nameTxt = TXT_GetAtlas(ZIP_FONT1, 12, TTF_STYLE_NORMAL, fgColor);
     ZIP_CloseZipFile();
     
     // Create surface used to toggle information about current image to user
@@ -408,6 +457,7 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
               _scr->format->Gmask, _scr->format->Bmask, _scr->format->Amask);
     SDL_FillRect(infoImg, 0, 0);
     SDL_SetAlpha(infoImg, SDL_SRCALPHA, 225);
+    txtImg = ZIP_RenderText(f1, "Left Trigger=Prev    Start=Main Menu    Select=Toggle Info    Right Trigger=Next", fgColor);
 
     // Loop used to process user input and display selected image
     while (loop)
@@ -415,13 +465,9 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
       // User has selected a new image, update the image information window
       if(newImage)
       {
-        // Free old image and image information
+        // Free old image
         if (img)
           SDL_FreeSurface(img);
-        if (txtImg)
-          SDL_FreeSurface(txtImg);
-        if (nameImg)
-          SDL_FreeSurface(nameImg); 
           
         if (index < 0)
           index = count-1;
@@ -432,10 +478,9 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
         newImage = 0;
         img      = IMG_Load(buffer[index]);  
         sprintf(buf, "Image: %s/%s", _homeDir, buffer[index]);
-        txtImg  = TTF_RenderText_Blended(f1->f, "Left Trigger=Prev    Start=Main Menu    Select=Toggle Info    Right Trigger=Next", fgColor);
-        nameImg = TTF_RenderText_Blended(f1->f, buf, fgColor);
+        TXT_SizeText(nameTxt, buf, &nameW, &nameH);
         txtRecDst.x  = (MM_SCREEN_WIDTH - txtImg->w) / 2;
-        nameRecDst.x = (MM_SCREEN_WIDTH - nameImg->w) / 2;
+        nameRecDst.x = (MM_SCREEN_WIDTH - nameW) / 2;
         nameRecDst.y = txtImg->h - 5;
       }
 
@@ -445,7 +490,7 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
       {
         SDL_BlitSurface(infoImg, 0, _scr, 0);
         SDL_BlitSurface(txtImg,  0, _scr, &txtRecDst);
-        SDL_BlitSurface(nameImg, 0, _scr, &nameRecDst);
+        TXT_DrawText(nameTxt, buf, _scr, nameRecDst.x, nameRecDst.y);
       }
       
       sceDisplayWaitVblankStart();
@@ -488,10 +533,10 @@ void MENU_DrawViewScreenshots(SDL_Event *event)
     }      // END while (loop)
     
     // Free all image information
-    ZIP_CloseFont(f1);
     SDL_FreeSurface(img);
-    SDL_FreeSurface(txtImg);
-    SDL_FreeSurface(nameImg); 
+    ZIP_ReleaseText(txtImg);
+    ZIP_CloseFont(f1);
+    TXT_ReleaseAtlas(nameTxt); 
     SDL_FreeSurface(infoImg); 
   } 
   
@@ -956,75 +1001,32 @@ unsigned int MENU_DrawEnterCode(SDL_Event *event, unsigned int gameLevel)
 //------------------------------------------------------------------------------
 void MENU_DrawLoadScreen()
 {
-  #define NUM_QUOTES 35
-  int i, w, h;
+  #define MAX_QUOTE_LINES 16
   int rand;
-  int length;
-  char *quotes[NUM_QUOTES];
-  char *p;
-  char buffer[500];
+  int count;
+  TXT_Line lines[MAX_QUOTE_LINES];
   ZIP_Font *f1;
-  ZIP_Font *f2;
   ZIP_Font *f3;
-  int lastSpace            = 0;
-  int start                = 0;
-  SDL_Surface *txtImg      = 0;
+  TXT_Atlas *quote;
   SDL_Surface *titleImg    = 0;
   SDL_Surface *subTitleImg = 0;
   SDL_Surface *loadImg     = 0;
   SDL_Color color          = {255,255,255};
   SDL_Rect dst             = {0,0,0,0};
 
-  quotes[0]  = "There is no theory of evolution. Just a list of animals Chuck Norris allows to live.\n-Unknown";
-  quotes[1]  = "The chief export of Chuck Norris is Pain.\n-Unknown";
-  quotes[2]  = "That's it man.  Game over man... Game over!\n-Bill Paxton (Aliens)";
-  quotes[3]  = "They mostly come out at night, mostly.\n-Newt (Aliens)";
-  quotes[4]  = "Zed's dead baby... Zed's dead.\n-Bruce Willis (Pulp Fiction)";
-  quotes[5]  = "Hello, my name is Inigo Montoya. You killed my father: prepare to die.\n-Inigo Montoya (Princess Bride)";
-  quotes[6]  = "When my people come to colonize this planet, you will be on the protected rolls, and no harm will come to you.\n-Dan Aykroyd (Coneheads)";
-  quotes[7]  = "I'm sorry, Dave. I'm afraid I can't do that.\n-HAL 9000 (2001 A Space Odyssey)";
-  quotes[8]  = "Oh not to worry Charlie, you'll go to Heaven.  All Dog's go to heaven...\n-Whippet Angel (All Dogs Go To Heaven)";
-  quotes[9]  = "Well, ain't this place a geographical oddity. Two weeks from everywhere!\n-George Clooney (O Brother Where Art Thou)";
-  quotes[10] = "No thank you, Delmar. One third of a gopher would only arouse my appetite without bedding it down.\n-George Clooney (O Brother Where Art Thou)";
-  quotes[11] = "We are not enemies, but friends. We must not be enemies. Though passion may have strained it must not break our bonds of affection. The mystic chords of memory, stretching from every battlefield and patriot grave to every living heart and hearthstone all over this broad land, will yet swell the chorus of the Union, when again touched, as surely they will be, by the better angels of our nature.\n-Abraham Lincoln (First Inaugural Address)";
-  quotes[12] = "Both parties deprecated war; but one of them would make war rather than let the nation survive; and the other would accept war rather than let it perish. And the war came.\n-Abraham Lincoln (Second Inaugural Address)\n";
-  quotes[13] = "It's not a tumor!\n-Arnold Schwarzenegger (Kindergarten Cop)";
-  quotes[14] = "Based on the findings of the report, my conclusion was that this idea was not a practical deterrent for reasons which at this moment must be all too obvious.\n-Dr. Strangelove (Dr. Strangelove)";
-  quotes[15] = "One hippo, alone once more, misses the other forty-four.\n-Sandra Boynton (Hippos Go Berserk)";
-  quotes[16] = "Please God! We need a cab!\n-Randy Quaid (Quick Change)";
-  quotes[17] = "This famous linguist once said that of all the phrases in the English language, of all the endless combinations of words in all of history, that Cellar Door is the most beautiful.\n-Drew Barrymore (Donnie Darko)";
-  quotes[18] = "He Didn't fall? INCONCEIVABLE.\n-Vizzini\nYou keep using that word. I do not think it means what you think it means.\n-Inigo Montoya (The Princess Bride)";
-  quotes[19] = "Hey, we all need friends in here. I could be a friend to you.\n-Boggs (The Shawshank Redemption)";
-  quotes[20] = "I have to remind myself that some birds aren't meant to be caged. Their feathers are just too bright. And when they fly away, the part of you that knows it was a sin to lock them up DOES rejoice. Still, the place you live in is that much more drab and empty that they're gone.\n-Morgan Freeman (The Shawshank Redemption)";
-  quotes[21] = "These aren't the droids you're looking for.\n-Sir Alec Guinness (Star Wars)";
-  quotes[22] = "Aw, but I was going to Tashi station to pick up some power converters!\n-Mark Hamill (Star Wars)";
-  quotes[23] = "LET'S ROCK!\n-Vasquez (Aliens)";
-  quotes[24] = "You're my boy, Blue!\n-Will Ferrell (Old School)";
-  quotes[25] = "What's the matter, Colonel Sandurz? CHICKEN?\n-Dark Helmet (Spaceballs)"; 
-  quotes[26] = "You are right, I have always known about man. From the evidence, I believe his wisdom must walk hand and hand with his idiocy. His emotions must rule his brain. He must be a warlike creature who gives battle to everything around him, even himself.\n-Dr. Zaius (Planet Of The Apes)";
-  quotes[27] = "Take your stinking paws off me, you damned dirty ape!\n-Charlton Heston (Planet Of The Apes)";
-  quotes[28] = "This is for all you new people: I only have one rule. Everyone fights. No one quits. You don't do your job, I'll shoot you myself. You get me?\n-Jean Rasczak (Starship Troopers)";
-  quotes[29] = "The Skynet Funding Bill is passed. The system goes on-line August 4th, 1997. Human decisions are removed from strategic defense. Skynet begins to learn at a geometric rate. It becomes self-aware at 2:14 a.m. Eastern time, August 29th. In a panic, they try to pull the plug.\n-Arnold Schwarzenegger (Terminator 2)"; 
-  quotes[30] = "First of all, Papa Smurf didn't create Smurfette. Gargamel did. She was sent in as Gargamel's evil spy with the intention of destroying the Smurf village. But the overwhelming goodness of the Smurf way of life transformed her.\n-Jake Gyllenhaal (Donnie Darko)";
-  quotes[31] = "Indy! Cover your heart! Cover your heart!\n-Short Round (Indiana Jones and the Temple of Doom)";
-  quotes[32] = "Playing with my money is like playing with my emotions, Smokey.\n-Big Worm (Friday)";
-  quotes[33] = "No sugar? Damn. Y'all ain't never got two things that match. Either ya got Kool-aid, no sugar. Peanut butter, no jelly. Ham, no burger. Daaamn.\n-Smokey (Friday)";
-  quotes[34] = "Oh, the THINKS you can think up if only you try!\n-Dr. Seuss (Oh, The THINKS You Can Think)";
   
   
   ZIP_OpenZipFile(ZIP_MAIN);
-  f1 = ZIP_LoadFont(ZIP_FONT2, 30);
-  f2 = ZIP_LoadFont(ZIP_FONT2, 12);
-  f3 = ZIP_LoadFont(ZIP_FONT2, 13);
+  f1    = ZIP_LoadFont(ZIP_FONT2, 30);
+  f3    = ZIP_LoadFont(ZIP_FONT2, 13);
+  quote = TXT_GetAtlas(ZIP_FONT2, 12, TTF_STYLE_NORMAL, color);
   ZIP_CloseZipFile();
   
   rand = MM_RandomNumberGen(0, NUM_QUOTES-1);
-  strcpy(buffer, quotes[rand]);
-  p = &buffer[0];
   
-  titleImg    = TTF_RenderText_Blended(f1->f, "Mega-Mart", color);
-  subTitleImg = TTF_RenderText_Blended(f3->f, "or: How I Learned To Stop Living In Poverty And Love The Corporation", color);
-  loadImg     = TTF_RenderText_Blended(f3->f, "Now Loading...", color);
+  titleImg    = ZIP_RenderText(f1, "Mega-Mart", color);
+  subTitleImg = ZIP_RenderText(f3, "or: How I Learned To Stop Living In Poverty And Love The Corporation", color);
+  loadImg     = ZIP_RenderText(f3, "Now Loading...", color);
   
   SDL_FillRect(_scr, 0, 0);
   dst.x = (MM_SCREEN_WIDTH/2) - (titleImg->w/2);
@@ -1040,84 +1042,60 @@ void MENU_DrawLoadScreen()
   
   dst.y += loadImg->h + 20;
   
-  length = strlen(p);
-  
-  for (i=0; i < length+1; i++)
-  {
-    if (p[i] == ' ')  // break sentance on spaces
-    {
-      p[i] = 0;  // set end of string to current space
-      // get length of current string
-      TTF_SizeText(f2->f, &p[start], &w, &h); 
-      p[i] = ' '; // turn null back into space
-      // if string is too long, print what we have so far
-      if (w > MM_SCREEN_WIDTH) 
-      {
-        // Special check for cases where > SW consecutive characters appear
-        if (lastSpace<start) lastSpace = i;
-        // find last space that did NOT make the string too long
-        p[lastSpace] = 0; 
-        txtImg = TTF_RenderText_Blended(f2->f, &p[start], color);
-        start = lastSpace+1; // set new start of screen to the very next space
-      }
-      lastSpace = i; // allways set the last space to the last space seen
-    }
-    else if (p[i] == '\n') // handle newlines
-    {
-      p[i] = 0; // set end of string to curent newline
-      TTF_SizeText(f2->f, &p[start], &w, &h);
-      p[i] = '\n'; // set back to newline
-      if (w > MM_SCREEN_WIDTH) // if string is to long
-      {
-        // Special check for cases where > SW consecutive characters appear
-        if (lastSpace<start) lastSpace = i;
-        p[lastSpace] = 0;  // find previous space before newline.  
-        txtImg = TTF_RenderText_Blended(f2->f, &p[start], color);
-        start = lastSpace+1; // set new string start position
-        // Set string index back 1 so newline will be processed again
-        if (lastSpace != i) i--; 
-      }
-      else // string was not to long
-      {
-        p[i] = 0; // set null temrinator to where newline is and print string
-        txtImg = TTF_RenderText_Blended(f2->f, &p[start], color);
-        start = i+1; // set new start position
-      }
-    }
-    else if (p[i] == 0)  // if end of string is reached...
-    {
-      TTF_SizeText(f2->f, &p[start], &w, &h);
-      // if to long, print from start to previous space
-      if (w > MM_SCREEN_WIDTH)  
-      {
-        // Special check for cases where > SW consecutive characters appear
-        if (lastSpace<start) lastSpace = i;
-        p[lastSpace] = 0;
-        txtImg = TTF_RenderText_Blended(f2->f, &p[start], color);
-        start = i = lastSpace+1;
-      }
-      else  // if not to long, just print what is left
-        txtImg = TTF_RenderText_Blended(f2->f, &p[start], color);
-    }
-    
-    // draw only when there is something to draw
-    if (txtImg && txtImg->w > 0)
-    {
-      dst.x = (MM_SCREEN_WIDTH/2) - (txtImg->w/2);
-      SDL_BlitSurface(txtImg, 0, _scr, &dst);
-      SDL_FreeSurface(txtImg);
-      txtImg = 0;
-      dst.y += h; // move down to next line
-    }
-  }
+  // wrap the quote to the screen width, centering each line
+  count = TXT_WrapText(quote, _quotes[rand], MM_SCREEN_WIDTH, lines, 
+                       MAX_QUOTE_LINES);
+  if (count > MAX_QUOTE_LINES)
+    count = MAX_QUOTE_LINES;
+  TXT_DrawLines(quote, _quotes[rand], lines, count, _scr, MM_SCREEN_WIDTH/2,
+                dst.y, 1);
   
   SDL_Flip(_scr);
+  
+  // copy the load screen into the back buffer too, so the progress bar can
+  // be drawn & flipped by MENU_UpdateLoadScreen without redrawing the text
+  memcpy(MM_GetScreenBuffer(MM_BACK_BUFFER), MM_GetScreenBuffer(MM_DRAW_BUFFER),
+         _scr->pitch * MM_SCREEN_HEIGHT);
+  MENU_UpdateLoadScreen(0, 0);
+  
+  TXT_ReleaseAtlas(quote);
+  ZIP_ReleaseText(titleImg);
+  ZIP_ReleaseText(subTitleImg);
+  ZIP_ReleaseText(loadImg);
   ZIP_CloseFont(f1);
-  ZIP_CloseFont(f2);
   ZIP_CloseFont(f3);
-  SDL_FreeSurface(titleImg);
-  SDL_FreeSurface(subTitleImg);
-  SDL_FreeSurface(loadImg);
+}
+
+//------------------------------------------------------------------------------
+// Name:     MENU_UpdateLoadScreen
+// Summary:  Draws the progress bar on the load screen and flips the screen.
+//           Passed to the Resource Manager as its progress function while 
+//           level 1 is loading.  A light band sweeps along the bar so the
+//           screen keeps moving while a big file loads.
+// Inputs:   1. loaded - number of resources loaded so far
+//           2. total - total number of resources to load
+// Outputs:  None
+// Returns:  None
+// Cautions: MENU_DrawLoadScreen must be called first.  The Resource Manager
+//           also calls it every so often with the same counts, to move the
+//           band along.
+//------------------------------------------------------------------------------
+void MENU_UpdateLoadScreen(int loaded, int total)
+{
+  SDL_Rect bar   = { LOAD_BAR_X, LOAD_BAR_Y, LOAD_BAR_WIDTH, LOAD_BAR_HEIGHT };
+  SDL_Rect pulse = { LOAD_BAR_X, LOAD_BAR_Y, LOAD_PULSE_WIDTH, LOAD_BAR_HEIGHT };
+  
+  SDL_FillRect(_scr, &bar, SDL_MapRGB(_scr->format, 0x40, 0x40, 0x40));
+  pulse.x += (SDL_GetTicks() / LOAD_PULSE_MS) % LOAD_BAR_WIDTH;
+  if (pulse.x + pulse.w > LOAD_BAR_X + LOAD_BAR_WIDTH)
+    pulse.w = LOAD_BAR_X + LOAD_BAR_WIDTH - pulse.x;
+  SDL_FillRect(_scr, &pulse, SDL_MapRGB(_scr->format, 0x90, 0x90, 0x90));
+  if (total > 0)
+  {
+    bar.w = (LOAD_BAR_WIDTH * loaded) / total;
+    SDL_FillRect(_scr, &bar, SDL_MapRGB(_scr->format, 0xFF, 0xFF, 0xFF));
+  }
+  SDL_Flip(_scr);
 }
 
 //------------------------------------------------------------------------------
@@ -1432,7 +1410,7 @@ unsigned int MENU_DrawHiddenLevel1(SDL_Event *event)
             _scr->format->Gmask, _scr->format->Bmask, _scr->format->Amask);
   SDL_FillRect(infoImg, 0, 0);
   SDL_SetAlpha(infoImg, SDL_SRCALPHA, 225);
-  txtImg = TTF_RenderText_Blended(f1->f, "Left Trigger=Prev    Start=Main Menu    Select=Toggle Info    Right Trigger=Next", fgColor);
+  txtImg = ZIP_RenderText(f1, "Left Trigger=Prev    Start=Main Menu    Select=Toggle Info    Right Trigger=Next", fgColor);
 
   while (loop)
   {
@@ -1440,8 +1418,7 @@ unsigned int MENU_DrawHiddenLevel1(SDL_Event *event)
     {
       if (img)
         SDL_FreeSurface(img);
-      if (nameImg)
-        SDL_FreeSurface(nameImg); 
+      ZIP_ReleaseText(nameImg); 
         
       if (index < 0)
         index = NUM_CONCEPTS-1;
@@ -1449,7 +1426,7 @@ unsigned int MENU_DrawHiddenLevel1(SDL_Event *event)
         index = 0;
       newImage     = 0;
       img          = ZIP_LoadImage(info[index][0]);  
-      nameImg      = TTF_RenderText_Blended(f1->f, info[index][1], fgColor);
+      nameImg      = ZIP_RenderText(f1, info[index][1], fgColor);
       txtRecDst.x  = (MM_SCREEN_WIDTH - txtImg->w) / 2;
       nameRecDst.x = (MM_SCREEN_WIDTH - nameImg->w) / 2;
       nameRecDst.y = txtImg->h-5;
@@ -1499,10 +1476,10 @@ unsigned int MENU_DrawHiddenLevel1(SDL_Event *event)
   }
 
   ZIP_CloseZipFile();
-  ZIP_CloseFont(f1);
   SDL_FreeSurface(img);
-  SDL_FreeSurface(txtImg);
-  SDL_FreeSurface(nameImg); 
+  ZIP_ReleaseText(txtImg);
+  ZIP_ReleaseText(nameImg); 
+  ZIP_CloseFont(f1);
   SDL_FreeSurface(infoImg); 
   
   return(MM_STATE_LEVEL_COMPLETE);
@@ -1613,7 +1590,7 @@ void MENU_DrawIntro(SDL_Event *event)
 
   // Load images from ZIP file
   ZIP_OpenZipFile(ZIP_MAIN);
-  f1 = ZIP_LoadFont(ZIP_FONT1, 12);
+  f1 = ZIP_LoadFontStyle(ZIP_FONT1, 12, TTF_STYLE_BOLD);
   
   tmp   = ZIP_LoadImage("intro_bg.bmp");
   bgImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE);
@@ -1630,9 +1607,6 @@ void MENU_DrawIntro(SDL_Event *event)
   heroImg      = ZIP_LoadImage("intro_hero_arms.png");
   ZIP_CloseZipFile();
   
-  // Make font style BOLD
-  TTF_SetFontStyle(f1->f, TTF_STYLE_BOLD);
-  
   // Semi-Transparent image to draw dialog over
   transImg = SDL_CreateRGBSurface(SDL_SWSURFACE, MM_SCREEN_WIDTH, 56, 
               _scr->format->BitsPerPixel, _scr->format->Rmask, 
@@ -1889,11 +1863,9 @@ unsigned int MENU_DrawCredits(SDL_Event *event)
   // This is done here dynamically at run time to keep user from easily
   // discovering all the secret codes
   ZIP_OpenZipFile(ZIP_MAIN);
-  f1    = ZIP_LoadFont(ZIP_FONT1, 30);
-  f2    = ZIP_LoadFont(ZIP_FONT1, 15);
+  f1    = ZIP_LoadFontStyle(ZIP_FONT1, 30, TTF_STYLE_BOLD);
+  f2    = ZIP_LoadFontStyle(ZIP_FONT1, 15, TTF_STYLE_BOLD);
   ZIP_CloseZipFile();
-  TTF_SetFontStyle(f1->f, TTF_STYLE_BOLD);
-  TTF_SetFontStyle(f2->f, TTF_STYLE_BOLD);
   
   // Select secret code and create SDL surfaces used to diaply it to user
   code = MM_RandomNumberGen(0, NUM_CODES-1);
@@ -1994,3 +1966,157 @@ unsigned int MENU_DrawCredits(SDL_Event *event)
   return(MM_STATE_LEVEL_COMPLETE);
 }      
 
+#ifdef MM_PROFILE
+// Lines each quote breaks into at the screen width with TXT_ProfileWrap's
+// fixed pitch atlas, and the start & length of each line, quote after quote
+static const unsigned char _quoteLines[NUM_QUOTES] =
+{
+  3, 2, 2, 2, 2, 3, 3, 2, 3, 3, 3, 7, 4, 2, 4, 2, 2, 4,
+  5, 2, 6, 2, 3, 2, 2, 2, 5, 2, 4, 6, 5, 2, 2, 4, 2
+};
+static const TXT_Line _quoteBreaks[] =
+{
+  {  0, 68}, { 69, 15}, { 85,  8},                             // 0
+  {  0, 41}, { 42,  8},                                        // 1
+  {  0, 43}, { 44, 21},                                        // 2
+  {  0, 38}, { 39, 14},                                        // 3
+  {  0, 30}, { 31, 28},                                        // 4
+  {  0, 65}, { 66,  4}, { 71, 31},                             // 5
+  {  0, 63}, { 64, 46}, {111, 24},                             // 6
+  {  0, 44}, { 45, 32},                                        // 7
+  {  0, 62}, { 63,  9}, { 73, 38},                             // 8
+  {  0, 60}, { 61, 11}, { 73, 42},                             // 9
+  {  0, 64}, { 65, 33}, { 99, 42},                             // 10
+  {  0, 63}, { 64, 67}, {132, 66}, {199, 65}, {265, 62},       // 11
+  {328, 68}, {397, 42},
+  {  0, 66}, { 67, 66}, {134, 37}, {172, 43},                  // 12
+  {  0, 17}, { 18, 41},                                        // 13
+  {  0, 64}, { 65, 67}, {133, 24}, {158, 34},                  // 14
+  {  0, 56}, { 57, 35},                                        // 15
+  {  0, 26}, { 27, 27},                                        // 16
+  {  0, 61}, { 62, 68}, {131, 48}, {180, 30},                  // 17
+  {  0, 30}, { 31,  8}, { 40, 67}, {108,  6}, {115, 35},       // 18
+  {  0, 61}, { 62, 33},                                        // 19
+  {  0, 65}, { 66, 68}, {135, 67}, {203, 67}, {271,  5},       // 20
+  {277, 42},
+  {  0, 43}, { 44, 30},                                        // 21
+  {  0, 58}, { 59, 11}, { 71, 24},                             // 22
+  {  0, 11}, { 12, 17},                                        // 23
+  {  0, 20}, { 21, 26},                                        // 24
+  {  0, 44}, { 45, 25},                                        // 25
+  {  0, 66}, { 67, 63}, {131, 63}, {195, 52}, {248, 31},       // 26
+  {  0, 53}, { 54, 37},                                        // 27
+  {  0, 62}, { 63, 67}, {131, 11}, {143, 33},                  // 28
+  {  0, 65}, { 66, 62}, {129, 68}, {198, 65}, {264,  9},       // 29
+  {274, 37},
+  {  0, 67}, { 68, 67}, {136, 68}, {205, 21}, {227, 31},       // 30
+  {  0, 41}, { 42, 51},                                        // 31
+  {  0, 63}, { 64, 18},                                        // 32
+  {  0, 67}, { 68, 67}, {136,  7}, {144, 16},                  // 33
+  {  0, 48}, { 49, 41}                                         // 34
+};
+
+// The same with TXT_ProfileWrap's proportional, kerned atlas.  Worked out 
+// with the wrap loop the menus used before TXT_WrapText, measuring with
+// SDL_ttf's sizing over the same made up metrics.
+static const unsigned char _quoteKernLines[NUM_QUOTES] =
+{
+  3, 2, 2, 2, 2, 2, 3, 2, 2, 2, 3, 7, 4, 2, 4, 2, 2, 4,
+  5, 2, 5, 2, 2, 2, 2, 2, 5, 2, 3, 5, 5, 2, 2, 3, 2
+};
+static const TXT_Line _quoteKernBreaks[] =
+{
+  {  0, 78}, { 79,  5}, { 85,  8},                             // 0
+  {  0, 41}, { 42,  8},                                        // 1
+  {  0, 43}, { 44, 21},                                        // 2
+  {  0, 38}, { 39, 14},                                        // 3
+  {  0, 30}, { 31, 28},                                        // 4
+  {  0, 70}, { 71, 31},                                        // 5
+  {  0, 73}, { 74, 36}, {111, 24},                             // 6
+  {  0, 44}, { 45, 32},                                        // 7
+  {  0, 72}, { 73, 38},                                        // 8
+  {  0, 72}, { 73, 42},                                        // 9
+  {  0, 73}, { 74, 24}, { 99, 42},                             // 10
+  {  0, 75}, { 76, 76}, {153, 75}, {229, 76}, {306, 75},       // 11
+  {382, 14}, {397, 42},
+  {  0, 75}, { 76, 69}, {146, 25}, {172, 43},                  // 12
+  {  0, 17}, { 18, 41},                                        // 13
+  {  0, 77}, { 78, 70}, {149,  8}, {158, 34},                  // 14
+  {  0, 56}, { 57, 35},                                        // 15
+  {  0, 26}, { 27, 27},                                        // 16
+  {  0, 79}, { 80, 79}, {160, 19}, {180, 30},                  // 17
+  {  0, 30}, { 31,  8}, { 40, 67}, {108,  6}, {115, 35},       // 18
+  {  0, 61}, { 62, 33},                                        // 19
+  {  0, 71}, { 72, 74}, {147, 69}, {217, 59}, {277, 42},       // 20
+  {  0, 43}, { 44, 30},                                        // 21
+  {  0, 70}, { 71, 24},                                        // 22
+  {  0, 11}, { 12, 17},                                        // 23
+  {  0, 20}, { 21, 26},                                        // 24
+  {  0, 44}, { 45, 25},                                        // 25
+  {  0, 74}, { 75, 74}, {150, 71}, {222, 25}, {248, 31},       // 26
+  {  0, 53}, { 54, 37},                                        // 27
+  {  0, 73}, { 74, 68}, {143, 33},                             // 28
+  {  0, 70}, { 71, 74}, {146, 75}, {222, 51}, {274, 37},       // 29
+  {  0, 76}, { 77, 68}, {146, 75}, {222,  4}, {227, 31},       // 30
+  {  0, 41}, { 42, 51},                                        // 31
+  {  0, 63}, { 64, 18},                                        // 32
+  {  0, 74}, { 75, 68}, {144, 16},                             // 33
+  {  0, 48}, { 49, 41}                                         // 34
+};
+
+//------------------------------------------------------------------------------
+// Name:     MENU_ProfileWrap
+// Summary:  Check & benchmark, has TXT_ProfileWrap break every load screen
+//           quote, and check they break where they are expected to
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Must not be called while a zip file is open
+//------------------------------------------------------------------------------
+void MENU_ProfileWrap()
+{
+  SDL_Color color = {255,255,255};
+  TXT_Atlas *quote;
+
+  ZIP_OpenZipFile(ZIP_MAIN);
+  quote = TXT_GetAtlas(ZIP_FONT2, 12, TTF_STYLE_NORMAL, color);
+  ZIP_CloseZipFile();
+  TXT_ProfileWrap(quote, _quotes, NUM_QUOTES, MM_SCREEN_WIDTH, _quoteLines,
+                  _quoteBreaks, _quoteKernLines, _quoteKernBreaks);
+  TXT_ReleaseAtlas(quote);
+}
+
+//------------------------------------------------------------------------------
+// Name:     MENU_ProfileText
+// Summary:  Check, enters the load screen twice and checks the second entry
+//           finds its strings in the text cache instead of rendering them
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Draws the load screen, call before anything else is drawn.
+//           Must not be called while a zip file is open
+//------------------------------------------------------------------------------
+void MENU_ProfileText()
+{
+  ZIP_Stats first;
+  ZIP_Stats second;
+  ZIP_Stats end;
+  
+  ZIP_GetStats(&first);
+  MENU_DrawLoadScreen();
+  ZIP_GetStats(&second);
+  MENU_DrawLoadScreen();
+  ZIP_GetStats(&end);
+  
+  if (end.textHits == second.textHits || end.textMisses != second.textMisses)
+  {
+    EH_Error(EH_SEVERE, "MENU_ProfileText: load screen strings not cached "
+             "(%u hits, %u misses entering again).", 
+             end.textHits - second.textHits, end.textMisses - second.textMisses);
+    return;
+  }
+  EH_Error(EH_DEBUG, "load screen text: %u misses first entry, %u hits "
+           "entering again\n", second.textMisses - first.textMisses, 
+           end.textHits - second.textHits);
+}
+#endif
@@ -13,8 +13,14 @@ unsigned int MENU_DrawEnterCode(SDL_Event *event, unsigned int gameLevel);
 unsigned int MENU_DrawMain(SDL_Event *event, unsigned int gameLevel, Mix_Chunk *ding);
 unsigned int MENU_DrawOptions(SDL_Event *event, SDL_Surface *startScreenImg, SDL_Surface *cursorImg, unsigned int gameLevel, Mix_Chunk *select, Mix_Chunk *ding);
 void         MENU_DrawLoadScreen();
+void         MENU_UpdateLoadScreen(int loaded, int total);
 unsigned int MENU_DrawCredits(SDL_Event *event);
 unsigned int MENU_DrawFinalLevel(SDL_Event *event);
 unsigned int MENU_DrawHiddenLevel1(SDL_Event *event);
 
+#ifdef MM_PROFILE
+void         MENU_ProfileWrap();
+void         MENU_ProfileText();
+#endif
+
 #endif
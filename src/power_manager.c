@@ -13,6 +13,7 @@
 #include "dl_manager.h"
 #include "bg_manager.h"
 #include "map_manager.h"
+#include "sce_graphics.h"
 
 
 // In the realm of the mega-mart, we define infinity as 10
@@ -99,9 +100,9 @@ int PM_InitLevel(unsigned int level)
     for (x=0; x < 10; x++)  // reate image strings 0 - 9 for extra lives
     {
       sprintf(buf, "x %i", x);
-      _imgNum[x] = TTF_RenderText_Blended(f1->f, buf, fgColor);
+      _imgNum[x] = ZIP_RenderText(f1, buf, fgColor);
     }
-    ZIP_CloseFont(f1);
+    ZIP_CloseFont(f1);  // the strings stay valid, they are kept for good
 
     // Load special image used to represent infinity lives
     _imgNum[INFINITY] = ZIP_LoadImage("infinity.png");
@@ -188,9 +189,9 @@ int PM_DrawMeeter()
     _srcRecPwr.y = _curPower * _srcRecPwr.h;
   }
   
-  status += SDL_BlitSurface(_imgExtraLives, 0, _scr, &_dstRecEL);
-  status += SDL_BlitSurface(_imgNum[_numLives], 0, _scr, &_dstRecELT);
-  status += SDL_BlitSurface(_imgPowerMeter, &_srcRecPwr, _scr, &_dstRecPwr);
+  status += SCE_Blit(_imgExtraLives, 0, &_dstRecEL);
+  status += SCE_Blit(_imgNum[_numLives], 0, &_dstRecELT);
+  status += SCE_Blit(_imgPowerMeter, &_srcRecPwr, &_dstRecPwr);
     
   return(status);
 }
@@ -7,39 +7,283 @@
 //  levels in the game (Level 1, Final Level, and the Credits).  This class
 //  will automatically allocate and free the memory used by each level's 
 //  resources so the user does not have to worry about doing so.  
+//
+//  The bytes held by each resource are tracked.  Resources a level does not
+//  use are kept (so going back to a level does not reload them) until the
+//  resources held pass a budget (see RM_SetBudget), then the least recently
+//  used are freed first.
+//
+//  Small sprites flagged with ATLAS_FORMAT are packed into shared atlas 
+//  pages once they are loaded.  The surface RM_GetImage returns for 1 of
+//  them is a view of its part of the page (its pixels point into the page),
+//  so it is drawn like any other surface.
 //  
 //  Note: Most (but not all) of the functions in the Menu Manager class 
 //  DO NOT use this class.  As such, those functions are responsible for 
 //  allocating and freeing the memory for any resource they use.
 //-----------------------------------------------------------------------------
 
-#include "resource_manager.h"
+#include <ctype.h>
+#include "SDL/SDL_thread.h"
+#include "SDL/SDL_mutex.h"
+#include "resource_manager.h"
 #include "zip_manager.h"
+#include "text_manager.h"
 #include "sce_graphics.h"
+#if defined(__unix__) && !defined(__psp__)
+#include <unistd.h>
+#endif
 
+// An image or sound the game loads for 1 or more levels, the tables below
+// are indexed by the id of the resource (see resource_manager.h)
 typedef struct LoadResStruct
 {
-  char           name[30]; 
-  unsigned short id;
-  unsigned int   level;
-  unsigned short format;
-  unsigned int   flags;
+  const char     *name;
+  unsigned int   level;     // Ored list of levels the resource is used by
+  unsigned short format;    // image format (SDL NATIVE or SCREEN format)
 } LoadResStruct;
 
+#define ATLAS_FORMAT    4     // may be packed into an atlas page
 #define TRANSP_FORMAT   2
 #define SCREEN_FORMAT   1
 #define NATIVE_FORMAT   0
 
+#define MAX_LOAD_THREADS  8
+#define MAX_JOBS          (NUM_IMAGES + NUM_SOUNDS)
+
+#define NUM_LEVEL_BITS    8     // MM_LEVEL1 ... MM_LEVEL_CREDITS
+#define IMAGE_WORDS       ((NUM_IMAGES + 31) / 32)
+#define SOUND_WORDS       ((NUM_SOUNDS + 31) / 32)
+#define INDEX_SIZE        1024  // slots in a name index, power of 2
+#define MAX_INDEX_SEEDS   4096
+#define RAM_BUDGET        (8*1024*1024)  // bytes of level resources kept
+#define REPORT_CONSUMERS  5     // resources listed when memory runs out
+#define MAX_ATLAS_PAGES   8
+#define ATLAS_WIDTH       512   // largest texture the GU can draw from
+#define ATLAS_HEIGHT      512
+#define JOB_ERROR_LENGTH  96
+#define PROGRESS_INTERVAL 50    // ms between load screen updates
+
+// 1 bit per image & sound id
+typedef struct ResMask
+{
+  unsigned int images[IMAGE_WORDS];
+  unsigned int sounds[SOUND_WORDS];
+} ResMask;
+
+// Perfect hash of the names in a resource table, every name has a slot of 
+// its own so a lookup is 1 hash & 1 compare
+typedef struct ResIndex
+{
+  const LoadResStruct *table;
+  int                 count;             // entries in table
+  unsigned int        seed;              // seed that gave no collisions
+  unsigned char       slots[INDEX_SIZE]; // id + 1, 0 if slot is empty
+} ResIndex;
+
+// A page of sprites packed together, freed when none of them are loaded
+typedef struct AtlasPage
+{
+  SDL_Surface *img;
+  int         refs;     // images still using the page
+} AtlasPage;
+
+// A resource waiting to be (or that has been) loaded by a load thread
+typedef struct LoadJob
+{
+  const LoadResStruct *res;
+  int                 id;
+  int                 isSound;
+  void                *data;    // SDL_Surface or Mix_Chunk once loaded
+  char                error[JOB_ERROR_LENGTH]; // why a load thread could not 
+                                               // load it, reported by the
+                                               // main thread
+} LoadJob;
+
+// Trying to keep each line under 80 characters is a lost cause in this file.
+// Ids without an entry and the permanant images have no level, so they are 
+// never loaded or freed by RM_InitLevel.
+static const LoadResStruct _imageTable[NUM_IMAGES] =
+{
+  [RM_IMG_BONUS_LIFE_SPRITE]  = { "bonus_life.png",  MM_LEVEL1, NATIVE_FORMAT|ATLAS_FORMAT },
+  [RM_IMG_POWER_UP_SPRITE]    = { "power_up.bmp",    MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [RM_IMG_TWINKLE_SPRITE]     = { "twinkle.bmp",     MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [BASKETBALL_SPRITE]         = { "basketball.bmp",  MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [BASEBALL_SPRITE]           = { "baseball.bmp",    MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [SOCCERBALL_SPRITE]         = { "soccerball.bmp",  MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [GRILL_SPRITE]              = { "grill.png",       MM_LEVEL1, NATIVE_FORMAT },
+  [EMPLOYEE_SPRITE]           = { "employee.bmp",    MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+  [TENT_GUY_SPRITE]           = { "tentguy.png",     MM_LEVEL1, NATIVE_FORMAT },
+  [PUNCHING_BAG_SPRITE]       = { "punchingbag.png", MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_BOMB_SPRITE]        = { "bomb.bmp",        MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [RM_IMG_ARCHER_SPRITE]      = { "archer.bmp",      MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+  [RM_IMG_ARROW_SPRITE]       = { "arrow.bmp",       MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [RM_IMG_BICYCLE1_SPRITE]    = { "bicycle1.png",    MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_BICYCLE2_SPRITE]    = { "bicycle2.png",    MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HOCKEY_EAST_SPRITE] = { "hockey_east.bmp", MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+  [RM_IMG_HOCKEY_WEST_SPRITE] = { "hockey_west.bmp", MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+  [RM_IMG_SIGN_SPRITE]        = { "sign.png",        MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_WEIGHTS_SPRITE]     = { "weights.bmp",     MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+
+  [RM_BOWLING_SHELF_SPRITE]       = { "bowling_shelf.bmp",      MM_LEVEL1, SCREEN_FORMAT },
+  [RM_RED_BOWLING_BALL_SPRITE]    = { "bowlingball_red.png",    MM_LEVEL1, NATIVE_FORMAT|ATLAS_FORMAT },
+  [RM_GREEN_BOWLING_BALL_SPRITE]  = { "bowlingball_green.png",  MM_LEVEL1, NATIVE_FORMAT|ATLAS_FORMAT },
+  [RM_YELLOW_BOWLING_BALL_SPRITE] = { "bowlingball_yellow.png", MM_LEVEL1, NATIVE_FORMAT|ATLAS_FORMAT },
+  [RM_BLUE_BOWLING_BALL_SPRITE]   = { "bowlingball_blue.png",   MM_LEVEL1, NATIVE_FORMAT|ATLAS_FORMAT },
+
+  [TENT_GREEN]                = { "tent_green.bmp",  MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [TENT_BLUE]                 = { "tent_blue.bmp",   MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [TENT_RED]                  = { "tent_red.bmp",    MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [TENT_GREY]                 = { "tent_grey.bmp",   MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [TENT_PURPLE]               = { "tent_purple.bmp", MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [TENT_ORANGE]               = { "tent_orange.bmp", MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+
+  [L1S1_TENT3]                = { "tent3.bmp",       MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+  [ARNOLD_SPRITE]             = { "arnold.bmp",      MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+
+  [GEN_RANDOM_SHELF]          = { "shelfa.bmp",      MM_LEVEL1, SCREEN_FORMAT },
+  [GEN_SHELF_B_SPRITE]        = { "shelfb.bmp",      MM_LEVEL1, SCREEN_FORMAT },
+  [GEN_SHELF_C_SPRITE]        = { "shelfc.bmp",      MM_LEVEL1, SCREEN_FORMAT },
+  [GEN_SHELF_D_SPRITE]        = { "shelfd.bmp",      MM_LEVEL1, SCREEN_FORMAT },
+  [FALLING_SHELF_SPRITE]      = { "shelf_fall.bmp",  MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+
+  [RM_IMG_HERO_POWER_METER]   = { "power_meter.png",  MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT },
+  [RM_IMG_HERO_EXTRA_LIFE]    = { "extra_life.png",   MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO]               = { "hero.png",         MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO_WEAPON]        = { "hero_weapon.png",  MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO_HURT]          = { "hero_hit.png",     MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO_DEATH]         = { "hero_death.png",   MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO_DUCK]          = { "hero_duck.png",    MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO_JUMP]          = { "hero_jump.png",    MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_HERO_VICTORY]       = { "hero_victory.png", MM_LEVEL1, NATIVE_FORMAT },
+
+  [RM_IMG_PROGRESS_ICON]      = { "prog_icon.bmp",        MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT|ATLAS_FORMAT },
+  [RM_IMG_PROGRESS_BAR]       = { "prog_meter.png",       MM_LEVEL1, NATIVE_FORMAT },
+  [RM_LEVEL1_COMPLETE_TXT]    = { "l1_end_text.png",      MM_LEVEL1, NATIVE_FORMAT },
+  [RM_GAME_PAUSED_TXT]        = { "game_paused.png",      MM_LEVEL1, NATIVE_FORMAT },
+  [RM_GAME_OVER_TXT]          = { "game_over.png",        MM_LEVEL1|MM_LEVEL_FINAL, NATIVE_FORMAT },
+  [RM_SCREENSHOT_1_TXT]       = { "savingscreenshot.png", MM_LEVEL1|MM_LEVEL_FINAL, NATIVE_FORMAT },
+  [RM_SCREENSHOT_2_TXT]       = { "screenshotsaved.png",  MM_LEVEL1|MM_LEVEL_FINAL, SCREEN_FORMAT|TRANSP_FORMAT },
+  [RM_RESUME_QUIT_TXT]        = { "resume_quit.png",      MM_LEVEL1, NATIVE_FORMAT },
+  [RM_CURSOR]                 = { "cursor.png",           MM_LEVEL1, NATIVE_FORMAT },
+  [RM_IMG_CREDITS]            = { "credits.bmp",          MM_LEVEL_CREDITS, NATIVE_FORMAT },
+
+  // Final Level Images
+  [RM_IMG_FL_IMAGE]           = { "final_image.bmp",      MM_LEVEL_FINAL, SCREEN_FORMAT },
+  [RM_IMG_FL_SCROLL]          = { "final_level.bmp",      MM_LEVEL_FINAL, SCREEN_FORMAT },
+  [RM_IMG_FL_TEXT]            = { "final_level_txt.bmp",  MM_LEVEL_FINAL, SCREEN_FORMAT },
+  [RM_IMG_FL_CURSOR]          = { "cursor_small.png",     MM_LEVEL_FINAL, NATIVE_FORMAT },
+
+  // Permanant images, see LoadPermanantImages
+  [RM_IMG_BG1]                = { "bg1.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_BG2]                = { "bg2.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF1]                = { "rf1.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF2]                = { "rf2.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF3]                = { "rf3.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF4]                = { "rf4.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF5]                = { "rf5.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF6]                = { "rf6.bmp",              0, SCREEN_FORMAT },
+  [RM_IMG_RF7]                = { "rf7.bmp",              0, SCREEN_FORMAT },
+};
+
+static const LoadResStruct _soundTable[NUM_SOUNDS] =
+{
+  [RM_SFX_HERO_HIT]          = { "hero_hit.wav",          MM_LEVEL1 },
+  [RM_SFX_HERO_JUMP]         = { "hero_jump.wav",         MM_LEVEL1 },
+  [RM_SFX_BALL_HIT]          = { "hit_ball.wav",          MM_LEVEL1 },
+  [RM_SFX_GRILL_FALLING]     = { "grill_falling.wav",     MM_LEVEL1 },
+  [RM_SFX_BOWLING_BALL_FALL] = { "bowling_ball_fall.wav", MM_LEVEL1 },
+  [RM_SFX_LEVEL1_MUSIC]      = { "level1.wav",            MM_LEVEL1 },
+  [RM_SFX_POWER_UP]          = { "power_up.wav",          MM_LEVEL1 },
+  [RM_SFX_SHELF_FALL]        = { "shelf_fall.wav",        MM_LEVEL1 },
+  [RM_SFX_TENT_HIT]          = { "tent_hit.wav",          MM_LEVEL1 },
+  [RM_SFX_SCREENSHOT]        = { "screenshot.wav",        MM_LEVEL1 },
+  [RM_SFX_EMPLOYEE_HIT]      = { "employee_hit.wav",      MM_LEVEL1 },
+  [RM_SFX_EXPLOSION]         = { "bomb.wav",              MM_LEVEL1 },
+  [RM_SFX_ARROW]             = { "arrow.wav",             MM_LEVEL1 },
+  [RM_SFX_BICYCLE]           = { "bicycle.wav",           MM_LEVEL1 },
+  [RM_SFX_BICYCLE_BELL]      = { "bicycle_bell.wav",      MM_LEVEL1 },
+  [RM_SFX_GAME_OVER]         = { "game_over.wav",         MM_LEVEL1|MM_LEVEL_FINAL },
+
+  [RM_SFX_MENU_SELECT]       = { "menu_select.wav",       MM_LEVEL_FINAL },
+  [RM_SFX_FINAL_MUSIC]       = { "final_level.wav",       MM_LEVEL_CREDITS|MM_LEVEL_FINAL },
+  [RM_SFX_FINAL_WIN]         = { "final_winner.wav",      MM_LEVEL_FINAL },
+  [RM_SFX_CREDITS_MUSIC]     = { "creditsm.wav",          MM_LEVEL_CREDITS },
+};
+
 static Mix_Chunk    *_sounds[NUM_SOUNDS];
 static SDL_Surface  *_images[NUM_IMAGES];
 static int          _permImagesLoaded;
 static int          _lastLevelLoaded;
 
-// Trying to keep each line under 80 characters is a lost cause in this file
-static void        AddSound(LoadResStruct *info, const char *name, unsigned short id, unsigned int level);
-static void        AddImage(LoadResStruct *info, const char *name, unsigned short id, unsigned int level, unsigned short format, unsigned int flags);
-static SDL_Surface *LoadImage(LoadResStruct *ptr);
-static void        LoadPermanantImages();
+// Resources used by each level (indexed by level bit), built by RM_Init, 
+// the table resources that are loaded right now and those the last level
+// loaded uses
+static ResMask      _levelMasks[NUM_LEVEL_BITS];
+static ResMask      _loaded;
+static ResMask      _need;
+
+// Memory accounting.  Sizes are kept after a resource is freed, so the next
+// load of it can be planned for.  _useTick counts calls to RM_InitLevel.
+static unsigned int _imageBytes[NUM_IMAGES];
+static unsigned int _soundBytes[NUM_SOUNDS];
+static unsigned int _imageUsed[NUM_IMAGES];
+static unsigned int _soundUsed[NUM_SOUNDS];
+static unsigned int _useTick;
+static ResMask      _vram;            // permanant images held in VRAM
+static unsigned int _ramBytes;        // bytes held by level resources
+static unsigned int _permBytes;       // RAM held by permanant images
+static unsigned int _vramBytes;       // VRAM held by permanant images
+static unsigned int _budget = RAM_BUDGET;
+static unsigned int _evictions;
+
+// Atlas pages, and the page each image was packed into (-1 for none)
+static AtlasPage    _pages[MAX_ATLAS_PAGES];
+static signed char  _imagePage[NUM_IMAGES];
+static ResIndex     _imageIndex;
+static ResIndex     _soundIndex;
+
+// Load thread data, _jobLock protects _nextJob, _finished & _numFinished
+static LoadJob      _jobs[MAX_JOBS];
+static int          _numJobs;
+static int          _nextJob;             // next job to be handed out
+static int          _finished[MAX_JOBS];  // jobs in order of completion
+static int          _numFinished;
+static SDL_mutex    *_jobLock;
+static SDL_sem      *_jobSem;             // posted each time a job finishes
+static int          _loadThreads;
+static RM_ProgressFunction _progress;
+
+static void        BuildLevelMasks();
+static void        GetLevelMask(unsigned int level, ResMask *mask);
+static void        BuildIndex(ResIndex *index, const LoadResStruct *table, int count);
+static int         FindIndex(const ResIndex *index, const char *name);
+static unsigned int IndexSlot(const char *name, unsigned int seed);
+static int         LowestBit(unsigned int bits);
+static SDL_Surface *LoadImage(const LoadResStruct *ptr, ZIP_Reader *reader);
+static void        LoadPermanantImages();
+static void        AddPermanant(int id, SDL_Surface *img, int vram);
+static unsigned int PlannedBytes(const ResMask *mask);
+static void        EvictUnused(const ResMask *keep, unsigned int budget);
+static void        FreeResource(int id, int isSound);
+static void        PackAtlas(const ResMask *mask);
+static int         PackPage(const int *ids, int count);
+static int         PackImage(int id, int page, const SDL_Rect *rect);
+static int         CanPack(int id);
+static int         SameFormat(SDL_PixelFormat *a, SDL_PixelFormat *b);
+static int         GetMissing(ResMask *missing);
+static void        ReportMemory(int severity);
+static void        AddJobs(const ResMask *mask);
+static void        RunJobs(int threads, int publish);
+static void        *LoadJobData(LoadJob *job, ZIP_Reader *reader);
+static void        PublishJob(LoadJob *job, int publish);
+static int         LoadThread(void *data);
+static int         DefaultLoadThreads();
+#ifdef MM_PROFILE
+static void        ProfileLevelLookups(const ResMask *mask);
+static void        ProfileLevelLoad(const ResMask *mask);
+static void        ProfileLoadThreads(const ResMask *mask);
+#endif
 
 //------------------------------------------------------------------------------
 // Name:     RM_Init
@@ -62,32 +306,48 @@ void RM_Init()
   // set flag to denoting perminant images have not been loaded
   _permImagesLoaded = 0;
   _lastLevelLoaded  = 0;  
+  
+  memset(&_need, 0, sizeof(_need));
+  memset(&_vram, 0, sizeof(_vram));
+  _useTick   = 0;
+  _ramBytes  = 0;
+  _permBytes = 0;
+  _vramBytes = 0;
+  _evictions = 0;
+  memset(_pages, 0, sizeof(_pages));
+  memset(_imagePage, -1, sizeof(_imagePage));
+  
+  BuildLevelMasks();
+  BuildIndex(&_imageIndex, _imageTable, NUM_IMAGES);
+  BuildIndex(&_soundIndex, _soundTable, NUM_SOUNDS);
+  
+  _jobLock     = SDL_CreateMutex();
+  _jobSem      = SDL_CreateSemaphore(0);
+  _loadThreads = DefaultLoadThreads();
+  _progress    = 0;
 } 
 
 //------------------------------------------------------------------------------
 // Name:     RM_InitLevel
 // Summary:  Allocates the resources needed for the specified level.  Frees 
-//           any allocated resources that are not needed by the current level.
+//           resources not needed by the level (least recently used first) 
+//           until the resources held fit in the budget.
 // Inputs:   Level to initialize
 // Outputs:  None
 // Returns:  Status value of 0 on success, non-zero on error
-// Cautions: None
+// Cautions: If a resource can not be loaded everything the level does not
+//           use is freed and it is tried again, if that fails too a warning
+//           lists the resources holding the most memory
 //------------------------------------------------------------------------------
 int RM_InitLevel(unsigned int level)
 {
   int status = 0;
-  int x      = 0;
-  int id     = 0;
-  LoadResStruct images[NUM_IMAGES];
-  LoadResStruct sounds[NUM_SOUNDS];
+  int w      = 0;
+  unsigned int bits;
+  unsigned int planned;
+  ResMask load;
   _lastLevelLoaded = level;
-  
-  
-  for (x=0; x < NUM_IMAGES; x++)
-    AddImage(&images[x], "0", 0, 0, 0, 0);
-    
-  for (x=0; x < NUM_SOUNDS; x++)
-    AddSound(&sounds[x], "0", 0, 0);
+  _useTick++;
 
   // Only load the permanant images 1 time
   if ( _permImagesLoaded == 0)
@@ -95,137 +355,70 @@ int RM_InitLevel(unsigned int level)
     LoadPermanantImages();
     _permImagesLoaded = 1;
   }
-
-  x=0;
-  AddImage(&images[x++], "bonus_life.png",  RM_IMG_BONUS_LIFE_SPRITE,  MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "power_up.bmp",    RM_IMG_POWER_UP_SPRITE,    MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "twinkle.bmp",     RM_IMG_TWINKLE_SPRITE,     MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "basketball.bmp",  BASKETBALL_SPRITE,         MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "baseball.bmp",    BASEBALL_SPRITE,           MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "soccerball.bmp",  SOCCERBALL_SPRITE,         MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "grill.png",       GRILL_SPRITE,              MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "employee.bmp",    EMPLOYEE_SPRITE,           MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "tentguy.png",     TENT_GUY_SPRITE,           MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "punchingbag.png", PUNCHING_BAG_SPRITE,       MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "bomb.bmp",        RM_IMG_BOMB_SPRITE,        MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "archer.bmp",      RM_IMG_ARCHER_SPRITE,      MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "arrow.bmp",       RM_IMG_ARROW_SPRITE,       MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "bicycle1.png",    RM_IMG_BICYCLE1_SPRITE,    MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "bicycle2.png",    RM_IMG_BICYCLE2_SPRITE,    MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hockey_east.bmp", RM_IMG_HOCKEY_EAST_SPRITE, MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "hockey_west.bmp", RM_IMG_HOCKEY_WEST_SPRITE, MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "sign.png",        RM_IMG_SIGN_SPRITE,        MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "weights.bmp",     RM_IMG_WEIGHTS_SPRITE,     MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  
-  AddImage(&images[x++], "bowling_shelf.bmp",     RM_BOWLING_SHELF_SPRITE,       MM_LEVEL1, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "bowlingball_red.png",   RM_RED_BOWLING_BALL_SPRITE,    MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "bowlingball_green.png", RM_GREEN_BOWLING_BALL_SPRITE,  MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "bowlingball_yellow.png",RM_YELLOW_BOWLING_BALL_SPRITE, MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "bowlingball_blue.png",  RM_BLUE_BOWLING_BALL_SPRITE,   MM_LEVEL1, NATIVE_FORMAT, 0);
-                                                                    
-  AddImage(&images[x++], "tent_green.bmp",    TENT_GREEN,           MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "tent_blue.bmp",     TENT_BLUE,            MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "tent_red.bmp",      TENT_RED,             MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "tent_grey.bmp",     TENT_GREY,            MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "tent_purple.bmp",   TENT_PURPLE,          MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "tent_orange.bmp",   TENT_ORANGE,          MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  
-  AddImage(&images[x++], "tent3.bmp",         L1S1_TENT3,           MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "arnold.bmp",        ARNOLD_SPRITE,        MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  
-  AddImage(&images[x++], "shelfa.bmp",        GEN_RANDOM_SHELF,     MM_LEVEL1, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "shelfb.bmp",        GEN_SHELF_B_SPRITE,   MM_LEVEL1, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "shelfc.bmp",        GEN_SHELF_C_SPRITE,   MM_LEVEL1, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "shelfd.bmp",        GEN_SHELF_D_SPRITE,   MM_LEVEL1, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "shelf_fall.bmp",    FALLING_SHELF_SPRITE, MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  
-  AddImage(&images[x++], "power_meter.png",   RM_IMG_HERO_POWER_METER,  MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "extra_life.png",    RM_IMG_HERO_EXTRA_LIFE,   MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero.png",          RM_IMG_HERO,              MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero_weapon.png",   RM_IMG_HERO_WEAPON,       MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero_hit.png",      RM_IMG_HERO_HURT,         MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero_death.png",    RM_IMG_HERO_DEATH,        MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero_duck.png",     RM_IMG_HERO_DUCK,         MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero_jump.png",     RM_IMG_HERO_JUMP,         MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "hero_victory.png",  RM_IMG_HERO_VICTORY,      MM_LEVEL1, NATIVE_FORMAT, 0);
-  
-  AddImage(&images[x++], "prog_icon.bmp",        RM_IMG_PROGRESS_ICON,     MM_LEVEL1, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "prog_meter.png",       RM_IMG_PROGRESS_BAR,      MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "l1_end_text.png",      RM_LEVEL1_COMPLETE_TXT,   MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "game_paused.png",      RM_GAME_PAUSED_TXT,       MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "game_over.png",        RM_GAME_OVER_TXT,         MM_LEVEL1|MM_LEVEL_FINAL, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "savingscreenshot.png", RM_SCREENSHOT_1_TXT,      MM_LEVEL1|MM_LEVEL_FINAL, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "screenshotsaved.png",  RM_SCREENSHOT_2_TXT,      MM_LEVEL1|MM_LEVEL_FINAL, SCREEN_FORMAT|TRANSP_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "resume_quit.png",      RM_RESUME_QUIT_TXT,       MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "cursor.png",           RM_CURSOR,                MM_LEVEL1, NATIVE_FORMAT, 0);
-  AddImage(&images[x++], "credits.bmp",          RM_IMG_CREDITS,           MM_LEVEL_CREDITS, NATIVE_FORMAT, 0);
   
+  // everything the level uses counts as used now
+  GetLevelMask(level, &_need);
+  for (w=0; w < IMAGE_WORDS; w++)
+    for (bits = _need.images[w]; bits; bits &= bits - 1)
+      _imageUsed[w * 32 + LowestBit(bits)] = _useTick;
+  for (w=0; w < SOUND_WORDS; w++)
+    for (bits = _need.sounds[w]; bits; bits &= bits - 1)
+      _soundUsed[w * 32 + LowestBit(bits)] = _useTick;
   
-  // Final Level Images
-  AddImage(&images[x++], "final_image.bmp",        RM_IMG_FL_IMAGE,          MM_LEVEL_FINAL, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "final_level.bmp",        RM_IMG_FL_SCROLL,         MM_LEVEL_FINAL, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "final_level_txt.bmp",    RM_IMG_FL_TEXT,           MM_LEVEL_FINAL, SCREEN_FORMAT, SDL_SWSURFACE);
-  AddImage(&images[x++], "cursor_small.png",       RM_IMG_FL_CURSOR,         MM_LEVEL_FINAL, NATIVE_FORMAT, 0);
-  
-  x=0;
-  AddSound(&sounds[x++], "hero_hit.wav",          RM_SFX_HERO_HIT,          MM_LEVEL1);
-  AddSound(&sounds[x++], "hero_jump.wav",         RM_SFX_HERO_JUMP,         MM_LEVEL1);
-  AddSound(&sounds[x++], "hit_ball.wav",          RM_SFX_BALL_HIT,          MM_LEVEL1);
-  AddSound(&sounds[x++], "grill_falling.wav",     RM_SFX_GRILL_FALLING,     MM_LEVEL1);
-  AddSound(&sounds[x++], "bowling_ball_fall.wav", RM_SFX_BOWLING_BALL_FALL, MM_LEVEL1);
-  AddSound(&sounds[x++], "level1.wav",            RM_SFX_LEVEL1_MUSIC,      MM_LEVEL1);
-  AddSound(&sounds[x++], "power_up.wav",          RM_SFX_POWER_UP,          MM_LEVEL1);
-  AddSound(&sounds[x++], "shelf_fall.wav",        RM_SFX_SHELF_FALL,        MM_LEVEL1);
-  AddSound(&sounds[x++], "tent_hit.wav",          RM_SFX_TENT_HIT,          MM_LEVEL1);
-  AddSound(&sounds[x++], "screenshot.wav",        RM_SFX_SCREENSHOT,        MM_LEVEL1);
-  AddSound(&sounds[x++], "employee_hit.wav",      RM_SFX_EMPLOYEE_HIT,      MM_LEVEL1);
-  AddSound(&sounds[x++], "bomb.wav",              RM_SFX_EXPLOSION,         MM_LEVEL1);
-  AddSound(&sounds[x++], "arrow.wav",             RM_SFX_ARROW,             MM_LEVEL1);
-  AddSound(&sounds[x++], "bicycle.wav",           RM_SFX_BICYCLE,           MM_LEVEL1);
-  AddSound(&sounds[x++], "bicycle_bell.wav",      RM_SFX_BICYCLE_BELL,      MM_LEVEL1);
-  AddSound(&sounds[x++], "game_over.wav",         RM_SFX_GAME_OVER,         MM_LEVEL1|MM_LEVEL_FINAL);
-
-  AddSound(&sounds[x++], "menu_select.wav",       RM_SFX_MENU_SELECT,       MM_LEVEL_FINAL);
-  AddSound(&sounds[x++], "final_level.wav",       RM_SFX_FINAL_MUSIC,       MM_LEVEL_CREDITS|MM_LEVEL_FINAL);
-  AddSound(&sounds[x++], "final_winner.wav",      RM_SFX_FINAL_WIN,         MM_LEVEL_FINAL);
-  AddSound(&sounds[x++], "creditsm.wav",          RM_SFX_CREDITS_MUSIC,     MM_LEVEL_CREDITS);
-  
-  for (x=0; x < NUM_IMAGES - NUM_PERM_IMAGES; x++)
+#ifdef MM_PROFILE
+  if (level & MM_LEVEL1)
   {
-    id = images[x].id;
-    if ( id != 0 && ((images[x].level & level) == 0) && _images[id] != 0)
-    {
-      SDL_FreeSurface(_images[id]);
-      _images[id] = 0;
-    }
+    ResMask level1;
+    GetLevelMask(MM_LEVEL1, &level1);
+    ZIP_ProfileDirectory();
+    ProfileLevelLookups(&level1);
+    ProfileLevelLoad(&level1);
+    ProfileLoadThreads(&level1);
   }
+#endif
+
+  // make room for what is about to be loaded (resources never loaded before
+  // are not counted, their size is not known yet)
+  GetMissing(&load);
+  planned = PlannedBytes(&load);
+  EvictUnused(&_need, planned < _budget ? _budget - planned : 0);
+
+  // load images & sounds for this level that have not allready been loaded
+  AddJobs(&load);
+  RunJobs(_loadThreads, 1);
+  EvictUnused(&_need, _budget);
   
-  // Delete sounds not used in this level
-  for (x=0; x < NUM_SOUNDS; x++)
+  // a resource that failed to load may have run out of memory, free all 
+  // that is not needed (and the Zip Manager's cache) and try again 
+  if (GetMissing(&load))
   {
-    id = sounds[x].id;
-    if ( id != 0 && ((sounds[x].level & level) == 0) && _sounds[id] != 0)
-    {
-      Mix_FreeChunk(_sounds[id]);
-      _sounds[id] = 0;
-    }
+    EvictUnused(&_need, 0);
+    TXT_FlushAtlases();
+    ZIP_FlushCache();
+    AddJobs(&load);
+    RunJobs(0, 1);
   }
-
-  // load images for this level that have not allready been loaded
-  for (x=0; x < NUM_IMAGES - NUM_PERM_IMAGES; x++)
+  
+  // small sprites just loaded share atlas pages from here on
+  PackAtlas(&_need);
+  
+  if (GetMissing(&load))
   {
-    id = images[x].id;
-    if ( (images[x].level & level) && _images[id] == 0)
-      _images[id] = LoadImage(&images[x]);
+    for (w=0; w < IMAGE_WORDS; w++)
+      for (bits = load.images[w]; bits; bits &= bits - 1)
+        EH_Error(EH_WARN, "RM could not load %s\n", 
+                 _imageTable[w * 32 + LowestBit(bits)].name);
+    for (w=0; w < SOUND_WORDS; w++)
+      for (bits = load.sounds[w]; bits; bits &= bits - 1)
+        EH_Error(EH_WARN, "RM could not load %s\n", 
+                 _soundTable[w * 32 + LowestBit(bits)].name);
+    ReportMemory(EH_WARN);
+    status = 1;
   }
-
-  // load sounds for this level that have not allready been loaded
-  for (x=0; x < NUM_SOUNDS; x++)
-  {
-    id = sounds[x].id;
-    if ( (sounds[x].level & level) && _sounds[id] == 0)
-      _sounds[id] = ZIP_LoadMusic(sounds[x].name);
-  } 
+#ifdef MM_PROFILE
+  else
+    ReportMemory(EH_DEBUG);
+#endif
  
   return(status);
 }
@@ -244,91 +437,1067 @@ int RM_InitLevel(unsigned int level)
 //------------------------------------------------------------------------------
 void LoadPermanantImages()
 {
+  int id;
+  
   // Image contains the Walk Ceiling image and the Loop image
   // this image will be loaded into VRAM
-  _images[RM_IMG_BG1] = SCE_LoadBackground1("bg1.bmp");
+  AddPermanant(RM_IMG_BG1, SCE_LoadBackground1(_imageTable[RM_IMG_BG1].name), 1);
   
   // image contains the Run Ceiling and Walk Floor
-  _images[RM_IMG_BG2] = SCE_LoadBackground2("bg2.bmp");
+  AddPermanant(RM_IMG_BG2, SCE_LoadBackground2(_imageTable[RM_IMG_BG2].name), 0);
   
   // Run Floor Images (in 7 different files), load them into VRAM
-  _images[RM_IMG_RF1] = SCE_LoadBackground1("rf1.bmp");
-  _images[RM_IMG_RF2] = SCE_LoadBackground1("rf2.bmp");
-  _images[RM_IMG_RF3] = SCE_LoadBackground1("rf3.bmp");
-  _images[RM_IMG_RF4] = SCE_LoadBackground1("rf4.bmp");
-  _images[RM_IMG_RF5] = SCE_LoadBackground1("rf5.bmp");
-  _images[RM_IMG_RF6] = SCE_LoadBackground1("rf6.bmp");
-  _images[RM_IMG_RF7] = SCE_LoadBackground1("rf7.bmp");
-}
-
-//------------------------------------------------------------------------------
-// Name:     AddImage
-// Summary:  Wrapper function used to populate a LoadRes Structure, which is
-//           the structure used to determine if a resource should be loaded 
-//           for the current level.
-// Inputs:   1. info - Resource Structure to store information into
-//           2. name - string name of file to load
-//           3. id - ID of data (as specified in Resource Manager Header File)
-//           4. level - Ored list of levels this resource should be loaded for
-//           5. format - Format of image (SDL NATIVE or SCREEN format)
-//           6. flags - Flags to use if surface needs to be converted
+  for (id=RM_IMG_RF1; id >= RM_IMG_RF7; id--)
+    AddPermanant(id, SCE_LoadBackground1(_imageTable[id].name), 1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     AddPermanant
+// Summary:  Stores a permanant image and counts the memory it holds
+// Inputs:   1. id - image ID
+//           2. img - image loaded
+//           3. vram - set if the image's pixels are in VRAM
+// Outputs:  None
+// Returns:  None
+// Cautions: The pitch of VRAM surfaces is the screen's, so the size is 
+//           worked out from the width instead
+//------------------------------------------------------------------------------
+void AddPermanant(int id, SDL_Surface *img, int vram)
+{
+  _images[id] = img;
+  if (img == 0)
+    return;
+  
+  _imageBytes[id] = img->w * img->h * img->format->BytesPerPixel;
+  if (vram)
+  {
+    _vram.images[id / 32] |= 1u << (id % 32);
+    _vramBytes += _imageBytes[id];
+  }
+  else
+    _permBytes += _imageBytes[id];
+}
+
+//------------------------------------------------------------------------------
+// Name:     PlannedBytes
+// Summary:  Adds up the size of the resources in a mask, as they were the 
+//           last time they were loaded
+// Inputs:   Mask of resources
+// Outputs:  None
+// Returns:  Bytes, resources never loaded count as 0
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned int PlannedBytes(const ResMask *mask)
+{
+  unsigned int bytes = 0;
+  unsigned int bits;
+  int w;
+  
+  for (w=0; w < IMAGE_WORDS; w++)
+    for (bits = mask->images[w]; bits; bits &= bits - 1)
+      bytes += _imageBytes[w * 32 + LowestBit(bits)];
+  for (w=0; w < SOUND_WORDS; w++)
+    for (bits = mask->sounds[w]; bits; bits &= bits - 1)
+      bytes += _soundBytes[w * 32 + LowestBit(bits)];
+  return(bytes);
+}
+
+//------------------------------------------------------------------------------
+// Name:     EvictUnused
+// Summary:  Frees loaded resources that are not in a mask, least recently 
+//           used first, until the resources held fit in the given budget
+// Inputs:   1. keep - resources that must not be freed
+//           2. budget - bytes the level resources may hold
+// Outputs:  None
+// Returns:  None
+// Cautions: Resources in keep are never freed, so this may not get down to
+//           the budget
+//------------------------------------------------------------------------------
+void EvictUnused(const ResMask *keep, unsigned int budget)
+{
+  unsigned int bits;
+  unsigned int oldest;
+  int lru, lruSound, id, w;
+  
+  while (_ramBytes > budget)
+  {
+    lru      = -1;
+    lruSound = 0;
+    oldest   = 0;
+    for (w=0; w < IMAGE_WORDS; w++)
+    {
+      for (bits = _loaded.images[w] & ~keep->images[w]; bits; bits &= bits - 1)
+      {
+        id = w * 32 + LowestBit(bits);
+        if (lru < 0 || _imageUsed[id] < oldest)
+        {
+          lru    = id;
+          oldest = _imageUsed[id];
+        }
+      }
+    }
+    for (w=0; w < SOUND_WORDS; w++)
+    {
+      for (bits = _loaded.sounds[w] & ~keep->sounds[w]; bits; bits &= bits - 1)
+      {
+        id = w * 32 + LowestBit(bits);
+        if (lru < 0 || _soundUsed[id] < oldest)
+        {
+          lru      = id;
+          lruSound = 1;
+          oldest   = _soundUsed[id];
+        }
+      }
+    }
+    
+    if (lru < 0)
+      break;
+    FreeResource(lru, lruSound);
+    _evictions++;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     FreeResource
+// Summary:  Frees a loaded image or sound
+// Inputs:   1. id - ID of resource
+//           2. isSound - set if id is a SFX ID
+// Outputs:  None
+// Returns:  None
+// Cautions: Resource must be loaded (its _loaded bit set)
+//------------------------------------------------------------------------------
+void FreeResource(int id, int isSound)
+{
+  unsigned int bit = 1u << (id % 32);
+  AtlasPage *page;
+  
+  if (isSound)
+  {
+    Mix_FreeChunk(_sounds[id]);
+    _sounds[id] = 0;
+    _loaded.sounds[id / 32] &= ~bit;
+    _ramBytes -= _soundBytes[id];
+  }
+  else if (_imagePage[id] >= 0)
+  {
+    // the page's memory is only freed with the last image on it
+    page = &_pages[(int) _imagePage[id]];
+    SDL_FreeSurface(_images[id]);
+    _images[id]    = 0;
+    _imagePage[id] = -1;
+    _loaded.images[id / 32] &= ~bit;
+    if (--page->refs == 0)
+    {
+      _ramBytes -= page->img->pitch * page->img->h;
+      SDL_FreeSurface(page->img);
+      page->img = 0;
+    }
+  }
+  else
+  {
+    SDL_FreeSurface(_images[id]);
+    _images[id] = 0;
+    _loaded.images[id / 32] &= ~bit;
+    _ramBytes -= _imageBytes[id];
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     PackAtlas
+// Summary:  Packs the loaded ATLAS_FORMAT images in a mask into atlas pages,
+//           images of the same pixel format share pages
+// Inputs:   Mask of images to pack
+// Outputs:  None
+// Returns:  None
+// Cautions: Images allready packed, too big for a page or with a palette 
+//           are left as they are
+//------------------------------------------------------------------------------
+void PackAtlas(const ResMask *mask)
+{
+  SDL_PixelFormat *format;
+  int ids[NUM_IMAGES];
+  int group[NUM_IMAGES];
+  int count = 0;
+  int size  = 0;
+  int w, x, y, t;
+  unsigned int bits;
+  
+  for (w=0; w < IMAGE_WORDS; w++)
+    for (bits = mask->images[w]; bits; bits &= bits - 1)
+      if (CanPack(w * 32 + LowestBit(bits)))
+        ids[count++] = w * 32 + LowestBit(bits);
+  
+  while (count > 0)
+  {
+    // take every image with the same format as the first 1 left
+    format = _images[ids[0]]->format;
+    size   = 0;
+    for (x=0, y=0; x < count; x++)
+    {
+      if (SameFormat(_images[ids[x]]->format, format))
+        group[size++] = ids[x];
+      else
+        ids[y++] = ids[x];
+    }
+    count = y;
+    
+    // tallest first, so each shelf of a page is as tall as its first image
+    for (x=1; x < size; x++)
+    {
+      for (y=x; y > 0 && _images[group[y]]->h > _images[group[y - 1]]->h; y--)
+      {
+        t            = group[y];
+        group[y]     = group[y - 1];
+        group[y - 1] = t;
+      }
+    }
+    
+    for (x=0; x < size; x += PackPage(group + x, size - x))
+      ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     PackPage
+// Summary:  Creates an atlas page and packs as many of the given images into
+//           it as will fit, in rows (shelves) from the top down
+// Inputs:   1. ids - images to pack, all the same format, tallest first
+//           2. count - number of images
+// Outputs:  None
+// Returns:  Number of images used up (packed or left as they are)
+// Cautions: The page is only as tall as the images on it need
+//------------------------------------------------------------------------------
+int PackPage(const int *ids, int count)
+{
+  SDL_Rect rect[NUM_IMAGES];
+  SDL_PixelFormat *f = _images[ids[0]]->format;
+  SDL_Surface *img;
+  AtlasPage *page;
+  int x      = 0;
+  int y      = 0;
+  int shelf  = 0;
+  int n, p;
+  
+  for (p=0; p < MAX_ATLAS_PAGES && _pages[p].img; p++)
+    ;
+  if (p == MAX_ATLAS_PAGES)  // no pages left, the images stay as they are
+    return(count);
+  page = &_pages[p];
+  
+  for (n=0; n < count; n++)
+  {
+    img = _images[ids[n]];
+    if (x + img->w > ATLAS_WIDTH)  // start a new shelf
+    {
+      y    += shelf;
+      x     = 0;
+      shelf = 0;
+    }
+    if (y + img->h > ATLAS_HEIGHT)
+      break;
+    if (shelf == 0)
+      shelf = img->h;
+    rect[n].x = x;
+    rect[n].y = y;
+    rect[n].w = img->w;
+    rect[n].h = img->h;
+    x        += img->w;
+  }
+  
+  page->img = SDL_CreateRGBSurface(SDL_SWSURFACE, ATLAS_WIDTH, y + shelf,
+                                   f->BitsPerPixel, f->Rmask, f->Gmask, 
+                                   f->Bmask, f->Amask);
+  if (page->img == 0)
+    return(n);
+    
+  page->refs = 0;
+  for (x=0; x < n; x++)
+    page->refs += PackImage(ids[x], p, &rect[x]);
+    
+  if (page->refs == 0)
+  {
+    SDL_FreeSurface(page->img);
+    page->img = 0;
+  }
+  else
+    _ramBytes += page->img->pitch * page->img->h;
+  return(n);
+}
+
+//------------------------------------------------------------------------------
+// Name:     PackImage
+// Summary:  Copies a loaded image into its place on an atlas page and 
+//           replaces it with a view of that part of the page
+// Inputs:   1. id - image ID
+//           2. page - index of page
+//           3. rect - where the image goes on the page
+// Outputs:  None
+// Returns:  1 if the image was packed, 0 if it was left as it is
+// Cautions: The view keeps the image's colorkey & alpha settings.  The image
+//           is freed.
+//------------------------------------------------------------------------------
+int PackImage(int id, int page, const SDL_Rect *rect)
+{
+  SDL_Surface *img  = _images[id];
+  SDL_Surface *dst  = _pages[page].img;
+  SDL_PixelFormat *f = img->format;
+  Uint8 *pixels     = (Uint8 *) dst->pixels + rect->y * dst->pitch + 
+                      rect->x * f->BytesPerPixel;
+  SDL_Surface *view;
+  int row;
+  
+  view = SDL_CreateRGBSurfaceFrom(pixels, rect->w, rect->h, f->BitsPerPixel,
+                                  dst->pitch, f->Rmask, f->Gmask, f->Bmask,
+                                  f->Amask);
+  if (view == 0)
+    return(0);
+    
+  for (row=0; row < rect->h; row++)
+    memcpy(pixels + row * dst->pitch, (Uint8 *) img->pixels + row * img->pitch,
+           rect->w * f->BytesPerPixel);
+           
+  if (img->flags & SDL_SRCCOLORKEY)
+    SDL_SetColorKey(view, SDL_SRCCOLORKEY, f->colorkey);
+  if ((img->flags & SDL_SRCALPHA) && f->Amask == 0)
+    SDL_SetAlpha(view, SDL_SRCALPHA, f->alpha);
+  
+  _ramBytes       -= _imageBytes[id];
+  _imageBytes[id]  = rect->w * rect->h * f->BytesPerPixel;
+  _imagePage[id]   = page;
+  _images[id]      = view;
+  SDL_FreeSurface(img);
+  return(1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CanPack
+// Summary:  Checks if an image can be packed into an atlas page
+// Inputs:   Image ID
+// Outputs:  None
+// Returns:  Non-zero if the image can be packed
+// Cautions: None
+//------------------------------------------------------------------------------
+int CanPack(int id)
+{
+  SDL_Surface *img = _images[id];
+  
+  return((_imageTable[id].format & ATLAS_FORMAT) && img && 
+         _imagePage[id] < 0 && img->format->BytesPerPixel >= 2 &&
+         img->w <= ATLAS_WIDTH && img->h <= ATLAS_HEIGHT &&
+         (img->flags & SDL_RLEACCEL) == 0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SameFormat
+// Summary:  Checks if 2 pixel formats store pixels the same way
+// Inputs:   Formats to compare
+// Outputs:  None
+// Returns:  Non-zero if they do
+// Cautions: Colorkey & surface alpha are not compared, they are kept by each
+//           image's view
+//------------------------------------------------------------------------------
+int SameFormat(SDL_PixelFormat *a, SDL_PixelFormat *b)
+{
+  return(a->BitsPerPixel == b->BitsPerPixel && a->Rmask == b->Rmask &&
+         a->Gmask == b->Gmask && a->Bmask == b->Bmask && a->Amask == b->Amask);
+}
+
+//------------------------------------------------------------------------------
+// Name:     GetMissing
+// Summary:  Gets the resources the last level loaded uses that are not loaded
+// Inputs:   None
+// Outputs:  missing - resources not loaded
+// Returns:  Non-zero if any are missing
+// Cautions: None
+//------------------------------------------------------------------------------
+int GetMissing(ResMask *missing)
+{
+  unsigned int any = 0;
+  int w;
+  
+  for (w=0; w < IMAGE_WORDS; w++)
+    any |= missing->images[w] = _need.images[w] & ~_loaded.images[w];
+  for (w=0; w < SOUND_WORDS; w++)
+    any |= missing->sounds[w] = _need.sounds[w] & ~_loaded.sounds[w];
+  return(any != 0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReportMemory
+// Summary:  Reports the memory held by the Resource Manager and the 
+//           resources holding the most of it
+// Inputs:   EH_xxx severity to report with
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void ReportMemory(int severity)
+{
+  RM_Consumer top[REPORT_CONSUMERS];
+  int count = RM_GetTopConsumers(top, REPORT_CONSUMERS);
+  int x;
+  
+  EH_Error(severity, "RM %uK RAM (%uK permanant), %uK VRAM, budget %uK, "
+           "%u evictions\n", (_ramBytes + _permBytes) / 1024, 
+           _permBytes / 1024, _vramBytes / 1024, _budget / 1024, _evictions);
+  for (x=0; x < count; x++)
+    EH_Error(severity, "  %s %uK%s\n", top[x].name, top[x].bytes / 1024,
+             top[x].vram ? " VRAM" : "");
+}
+
+//------------------------------------------------------------------------------
+// Name:     BuildLevelMasks
+// Summary:  Builds the mask of images & sounds used by each level from the 
+//           resource tables, so RM_InitLevel can work out what to free and 
+//           load with a few bit operations
+// Inputs:   None
 // Outputs:  None
 // Returns:  None
 // Cautions: None
 //------------------------------------------------------------------------------
-void AddImage(LoadResStruct *info, const char *name,      unsigned short id,
-              unsigned int level,  unsigned short format, unsigned int flags)
+void BuildLevelMasks()
 {
-  strcpy(info->name, name);
-  info->id     = id;
-  info->level  = level;
-  info->format = format;
-  info->flags  = flags;
+  int id, b;
+  
+  memset(_levelMasks, 0, sizeof(_levelMasks));
+  memset(&_loaded, 0, sizeof(_loaded));
+  
+  for (b=0; b < NUM_LEVEL_BITS; b++)
+  {
+    for (id=0; id < NUM_IMAGES; id++)
+      if (_imageTable[id].level & (1 << b))
+        _levelMasks[b].images[id / 32] |= 1u << (id % 32);
+        
+    for (id=0; id < NUM_SOUNDS; id++)
+      if (_soundTable[id].level & (1 << b))
+        _levelMasks[b].sounds[id / 32] |= 1u << (id % 32);
+  }
 }
 
 //------------------------------------------------------------------------------
-// Name:     AddSound
-// Summary:  Wrapper function used to populate a LoadRes Structure, which is
-//           the structure used to determine if a resource should be loaded 
-//           for the current level.
-// Inputs:   Same as AddImage, but format & flags paramaters are ignored
-// Outputs:  None
+// Name:     GetLevelMask
+// Summary:  Gets the mask of images & sounds used by the given level(s)
+// Inputs:   Ored list of levels
+// Outputs:  mask - resources used
 // Returns:  None
 // Cautions: None
 //------------------------------------------------------------------------------
-void  AddSound(LoadResStruct *info, const char *name, unsigned short id,
-               unsigned int level)
+void GetLevelMask(unsigned int level, ResMask *mask)
+{
+  int b, w;
+  
+  memset(mask, 0, sizeof(ResMask));
+  for (b=0; b < NUM_LEVEL_BITS; b++)
+  {
+    if ((level & (1 << b)) == 0)
+      continue;
+    for (w=0; w < IMAGE_WORDS; w++)
+      mask->images[w] |= _levelMasks[b].images[w];
+    for (w=0; w < SOUND_WORDS; w++)
+      mask->sounds[w] |= _levelMasks[b].sounds[w];
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     LowestBit
+// Summary:  Finds the lowest bit set
+// Inputs:   Bits to search (must not be 0)
+// Outputs:  None
+// Returns:  Index of lowest bit set
+// Cautions: None
+//------------------------------------------------------------------------------
+int LowestBit(unsigned int bits)
+{
+  return(__builtin_ctz(bits));
+}
+
+//------------------------------------------------------------------------------
+// Name:     BuildIndex
+// Summary:  Builds a perfect hash of the names in a resource table, by trying
+//           seeds until 1 is found that puts every name in a slot of its own
+// Inputs:   1. index - index to build
+//           2. table - resource table
+//           3. count - entries in table
+// Outputs:  None
+// Returns:  None
+// Cautions: If no seed works (more names than the index can hold) every 
+//           lookup fails, the game itself only uses ids
+//------------------------------------------------------------------------------
+void BuildIndex(ResIndex *index, const LoadResStruct *table, int count)
+{
+  unsigned int seed, slot;
+  int id;
+  
+  index->table = table;
+  index->count = count;
+  
+  for (seed=1; seed < MAX_INDEX_SEEDS; seed++)
+  {
+    memset(index->slots, 0, sizeof(index->slots));
+    for (id=0; id < count; id++)
+    {
+      if (table[id].name == 0)
+        continue;
+      slot = IndexSlot(table[id].name, seed);
+      if (index->slots[slot])
+        break;
+      index->slots[slot] = id + 1;
+    }
+    
+    if (id == count)
+    {
+      index->seed = seed;
+      return;
+    }
+  }
+  
+  memset(index->slots, 0, sizeof(index->slots));
+  EH_Error(EH_DEBUG, "RM could not build name index\n");
+}
+
+//------------------------------------------------------------------------------
+// Name:     FindIndex
+// Summary:  Looks up the id of a resource by its file name
+// Inputs:   1. index - index to search
+//           2. name - file name of resource (case insensitive)
+// Outputs:  None
+// Returns:  Id of resource, -1 if it is not in the table
+// Cautions: None
+//------------------------------------------------------------------------------
+int FindIndex(const ResIndex *index, const char *name)
+{
+  int id = index->slots[IndexSlot(name, index->seed)] - 1;
+  
+  if (id < 0 || strcasecmp(index->table[id].name, name))
+    return(-1);
+  return(id);
+}
+
+//------------------------------------------------------------------------------
+// Name:     IndexSlot
+// Summary:  Case insensitive (FNV-1a) hash of a file name, mixed with a seed
+//           and folded down to a name index slot
+// Inputs:   1. name - file name
+//           2. seed - seed of the index
+// Outputs:  None
+// Returns:  Slot of name in the index
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned int IndexSlot(const char *name, unsigned int seed)
 {
-  AddImage(info, name, id, level, 0, 0);
+  unsigned int hash = 2166136261u;
+  
+  while (*name)
+  {
+    hash ^= (unsigned char) tolower((unsigned char) *name++);
+    hash *= 16777619u;
+  }
+  return(((hash ^ seed) * 2654435761u) >> 22);  // top 10 bits (INDEX_SIZE)
 }
 
 //------------------------------------------------------------------------------
 // Name:     LoadImage
 // Summary:  Loads the image specified in the resource structure and formats
 //           it as described by the formatting flags contained in the structure
-// Inputs:   LoadResStruct - structure contining info on image to load
+// Inputs:   1. LoadResStruct - structure contining info on image to load
+//           2. reader - zip reader to load with, 0 to use the Zip Manager's
+//              own handle
 // Outputs:  None
-// Returns:  SDL_Surface of image loaded into memory
-// Cautions: None
+// Returns:  SDL_Surface of image loaded into memory
+// Cautions: The image does not come from the Zip Manager's asset cache, so
+//           freeing it (SDL_FreeSurface) really frees the memory counted
+//           for it.  Level resources are kept by this class instead (see
+//           EvictUnused).
+//------------------------------------------------------------------------------
+SDL_Surface *LoadImage(const LoadResStruct *ptr, ZIP_Reader *reader)
+{
+  int flags = 0;
+  
+  // the Zip Manager converts to screen format (baked images allready are)
+  // and sets the transparent background
+  if (ptr->format & SCREEN_FORMAT)
+    flags |= ZIP_IMG_SCREEN;
+  if (ptr->format & TRANSP_FORMAT)
+    flags |= ZIP_IMG_TRANSP;
+  return(ZIP_ReadImage(reader, ptr->name, flags));
+}  
+
+#ifdef MM_PROFILE
+//------------------------------------------------------------------------------
+// Name:     ProfileLevelLookups
+// Summary:  Benchmark, passes every image & sound used by the given level to
+//           the Zip Manager to time how long it takes to find them, and how
+//           long they take to decompress with each codec
+// Inputs:   Mask of level's resources
+// Outputs:  None
+// Returns:  None
+// Cautions: Zip file must be open
+//------------------------------------------------------------------------------
+void ProfileLevelLookups(const ResMask *mask)
+{
+  const char *names[NUM_IMAGES + NUM_SOUNDS];
+  int count = 0;
+  int x     = 0;
+  
+  for (x=0; x < NUM_IMAGES; x++)
+    if (mask->images[x / 32] & (1u << (x % 32)))
+      names[count++] = _imageTable[x].name;
+      
+  for (x=0; x < NUM_SOUNDS; x++)
+    if (mask->sounds[x / 32] & (1u << (x % 32)))
+      names[count++] = _soundTable[x].name;
+      
+  ZIP_ProfileLookups(names, count);
+  ZIP_ProfileCodecs(names, count);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ProfileLevelLoad
+// Summary:  Benchmark, times loading (then freeing) every image & sound used
+//           by the given level with each of the Zip Manager IO backends
+// Inputs:   Mask of level's resources
+// Outputs:  None
+// Returns:  None
+// Cautions: Zip files must be open, they are re-opened for each backend
+//------------------------------------------------------------------------------
+void ProfileLevelLoad(const ResMask *mask)
+{
+  static const char *names[] = { "memory", "stdio" };
+  int backends[]     = { ZIP_IO_MEMORY, ZIP_IO_STDIO };
+  int oldBackend     = ZIP_SetIoBackend(ZIP_IO_MEMORY);
+  unsigned int files = ZIP_GetOpenZipFiles();
+  unsigned int start;
+  int b, x;
+  
+  for (b=0; b < 2; b++)
+  {
+    ZIP_CloseZipFile();
+    ZIP_SetIoBackend(backends[b]);
+    ZIP_OpenZipFile(files);
+    
+    start = MM_GetMicroSeconds();
+    for (x=0; x < NUM_IMAGES; x++)
+      if (mask->images[x / 32] & (1u << (x % 32)))
+        SDL_FreeSurface(LoadImage(&_imageTable[x], 0));
+    for (x=0; x < NUM_SOUNDS; x++)
+      if (mask->sounds[x / 32] & (1u << (x % 32)))
+        Mix_FreeChunk(ZIP_ReadMusic(0, _soundTable[x].name));
+        
+    EH_Error(EH_DEBUG, "RM load (%s as %s): %uus\n", names[b],
+             names[ZIP_GetIoBackend()], MM_GetMicroSeconds() - start);
+  }
+  
+  ZIP_CloseZipFile();
+  ZIP_SetIoBackend(oldBackend);
+  ZIP_OpenZipFile(files);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ProfileLoadThreads
+// Summary:  Benchmark, times (wall clock) loading every image & sound used 
+//           by the given level with 1, 2, 4 and the default number of load
+//           threads
+// Inputs:   Mask of level's resources
+// Outputs:  None
+// Returns:  None
+// Cautions: Zip file must be open.  Loaded resources are freed.
 //------------------------------------------------------------------------------
-SDL_Surface *LoadImage(LoadResStruct *ptr)
+void ProfileLoadThreads(const ResMask *mask)
 {
-  SDL_Surface *tmp;
-  SDL_Surface *scr = MM_GetScreenPtr();  
-  tmp = ZIP_LoadImage(ptr->name);
+  int threads[] = { 1, 2, 4, DefaultLoadThreads() };
+  RM_ProgressFunction progress = _progress;
+  unsigned int start;
+  int x;
   
-  if (ptr->format & SCREEN_FORMAT)   // convert to screen format
+  _progress = 0;
+  for (x=0; x < 4; x++)
   {
-    SDL_Surface *tmp1 = SDL_ConvertSurface(tmp, scr->format, ptr->flags);  
-    SDL_FreeSurface(tmp);
-    tmp = tmp1;
+    AddJobs(mask);
+    start = MM_GetMicroSeconds();
+    RunJobs(threads[x], 0);
+    EH_Error(EH_DEBUG, "RM load %d threads: %uus\n", threads[x],
+             MM_GetMicroSeconds() - start);
   }
+  _progress = progress;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Name:     AddJobs
+// Summary:  Fills the load job list with the images & sounds in a mask
+// Inputs:   Mask of resources to load
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void AddJobs(const ResMask *mask)
+{
+  unsigned int bits;
+  int w = 0;
+  _numJobs = 0;
   
-  if (ptr->format & TRANSP_FORMAT) // activate transparent background
-    SDL_SetColorKey(tmp, SDL_SRCCOLORKEY, SDL_MapRGB(tmp->format, 0xFF, 0x80, 0x80));      
+  for (w=0; w < IMAGE_WORDS; w++)
+  {
+    for (bits = mask->images[w]; bits; bits &= bits - 1)
+    {
+      _jobs[_numJobs].id      = w * 32 + LowestBit(bits);
+      _jobs[_numJobs].res     = &_imageTable[_jobs[_numJobs].id];
+      _jobs[_numJobs].isSound = 0;
+      _jobs[_numJobs].data    = 0;
+      _jobs[_numJobs].error[0] = 0;
+      _numJobs++;
+    }
+  }
   
-  return(tmp);
-}  
+  for (w=0; w < SOUND_WORDS; w++)
+  {
+    for (bits = mask->sounds[w]; bits; bits &= bits - 1)
+    {
+      _jobs[_numJobs].id      = w * 32 + LowestBit(bits);
+      _jobs[_numJobs].res     = &_soundTable[_jobs[_numJobs].id];
+      _jobs[_numJobs].isSound = 1;
+      _jobs[_numJobs].data    = 0;
+      _jobs[_numJobs].error[0] = 0;
+      _numJobs++;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     RunJobs
+// Summary:  Loads every resource in the job list.  The jobs are split among 
+//           the load threads, each with a zip reader of its own, while this
+//           (the main) thread waits for them to finish.  As each one 
+//           finishes the main thread stores it and reports the progress
+//           so far (and again every PROGRESS_INTERVAL ms while it waits),
+//           so a load screen can be kept moving.
+// Inputs:   1. threads - number of load threads to use, 0 loads everything
+//              on the main thread
+//           2. publish - if set, loaded resources are stored in _images &
+//              _sounds, otherwise they are freed (for profiling)
+// Outputs:  None
+// Returns:  None
+// Cautions: The zip file must be open.  If a thread can not be started, the
+//           jobs are shared among the threads that could be.
+//------------------------------------------------------------------------------
+void RunJobs(int threads, int publish)
+{
+  SDL_Thread *thread[MAX_LOAD_THREADS];
+  ZIP_Reader *reader[MAX_LOAD_THREADS];
+  int done  = 0;
+  int count = 0;
+  int job   = 0;
+  
+  _nextJob     = 0;
+  _numFinished = 0;
+  
+  if (threads > MAX_LOAD_THREADS)
+    threads = MAX_LOAD_THREADS;
+  if (threads > _numJobs)
+    threads = _numJobs;
+  
+  // readers are opened here since opening one is not thread safe
+  for (count=0; count < threads; count++)
+  {
+    reader[count] = ZIP_OpenReader();
+    if (reader[count] == 0)
+      break;
+    thread[count] = SDL_CreateThread(LoadThread, reader[count]);
+    if (thread[count] == 0)
+    {
+      ZIP_CloseReader(reader[count]);
+      break;
+    }
+  }
+  
+  if (count == 0)  // no load threads, do it all here
+  {
+    for (job=0; job < _numJobs; job++)
+    {
+      _jobs[job].data = LoadJobData(&_jobs[job], 0);
+      PublishJob(&_jobs[job], publish);
+      if (_progress)
+        _progress(job + 1, _numJobs);
+    }
+    return;
+  }
+  
+  done = 0;
+  while (done < _numJobs)
+  {
+    // a big file can take a while, keep the load screen moving meanwhile
+    if (SDL_SemWaitTimeout(_jobSem, PROGRESS_INTERVAL) != 0)
+    {
+      if (_progress)
+        _progress(done, _numJobs);
+      continue;
+    }
+    SDL_mutexP(_jobLock);
+    job = _finished[done];
+    SDL_mutexV(_jobLock);
+    
+    PublishJob(&_jobs[job], publish);
+    done++;
+    if (_progress)
+      _progress(done, _numJobs);
+  }
+  
+  while (count--)
+  {
+    SDL_WaitThread(thread[count], 0);
+    ZIP_CloseReader(reader[count]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     LoadThread
+// Summary:  Load thread, takes jobs off the job list and loads them until 
+//           there are none left
+// Inputs:   ZIP_Reader to load with
+// Outputs:  None
+// Returns:  0
+// Cautions: None
+//------------------------------------------------------------------------------
+int LoadThread(void *data)
+{
+  ZIP_Reader *reader = (ZIP_Reader *) data;
+  int job;
+  
+  while (1)
+  {
+    SDL_mutexP(_jobLock);
+    job = (_nextJob < _numJobs) ? _nextJob++ : -1;
+    SDL_mutexV(_jobLock);
+    if (job < 0)
+      break;
+      
+    _jobs[job].data = LoadJobData(&_jobs[job], reader);
+    
+    SDL_mutexP(_jobLock);
+    _finished[_numFinished++] = job;
+    SDL_mutexV(_jobLock);
+    SDL_SemPost(_jobSem);
+  }
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LoadJobData
+// Summary:  Loads the image or sound described by a load job
+// Inputs:   1. job - job to load
+//           2. reader - zip reader to load with (0 for main zip handle)
+// Outputs:  job - why the load failed, if it was loaded through a reader
+// Returns:  SDL_Surface or Mix_Chunk loaded, 0 on error
+// Cautions: Failures on the main zip handle are reported by the Zip 
+//           Manager itself, PublishJob reports those on a reader
+//------------------------------------------------------------------------------
+void *LoadJobData(LoadJob *job, ZIP_Reader *reader)
+{
+  void *data;
+  
+  if (job->isSound)
+    data = ZIP_ReadMusic(reader, job->res->name);
+  else
+    data = LoadImage(job->res, reader);
+    
+  if (data == 0 && reader)
+  {
+    strncpy(job->error, ZIP_GetReaderError(reader), JOB_ERROR_LENGTH - 1);
+    job->error[JOB_ERROR_LENGTH - 1] = 0;
+  }
+  return(data);
+}
+
+//------------------------------------------------------------------------------
+// Name:     PublishJob
+// Summary:  Stores a loaded resource where RM_GetImage/RM_GetSoundFx can
+//           find it, and marks it loaded (& counts its size) if it could be.
+//           Reports why a load thread could not load it if it could not.
+// Inputs:   1. job - finished job
+//           2. publish - if 0 the resource is freed instead
+// Outputs:  None
+// Returns:  None
+// Cautions: Main thread only
+//------------------------------------------------------------------------------
+void PublishJob(LoadJob *job, int publish)
+{
+  unsigned int bit = 1u << (job->id % 32);
+  
+  if (job->error[0])
+  {
+    EH_Error(EH_WARN, "%s", job->error);
+    job->error[0] = 0;
+  }
+  
+  if (job->isSound)
+  {
+    if (publish)
+    {
+      _sounds[job->id] = (Mix_Chunk *) job->data;
+      if (job->data)
+      {
+        _loaded.sounds[job->id / 32] |= bit;
+        _soundBytes[job->id]          = _sounds[job->id]->alen;
+        _ramBytes                    += _soundBytes[job->id];
+      }
+    }
+    else
+      Mix_FreeChunk((Mix_Chunk *) job->data);
+  }
+  else
+  {
+    if (publish)
+    {
+      _images[job->id] = (SDL_Surface *) job->data;
+      if (job->data)
+      {
+        _loaded.images[job->id / 32] |= bit;
+        _imageBytes[job->id]          = _images[job->id]->pitch * 
+                                        _images[job->id]->h;
+        _ramBytes                    += _imageBytes[job->id];
+      }
+    }
+    else
+      SDL_FreeSurface((SDL_Surface *) job->data);
+  }
+  job->data = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name:     DefaultLoadThreads
+// Summary:  Picks the number of load threads to use
+// Inputs:   None
+// Outputs:  None
+// Returns:  Number of load threads
+// Cautions: The PSP only has 1 core for us, 1 load thread still lets the 
+//           main thread draw the load screen while resources are loaded.
+//------------------------------------------------------------------------------
+int DefaultLoadThreads()
+{
+  int threads = 1;
+#if defined(_SC_NPROCESSORS_ONLN) && !defined(__psp__)
+  threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_LOAD_THREADS)
+    threads = MAX_LOAD_THREADS;
+  return(threads);
+}
+
+//------------------------------------------------------------------------------
+// Name:     RM_SetLoadThreads
+// Summary:  Sets the number of threads RM_InitLevel loads resources with
+// Inputs:   Number of threads (0 loads everything on the calling thread, 
+//           -1 picks the default for the system)
+// Outputs:  None
+// Returns:  Number of threads used before this call
+// Cautions: None
+//------------------------------------------------------------------------------
+int RM_SetLoadThreads(int count)
+{
+  int old = _loadThreads;
+  if (count < 0)
+    count = DefaultLoadThreads();
+  if (count > MAX_LOAD_THREADS)
+    count = MAX_LOAD_THREADS;
+  _loadThreads = count;
+  return(old);
+}
+
+//------------------------------------------------------------------------------
+// Name:     RM_SetProgressFunction
+// Summary:  Sets the function called each time RM_InitLevel finishes loading
+//           a resource (used to update the load screen)
+// Inputs:   Function to call, 0 for none
+// Outputs:  None
+// Returns:  None
+// Cautions: Function is always called from the main thread
+//------------------------------------------------------------------------------
+void RM_SetProgressFunction(RM_ProgressFunction func)
+{
+  _progress = func;
+}
+
+//------------------------------------------------------------------------------
+// Name:     RM_SetBudget
+// Summary:  Sets how many bytes of RAM the level resources may hold, 
+//           resources the last level loaded does not use are freed (least
+//           recently used first) to stay in it
+// Inputs:   Budget in bytes
+// Outputs:  None
+// Returns:  Budget before this call
+// Cautions: The resources a level uses are always loaded, even if they need
+//           more than the budget.  Permanant images are not counted.
+//------------------------------------------------------------------------------
+unsigned int RM_SetBudget(unsigned int bytes)
+{
+  unsigned int old = _budget;
+  _budget = bytes;
+  EvictUnused(&_need, _budget);
+  return(old);
+}
+
+//------------------------------------------------------------------------------
+// Name:     RM_GetMemory
+// Summary:  Gets the memory held by the Resource Manager
+// Inputs:   None
+// Outputs:  mem - memory held
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void RM_GetMemory(RM_Memory *mem)
+{
+  int x;
+  
+  mem->ramBytes  = _ramBytes;
+  mem->permBytes = _permBytes;
+  mem->vramBytes = _vramBytes;
+  mem->budget    = _budget;
+  mem->evictions = _evictions;
+  mem->pages     = 0;
+  for (x=0; x < MAX_ATLAS_PAGES; x++)
+    if (_pages[x].img)
+      mem->pages++;
+}
+
+//------------------------------------------------------------------------------
+// Name:     RM_GetTopConsumers
+// Summary:  Gets the loaded resources holding the most memory (RAM or VRAM)
+// Inputs:   max - number of resources wanted
+// Outputs:  top - resources, largest first
+// Returns:  Number of resources stored in top
+// Cautions: None
+//------------------------------------------------------------------------------
+int RM_GetTopConsumers(RM_Consumer *top, int max)
+{
+  RM_Consumer c;
+  int count = 0;
+  int id, x;
+  
+  for (id=0; id < NUM_IMAGES + NUM_SOUNDS; id++)
+  {
+    c.isSound = (id >= NUM_IMAGES);
+    c.id      = c.isSound ? id - NUM_IMAGES : id;
+    if (c.isSound ? _sounds[c.id] == 0 : _images[c.id] == 0)
+      continue;
+    c.bytes = c.isSound ? _soundBytes[c.id] : _imageBytes[c.id];
+    c.name  = c.isSound ? _soundTable[c.id].name : _imageTable[c.id].name;
+    c.vram  = !c.isSound && (_vram.images[c.id / 32] & (1u << (c.id % 32)));
+    
+    // insert, keeping the list sorted largest first
+    for (x=count; x > 0 && top[x - 1].bytes < c.bytes; x--)
+      if (x < max)
+        top[x] = top[x - 1];
+    if (x < max)
+    {
+      top[x] = c;
+      if (count < max)
+        count++;
+    }
+  }
+  return(count);
+}
 
 //------------------------------------------------------------------------------
 // Name:     RM_GetImage
@@ -397,6 +1566,30 @@ Mix_Chunk* RM_GetSoundFx(int index)
   return(ptr);
 }
 
+//------------------------------------------------------------------------------
+// Name:     RM_FindImage
+// Summary:  Looks up the id of an image by its file name
+// Inputs:   File name of image (case insensitive)
+// Outputs:  None
+// Returns:  Image ID (as specified in Resource Manager Header File), -1 if
+//           the image is not 1 the Resource Manager loads
+// Cautions: None
+//------------------------------------------------------------------------------
+int RM_FindImage(const char *name)
+  { return(FindIndex(&_imageIndex, name)); }
+
+//------------------------------------------------------------------------------
+// Name:     RM_FindSound
+// Summary:  Looks up the id of a SFX by its file name
+// Inputs:   File name of SFX (case insensitive)
+// Outputs:  None
+// Returns:  SFX ID (as specified in Resource Manager Header File), -1 if
+//           the SFX is not 1 the Resource Manager loads
+// Cautions: None
+//------------------------------------------------------------------------------
+int RM_FindSound(const char *name)
+  { return(FindIndex(&_soundIndex, name)); }
+
 //------------------------------------------------------------------------------
 // Name:     RM_GetLastLevelLoaded
 // Summary:  Tracks the last level loaded by the resource manager
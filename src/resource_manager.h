@@ -3,6 +3,30 @@
 #include "common.h"
 #include "SDL_mixer.h"
 
+// Called by RM_InitLevel each time a resource finishes loading
+typedef void (*RM_ProgressFunction) (int loaded, int total);
+
+// Memory held by the Resource Manager, see RM_GetMemory
+typedef struct RM_Memory
+{
+  unsigned int ramBytes;      // RAM held by level resources
+  unsigned int permBytes;     // RAM held by permanent images
+  unsigned int vramBytes;     // VRAM held by permanent images
+  unsigned int budget;        // RAM level resources may hold (RM_SetBudget)
+  unsigned int evictions;     // resources freed to stay in budget
+  unsigned int pages;         // atlas pages held
+} RM_Memory;
+
+// A loaded resource, as listed by RM_GetTopConsumers
+typedef struct RM_Consumer
+{
+  int          id;            // image or SFX ID
+  int          isSound;
+  int          vram;          // set if the image's pixels are in VRAM
+  unsigned int bytes;
+  const char   *name;         // file name
+} RM_Consumer;
+
 void         RM_Init();
 int          RM_InitLevel(unsigned int level);
 unsigned int RM_GetLastLevelLoaded();
@@ -14,6 +38,13 @@ int          RM_StopSound(int channel);
 int          RM_PlaySoundLoop(int index);
 void         RM_PauseSound(int channel);
 void         RM_ResumeSound(int channel);
+void         RM_SetProgressFunction(RM_ProgressFunction func);
+int          RM_SetLoadThreads(int count);
+int          RM_FindImage(const char *name);
+int          RM_FindSound(const char *name);
+unsigned int RM_SetBudget(unsigned int bytes);
+void         RM_GetMemory(RM_Memory *mem);
+int          RM_GetTopConsumers(RM_Consumer *top, int max);
 
 
 #define NUM_SHELF_SETS            10
@@ -6,17 +6,109 @@
 //  This class uses the GU to draw graphics to the screen.  It is mainly used 
 //  to draw the Background to the screen, and gives quite a performance boost
 //  when doing so.
+//
+//  The VRAM after the 2 screen buffers is managed by a heap, so images can
+//  be put in VRAM and freed again (SCE_VramAlloc/SCE_VramFree).  The heap
+//  keeps its block records in system RAM, VRAM only holds pixels.  Free 
+//  blocks are kept in lists by size class (powers of 2) and merged with 
+//  free neighbours when they are freed.  Off the PSP a buffer stands in 
+//  for VRAM.
+//
+//  Drawing can be recorded in a command list (SCE_CmdList) & carried out 
+//  later by 1 flush.  Copies that go in a row are sent to the GU as 1 display
+//  list, blits with a colorkey or alpha & fills are done by SDL in between.
+//  Off the PSP copies are done with memcpy, so a flush gives the same result
+//  everywhere.  Sprites record into the frame list with SCE_Blit, main 
+//  flushes it once all sprites are drawn.
+//
+//  16 bit blits between surfaces of the same format, with or without a 
+//  colorkey, are done by a blitter of our own instead of SDL.  It tests 
+//  the 2 pixels of a 32 bit word against the colorkey with a few integer
+//  ops, & copies rows with no colorkey with memcpy.
 //-----------------------------------------------------------------------------
 
+#include <string.h>
 #include <pspgu.h>
 #include "sce_graphics.h"
 #include "zip_manager.h"
 
+#define VRAM_SIZE         0x200000              // 2 meg of VRAM
+#define VRAM_SCREEN_BYTES ((512 * 272 * 2) * 2) // the 2 screen buffers
+#define VRAM_ALIGN        16                    // for sceGuCopyImage
+#define VRAM_CLASSES      18    // class n holds blocks of 16 << n bytes & up
+#define MAX_VRAM_BLOCKS   128
+#define VRAM_HASH_BITS    7     // allocated blocks are found by offset
+#define VRAM_HASH_SIZE    (1 << VRAM_HASH_BITS)
+#ifdef MM_PROFILE
+#define PROFILE_VRAM_OPS  4096
+#define PROFILE_VRAM_LIVE 64
+#define PROFILE_CMD_PASSES 20
+#define PROFILE_CMD_SPRITES 100
+#define PROFILE_BLIT_PASSES 20
+#define PROFILE_BLIT_SPRITES 50
+#endif
+
+// Word the colorkey blitter tests pixels in, 1 pixel per 16 bits
+typedef Uint32 KeyWord;
+#define KEY_ONES    0x00010001U
+#define KEY_PIXELS  2
+
+// A block of the VRAM heap, either allocated or free
+typedef struct SceVramBlock
+{
+  unsigned int offset;
+  unsigned int size;
+  int          free;
+  int          prev;        // neighbours in address order, -1 for none
+  int          next;
+  int          prevFree;    // neighbours in free list of size class
+  int          nextFree;
+  int          nextHash;    // next allocated block in the same hash bucket
+} SceVramBlock;
+
+typedef struct SceVramHeap
+{
+  unsigned int  size;
+  SceVramBlock  blocks[MAX_VRAM_BLOCKS];
+  int           unused;                  // block records not in use
+  int           freeLists[VRAM_CLASSES];
+  int           allocated[VRAM_HASH_SIZE]; // allocated blocks, by HashOffset
+  SCE_VramStats stats;
+} SceVramHeap;
 
 // private data
-static int _vramBase;
-static int _vRamOffset;
-static SDL_Surface *_scr;
+static unsigned char *_vramBase;
+static SceVramHeap   _vram;
+static SDL_Surface   *_scr;
+static SCE_CmdList   _frame;   // drawn by sprites, flushed by main
+#ifndef __psp__
+static unsigned char _vramBuffer[VRAM_SIZE] __attribute__((aligned(16)));
+#endif
+
+static void HeapInit(SceVramHeap *h, unsigned int size);
+static int  HeapAlloc(SceVramHeap *h, unsigned int size);
+static int  HeapFree(SceVramHeap *h, unsigned int offset);
+static void HeapGetStats(SceVramHeap *h, SCE_VramStats *stats);
+static int  NewBlock(SceVramHeap *h);
+static void LinkFree(SceVramHeap *h, int b);
+static void UnlinkFree(SceVramHeap *h, int b);
+static void MergeNext(SceVramHeap *h, int b);
+static int  SizeClass(unsigned int size);
+static int  HashOffset(unsigned int offset);
+static SceCommand *AddCommand(SCE_CmdList *l, int type, SDL_Surface *img, 
+                              SDL_Rect *src, SDL_Rect *dst);
+static int  ClipCommand(SDL_Surface *target, SDL_Surface *img, SDL_Rect *src,
+                        SDL_Rect *dst, SceCommand *c);
+static int  CanKeyBlit(SDL_Surface *img, SDL_Surface *target);
+static void KeyBlit(SceCommand *c, SDL_Surface *target);
+static void KeyRow(Uint16 *d, const Uint16 *s, int w, Uint16 key, 
+                   Uint16 mask);
+#ifndef __psp__
+static void CopyRect(SceCommand *c, SDL_Surface *target);
+#endif
+#ifdef MM_PROFILE
+static int  CheckHeap(SceVramHeap *h);
+#endif
 
 //------------------------------------------------------------------------------
 // Name:     SCE_Init
@@ -31,12 +123,78 @@ void SCE_Init()
   // Set global pointer to screen
   _scr = MM_GetScreenPtr();
   
-  // get the address of video memory
-  _vramBase   = (void *)sceGeEdramGetAddr();
+  // get the address of video memory, the heap starts after the 2 full 
+  // screen buffers used for drawing data to the screen
+#ifdef __psp__
+  _vramBase = (unsigned char *) sceGeEdramGetAddr() + VRAM_SCREEN_BYTES;
+#else
+  _vramBase = _vramBuffer + VRAM_SCREEN_BYTES;
+#endif
+  HeapInit(&_vram, VRAM_SIZE - VRAM_SCREEN_BYTES);
+  SCE_ListStart(&_frame, _scr);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_VramAlloc
+// Summary:  Allocates a block of VRAM
+// Inputs:   Size in bytes
+// Outputs:  None
+// Returns:  Pointer to block (16 byte alligned), 0 if there is no free block
+//           big enough
+// Cautions: None
+//------------------------------------------------------------------------------
+void *SCE_VramAlloc(unsigned int size)
+{
+  int offset = HeapAlloc(&_vram, size);
   
-  // set the initial offset to start after the 2 full screen buffers used
-  // for drawing data to the screen
-  _vRamOffset = (512 * 272 * 2) * 2;
+  if (offset < 0)
+    return(0);
+  return(_vramBase + offset);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_VramFree
+// Summary:  Frees a block of VRAM allocated by SCE_VramAlloc
+// Inputs:   Pointer to block (may be 0)
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void SCE_VramFree(void *ptr)
+{
+  if (ptr == 0)
+    return;
+  if (HeapFree(&_vram, (unsigned char *) ptr - _vramBase) < 0)
+    EH_Error(EH_WARN, "SCE_VramFree - Not a VRAM block: %p\n", ptr);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_FreeVramImage
+// Summary:  Frees an image loaded into VRAM and the VRAM holding its pixels
+// Inputs:   Image returned by SCE_LoadBackground1 or SCE_LoadVramImage
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void SCE_FreeVramImage(SDL_Surface *img)
+{
+  if (img == 0)
+    return;
+  SCE_VramFree(img->pixels);
+  SDL_FreeSurface(img);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_GetVramStats
+// Summary:  Gets the state of the VRAM heap
+// Inputs:   None
+// Outputs:  stats - VRAM heap statistics
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void SCE_GetVramStats(SCE_VramStats *stats)
+{
+  HeapGetStats(&_vram, stats);
 }
 
 //------------------------------------------------------------------------------
@@ -57,6 +215,241 @@ void SCE_BlitSurface(SDL_Surface* img, SDL_Rect *src,
   sceGuSync(0,0);
 }
 
+//------------------------------------------------------------------------------
+// Name:     SCE_ListStart
+// Summary:  Empties a command list & sets the surface it draws to
+// Inputs:   1. l - command list
+//           2. target - surface the list draws to
+// Outputs:  None
+// Returns:  None
+// Cautions: Must be called before a list is used, commands allready recorded
+//           are dropped
+//------------------------------------------------------------------------------
+void SCE_ListStart(SCE_CmdList *l, SDL_Surface *target)
+{
+  l->count  = 0;
+  l->target = target;
+  memset(&l->frame, 0, sizeof(SCE_CmdStats));
+  memset(&l->total, 0, sizeof(SCE_CmdStats));
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_ListBlit
+// Summary:  Records a blit, drawn by SDL_BlitSurface when the list is flushed
+// Inputs:   1. l - command list
+//           2. img - image to draw
+//           3. src - part of image to draw, 0 for all of it
+//           4. dst - where to draw it (only x & y are used), 0 for 0,0
+// Outputs:  None
+// Returns:  0
+// Cautions: Image is drawn with the colorkey & alpha it has at flush time
+//------------------------------------------------------------------------------
+int SCE_ListBlit(SCE_CmdList *l, SDL_Surface *img, SDL_Rect *src, 
+                 SDL_Rect *dst)
+{
+  AddCommand(l, SCE_CMD_BLIT, img, src, dst);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_ListCopy
+// Summary:  Records a copy, done by the GU when the list is flushed.  Pixels
+//           are copied as is, no colorkey or alpha
+// Inputs:   1. l - command list
+//           2. img - image to copy from
+//           3. src - part of image to copy, 0 for all of it
+//           4. dst - where to copy it (only x & y are used), 0 for 0,0
+// Outputs:  None
+// Returns:  0
+// Cautions: Image & target must be 5551 images the GU can copy, like those 
+//           loaded by SCE_LoadBackground1.  Rows of the image are taken to
+//           be img->w pixels apart, whatever its pitch says.
+//------------------------------------------------------------------------------
+int SCE_ListCopy(SCE_CmdList *l, SDL_Surface *img, SDL_Rect *src, 
+                 SDL_Rect *dst)
+{
+  AddCommand(l, SCE_CMD_COPY, img, src, dst);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_ListFill
+// Summary:  Records a fill, done by SDL_FillRect when the list is flushed
+// Inputs:   1. l - command list
+//           2. dst - area to fill, 0 for the whole target
+//           3. color - color to fill with (format of target)
+// Outputs:  None
+// Returns:  0
+// Cautions: None
+//------------------------------------------------------------------------------
+int SCE_ListFill(SCE_CmdList *l, SDL_Rect *dst, Uint32 color)
+{
+  SceCommand *c = AddCommand(l, SCE_CMD_FILL, 0, 0, dst);
+  
+  if (c)
+    c->color = color;
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_ListFlush
+// Summary:  Carries out the commands recorded in a list, in the order they 
+//           were recorded, & empties the list
+// Inputs:   Command list
+// Outputs:  None
+// Returns:  None
+// Cautions: On the PSP the GU is finished with before SDL draws anything, so
+//           commands overlap the way they would if they were drawn 1 by 1
+//------------------------------------------------------------------------------
+void SCE_ListFlush(SCE_CmdList *l)
+{
+  SceCommand *c;
+  unsigned int start = MM_GetMicroSeconds();
+  int guOpen         = 0;
+  int x;
+  
+  memset(&l->frame, 0, sizeof(SCE_CmdStats));
+  for (x=0; x < l->count; x++)
+  {
+    c = &l->cmds[x];
+    if (c->type == SCE_CMD_COPY)
+    {
+#ifdef __psp__
+      // copies in a row go in the same display list
+      if (!guOpen)
+      {
+        sceGuStart(GU_DIRECT, l->guList);
+        guOpen = 1;
+        l->frame.guLists++;
+      }
+      sceGuCopyImage(GU_PSM_5551, c->src.x, c->src.y, c->src.w, c->src.h, 
+                     c->img->w, c->img->pixels, c->dst.x, c->dst.y, 
+                     l->target->pitch / 2, l->target->pixels);
+#else
+      CopyRect(c, l->target);
+#endif
+      l->frame.copies++;
+    }
+    else
+    {
+      // SDL must not draw until the GU is done with what is under it
+      if (guOpen)
+      {
+        sceGuFinish();
+        sceGuSync(0,0);
+        guOpen = 0;
+      }
+      if (c->type == SCE_CMD_BLIT && CanKeyBlit(c->img, l->target))
+      {
+        KeyBlit(c, l->target);
+        l->frame.keyBlits++;
+      }
+      else if (c->type == SCE_CMD_BLIT)
+      {
+        SDL_BlitSurface(c->img, &c->src, l->target, &c->dst);
+        l->frame.blits++;
+      }
+      else
+      {
+        SDL_FillRect(l->target, &c->dst, c->color);
+        l->frame.fills++;
+      }
+    }
+    l->frame.pixels += c->dst.w * c->dst.h;
+  }
+  if (guOpen)
+  {
+    sceGuFinish();
+    sceGuSync(0,0);
+  }
+  
+  l->frame.flushes   = 1;
+  l->frame.commands  = l->count;
+  l->frame.flushUs   = MM_GetMicroSeconds() - start;
+  l->total.flushes  += 1;
+  l->total.commands += l->frame.commands;
+  l->total.blits    += l->frame.blits;
+  l->total.keyBlits += l->frame.keyBlits;
+  l->total.copies   += l->frame.copies;
+  l->total.fills    += l->frame.fills;
+  l->total.pixels   += l->frame.pixels;
+  l->total.guLists  += l->frame.guLists;
+  l->total.flushUs  += l->frame.flushUs;
+  l->count           = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_Blit
+// Summary:  Records a blit to the screen in the frame list, the way sprites
+//           are drawn
+// Inputs:   1. img - image to draw
+//           2. src - part of image to draw, 0 for all of it
+//           3. dst - where to draw it on screen (only x & y are used)
+// Outputs:  None
+// Returns:  0
+// Cautions: Nothing is on screen until SCE_FlushFrame is called
+//------------------------------------------------------------------------------
+int SCE_Blit(SDL_Surface *img, SDL_Rect *src, SDL_Rect *dst)
+{
+  AddCommand(&_frame, SCE_CMD_BLIT, img, src, dst);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_KeyBlit
+// Summary:  Draws an image with the 16 bit colorkey blitter, right away
+// Inputs:   1. img - image to draw
+//           2. src - part of image to draw, 0 for all of it
+//           3. target - surface to draw to
+//           4. dst - where to draw it (only x & y are used), 0 for 0,0
+// Outputs:  None
+// Returns:  0 on success, -1 if the blitter cannot draw this image to this
+//           target (use SDL_BlitSurface)
+// Cautions: Clips like SDL_BlitSurface, the pixels drawn are the same
+//------------------------------------------------------------------------------
+int SCE_KeyBlit(SDL_Surface *img, SDL_Rect *src, SDL_Surface *target,
+                SDL_Rect *dst)
+{
+  SceCommand c;
+  
+  if (!CanKeyBlit(img, target))
+    return(-1);
+  c.img = img;
+  if (ClipCommand(target, img, src, dst, &c))
+    KeyBlit(&c, target);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_FlushFrame
+// Summary:  Draws everything recorded in the frame list to the screen
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Only call from the thread that draws the sprites
+//------------------------------------------------------------------------------
+void SCE_FlushFrame()
+{
+  SCE_ListFlush(&_frame);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_GetFrameStats
+// Summary:  Gets the work done flushing the frame list
+// Inputs:   None
+// Outputs:  1. frame - work done by the last flush (may be 0)
+//           2. total - work done by all flushes (may be 0)
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void SCE_GetFrameStats(SCE_CmdStats *frame, SCE_CmdStats *total)
+{
+  if (frame)
+    *frame = _frame.frame;
+  if (total)
+    *total = _frame.total;
+}
+
 // NOTES: This function loads the follwoing images in a single file:
 // bg1.bmp = walk_ceiling & loop_image. It also loads the 7 individual
 // files rf1.bmp - rf7.bmp. The width and height of the 
@@ -89,43 +482,29 @@ SDL_Surface* SCE_LoadBackground1(const char *file)
   // verify image loaded
   if (tmp)
   {
-    // Convert image to screen format
-    sdlImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE);  
+    // Convert image to screen format (baked images allready are)
+    if (MM_IsScreenFormat(tmp))
+      sdlImg = tmp;
+    else
+      sdlImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE);  
     
     // get size in bytes of entire image 
     // image height * image width * 2 (for 2 bytes per pixel)
     imgSize = (sdlImg->w * sdlImg->h)*2;
     
-    // Ensure we do not exceed our 2 meg of VRAM, as long as this function
-    // is called before SCE_LoadVramImage, this should never be a problem
-    if ((_vRamOffset + imgSize) < 0x200000)
+    // Images printed using SCE function must be 16 byte alligned in memory,
+    // the VRAM heap allways hands out 16 byte alligned blocks
+    vImgData = SCE_VramAlloc(imgSize);
+    if (vImgData)
     {
-      // Set our image data pointer to the correct area of VRAM
-      vImgData = (void *) (_vramBase + _vRamOffset);
-     
       // Copy the image into VRAM
       memcpy(vImgData, sdlImg->pixels, imgSize);
-      
-      // increment the offset into VRAM to include the memory we just used up
-      _vRamOffset += imgSize;
-      
-      // Images printed using SCE function must be 16 byte alligned in memory.
-      // The image passed in should have had a w/h that was a power of 2.  
-      // Thus, the new VRAM offset after accounting for above image should be
-      // on a 16 byte boundry.  If it is not, error as a precaution
-      int byteAllign16  = _vRamOffset%16;
-      if (byteAllign16 > 0)
-      {
-        EH_Error(EH_SEVERE, 
-        "SCE_LoadBackground1 - Image not 16 byte alligned: %s, w=%i, h=%i, _vRamOffset=%i\n", 
-        file, sdlImg->w, sdlImg->h, _vRamOffset);
-      }
     }
     else
     {
       EH_Error(EH_SEVERE, 
-      "SCE_LoadBackground1 - Not enough free VRAM: Image %s, w=%i, h=%i, _vRamOffset=%i\n", 
-      file, sdlImg->w, sdlImg->h, _vRamOffset);
+      "SCE_LoadBackground1 - Not enough free VRAM: Image %s, w=%i, h=%i, used=%u\n", 
+      file, sdlImg->w, sdlImg->h, _vram.stats.used);
     }
   
     // Create an SDL surface using the image data generated above
@@ -134,8 +513,9 @@ SDL_Surface* SCE_LoadBackground1(const char *file)
            _scr->format->Rmask, _scr->format->Gmask, 
            _scr->format->Bmask, _scr->format->Amask);
     
+    if (sdlImg != tmp)
+      SDL_FreeSurface(sdlImg);
     SDL_FreeSurface(tmp);  
-    SDL_FreeSurface(sdlImg);
   }
   return(vImg);
 }
@@ -169,8 +549,11 @@ SDL_Surface* SCE_LoadBackground2(const char *file)
   // verify image loaded
   if (tmp)
   {
-    // convert image to screen format
-    sdlImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE);
+    // convert image to screen format (baked images allready are)
+    if (MM_IsScreenFormat(tmp))
+      sdlImg = tmp;
+    else
+      sdlImg = SDL_ConvertSurface(tmp, _scr->format, SDL_SWSURFACE);
     
     // get size in bytes of entire image 
     // image height * image width * 2 (for 2 bytes per pixel)
@@ -189,17 +572,17 @@ SDL_Surface* SCE_LoadBackground2(const char *file)
              sdlImg->format->Bmask, sdlImg->format->Amask);
     
     // free temporary SDL surfaces
+    if (sdlImg != tmp)
+      SDL_FreeSurface(sdlImg);
     SDL_FreeSurface(tmp);  
-    SDL_FreeSurface(sdlImg);
   }
   
   // return newly created image data
   return(retImg);
 }
 
-// This function should only be called AFTER SCE_LoadBackground1 is called.
-// This function uses the remaining free VRAM to create SDL surfaces for the
-// given images.  
+// This function uses free VRAM to create SDL surfaces for the given images.
+// Free them with SCE_FreeVramImage.
 //------------------------------------------------------------------------------
 // Name:     SCE_LoadVramImage
 // Summary:  Loads the specified image into VRAM assuming there is enough
@@ -249,12 +632,11 @@ SDL_Surface* SCE_LoadVramImage(const char *file,
     // Get the total size in bytes of the current image
     imgSize = (sdlImg->w * sdlImg->h) * bytesPerPixel;
     
-    // verify enough free vram exists to hold image
-    if ((_vRamOffset + imgSize) < 0x200000)
+    // verify enough free vram exists to hold image (and the extra row
+    // copied below)
+    vImgData = SCE_VramAlloc(imgSize + (sdlImg->w*2));
+    if (vImgData)
     {
-      // Set our image data pointer to the correct area of VRAM
-      vImgData = (void *) (_vramBase + _vRamOffset);
-     
       // Copy the image into VRAM
       // For some reason the bottom row of pixels is not being copiied.
       // copying 1 extra row of pixels seems to work for some reason.
@@ -266,16 +648,13 @@ SDL_Surface* SCE_LoadVramImage(const char *file,
       //{
       //  dst[x] = src[x];  
       //}
-      
-      // increment the offset into VRAM to include the memory we just used up
-      _vRamOffset  += imgSize;
     }
     // Error if enough free VRAM was not present
     else
     {
       EH_Error(EH_SEVERE, 
-      "SCE_LoadVramImage - Not enough free VRAM: Image %s, w=%i, h=%i, _vRamOffset=%i\n", 
-      file, sdlImg->w, sdlImg->h, _vRamOffset);
+      "SCE_LoadVramImage - Not enough free VRAM: Image %s, w=%i, h=%i, used=%u\n", 
+      file, sdlImg->w, sdlImg->h, _vram.stats.used);
     }
     
     // Create a new SDL surface using the pixel data created above.  
@@ -300,3 +679,898 @@ SDL_Surface* SCE_LoadVramImage(const char *file,
   return(retImg);
 }
 
+//------------------------------------------------------------------------------
+// Name:     HeapInit
+// Summary:  Sets up a heap as 1 free block
+// Inputs:   1. h - heap
+//           2. size - bytes managed by the heap
+// Outputs:  None
+// Returns:  None
+// Cautions: The heap only hands out offsets, it never touches the memory
+//------------------------------------------------------------------------------
+void HeapInit(SceVramHeap *h, unsigned int size)
+{
+  int b;
+  
+  memset(h, 0, sizeof(SceVramHeap));
+  h->size       = size & ~(VRAM_ALIGN - 1);
+  h->stats.size = h->size;
+  for (b=0; b < VRAM_CLASSES; b++)
+    h->freeLists[b] = -1;
+  for (b=0; b < VRAM_HASH_SIZE; b++)
+    h->allocated[b] = -1;
+    
+  // every record but the first is unused, chained through next
+  for (b=1; b < MAX_VRAM_BLOCKS; b++)
+    h->blocks[b].next = (b + 1 < MAX_VRAM_BLOCKS) ? b + 1 : -1;
+  h->unused = 1;
+  
+  h->blocks[0].offset = 0;
+  h->blocks[0].size   = h->size;
+  h->blocks[0].prev   = -1;
+  h->blocks[0].next   = -1;
+  LinkFree(h, 0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     HeapAlloc
+// Summary:  Allocates a block, the first big enough block in the size class 
+//           of the request is used, else any block of a larger class
+// Inputs:   1. h - heap
+//           2. size - bytes wanted
+// Outputs:  None
+// Returns:  Offset of block, -1 if no free block is big enough
+// Cautions: Blocks are rounded up to VRAM_ALIGN bytes.  If there are no 
+//           records left for the rest of a block, the whole block is used.
+//------------------------------------------------------------------------------
+int HeapAlloc(SceVramHeap *h, unsigned int size)
+{
+  int c, b, rest;
+  
+  size = (size + VRAM_ALIGN - 1) & ~(VRAM_ALIGN - 1);
+  if (size == 0 || size > h->size)
+  {
+    h->stats.failures++;
+    return(-1);
+  }
+  
+  b = -1;
+  for (c=SizeClass(size); c < VRAM_CLASSES && b < 0; c++)
+    for (b=h->freeLists[c]; b >= 0 && h->blocks[b].size < size; )
+      b = h->blocks[b].nextFree;
+  if (b < 0)
+  {
+    h->stats.failures++;
+    return(-1);
+  }
+  
+  UnlinkFree(h, b);
+  if (h->blocks[b].size > size && (rest = NewBlock(h)) >= 0)
+  {
+    h->blocks[rest].offset = h->blocks[b].offset + size;
+    h->blocks[rest].size   = h->blocks[b].size - size;
+    h->blocks[rest].prev   = b;
+    h->blocks[rest].next   = h->blocks[b].next;
+    if (h->blocks[b].next >= 0)
+      h->blocks[h->blocks[b].next].prev = rest;
+    h->blocks[b].next = rest;
+    h->blocks[b].size = size;
+    LinkFree(h, rest);
+  }
+  
+  c = HashOffset(h->blocks[b].offset);
+  h->blocks[b].nextHash = h->allocated[c];
+  h->allocated[c]       = b;
+  
+  h->stats.used += h->blocks[b].size;
+  h->stats.allocs++;
+  return(h->blocks[b].offset);
+}
+
+//------------------------------------------------------------------------------
+// Name:     HeapFree
+// Summary:  Frees a block and merges it with the free blocks next to it
+// Inputs:   1. h - heap
+//           2. offset - offset of block
+// Outputs:  None
+// Returns:  0 on success, -1 if no block is allocated at offset
+// Cautions: The block is found through the hash of allocated blocks, not by
+//           walking the heap
+//------------------------------------------------------------------------------
+int HeapFree(SceVramHeap *h, unsigned int offset)
+{
+  int *p;
+  int b, prev;
+  
+  for (p=&h->allocated[HashOffset(offset)]; 
+       *p >= 0 && h->blocks[*p].offset != offset; p=&h->blocks[*p].nextHash)
+    ;
+  if (*p < 0)
+    return(-1);
+  b  = *p;
+  *p = h->blocks[b].nextHash;
+    
+  h->stats.used -= h->blocks[b].size;
+  h->stats.frees++;
+  
+  prev = h->blocks[b].prev;
+  if (h->blocks[b].next >= 0 && h->blocks[h->blocks[b].next].free)
+  {
+    UnlinkFree(h, h->blocks[b].next);
+    MergeNext(h, b);
+  }
+  if (prev >= 0 && h->blocks[prev].free)
+  {
+    UnlinkFree(h, prev);
+    MergeNext(h, prev);
+    b = prev;
+  }
+  LinkFree(h, b);
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     HeapGetStats
+// Summary:  Gets a heap's statistics, working out how fragmented it is
+// Inputs:   Heap
+// Outputs:  stats - heap statistics
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void HeapGetStats(SceVramHeap *h, SCE_VramStats *stats)
+{
+  int b;
+  
+  *stats             = h->stats;
+  stats->largestFree = 0;
+  stats->freeBlocks  = 0;
+  stats->blocks      = 0;
+  for (b=0; b >= 0; b = h->blocks[b].next)
+  {
+    stats->blocks++;
+    if (h->blocks[b].free)
+    {
+      stats->freeBlocks++;
+      if (h->blocks[b].size > stats->largestFree)
+        stats->largestFree = h->blocks[b].size;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     NewBlock
+// Summary:  Takes a block record off the unused list
+// Inputs:   Heap
+// Outputs:  None
+// Returns:  Index of record, -1 if they are all in use
+// Cautions: None
+//------------------------------------------------------------------------------
+int NewBlock(SceVramHeap *h)
+{
+  int b = h->unused;
+  
+  if (b >= 0)
+    h->unused = h->blocks[b].next;
+  return(b);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LinkFree
+// Summary:  Marks a block free and puts it at the head of the free list of 
+//           its size class
+// Inputs:   1. h - heap
+//           2. b - block
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void LinkFree(SceVramHeap *h, int b)
+{
+  int c = SizeClass(h->blocks[b].size);
+  
+  h->blocks[b].free     = 1;
+  h->blocks[b].prevFree = -1;
+  h->blocks[b].nextFree = h->freeLists[c];
+  if (h->freeLists[c] >= 0)
+    h->blocks[h->freeLists[c]].prevFree = b;
+  h->freeLists[c] = b;
+}
+
+//------------------------------------------------------------------------------
+// Name:     UnlinkFree
+// Summary:  Takes a free block off its free list and marks it allocated
+// Inputs:   1. h - heap
+//           2. b - block
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void UnlinkFree(SceVramHeap *h, int b)
+{
+  SceVramBlock *k = &h->blocks[b];
+  
+  if (k->prevFree >= 0)
+    h->blocks[k->prevFree].nextFree = k->nextFree;
+  else
+    h->freeLists[SizeClass(k->size)] = k->nextFree;
+  if (k->nextFree >= 0)
+    h->blocks[k->nextFree].prevFree = k->prevFree;
+  k->free = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name:     MergeNext
+// Summary:  Merges a block with the (free) block after it, the record of the
+//           block after it goes back on the unused list
+// Inputs:   1. h - heap
+//           2. b - block
+// Outputs:  None
+// Returns:  None
+// Cautions: Neither block may be on a free list
+//------------------------------------------------------------------------------
+void MergeNext(SceVramHeap *h, int b)
+{
+  int n = h->blocks[b].next;
+  
+  h->blocks[b].size += h->blocks[n].size;
+  h->blocks[b].next  = h->blocks[n].next;
+  if (h->blocks[n].next >= 0)
+    h->blocks[h->blocks[n].next].prev = b;
+  h->blocks[n].next = h->unused;
+  h->unused         = n;
+  h->stats.merges++;
+}
+
+//------------------------------------------------------------------------------
+// Name:     SizeClass
+// Summary:  Finds the size class of a block
+// Inputs:   Size of block
+// Outputs:  None
+// Returns:  Size class, the highest bit set in size / VRAM_ALIGN
+// Cautions: None
+//------------------------------------------------------------------------------
+int SizeClass(unsigned int size)
+{
+  int c = 0;
+  
+  for (size /= VRAM_ALIGN; size > 1 && c < VRAM_CLASSES - 1; size >>= 1)
+    c++;
+  return(c);
+}
+
+//------------------------------------------------------------------------------
+// Name:     HashOffset
+// Summary:  Finds the bucket of the allocated blocks a block is kept in
+// Inputs:   Offset of block
+// Outputs:  None
+// Returns:  Bucket, 0 to VRAM_HASH_SIZE - 1
+// Cautions: Blocks are often the same size, so offsets are scrambled 
+//           (Fibonacci hashing) to spread them over the buckets
+//------------------------------------------------------------------------------
+int HashOffset(unsigned int offset)
+{
+  Uint32 x = (offset / VRAM_ALIGN) * 2654435761U;
+  
+  return((int) (x >> (32 - VRAM_HASH_BITS)));
+}
+
+//------------------------------------------------------------------------------
+// Name:     AddCommand
+// Summary:  Clips a command to its list's target & adds it to the list
+// Inputs:   1. l - command list
+//           2. type - SCE_CMD_BLIT, SCE_CMD_COPY or SCE_CMD_FILL
+//           3. img - image to draw, 0 for a fill
+//           4. src - part of image to draw, 0 for all of it
+//           5. dst - where to draw, for a fill the area to fill
+// Outputs:  None
+// Returns:  The command added, 0 if nothing of it is on the target
+// Cautions: A full list is flushed to make room
+//------------------------------------------------------------------------------
+SceCommand *AddCommand(SCE_CmdList *l, int type, SDL_Surface *img, 
+                       SDL_Rect *src, SDL_Rect *dst)
+{
+  SceCommand *c;
+  
+  if (l->count == SCE_MAX_COMMANDS)
+    SCE_ListFlush(l);
+    
+  c = &l->cmds[l->count];
+  if (!ClipCommand(l->target, img, src, dst, c))
+    return(0);
+  c->type  = type;
+  c->img   = img;
+  c->color = 0;
+  l->count++;
+  return(c);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ClipCommand
+// Summary:  Clips the area a command draws to the image it draws from & the
+//           target's clip rectangle, the same way SDL_BlitSurface does
+// Inputs:   1. target - surface drawn to
+//           2. img - image to draw, 0 for a fill
+//           3. src - part of image to draw, 0 for all of it
+//           4. dst - where to draw, for a fill the area to fill (0 for all)
+// Outputs:  c - src & dst of command, both the clipped size
+// Returns:  1 if some of it is on the target, 0 if none is
+// Cautions: None
+//------------------------------------------------------------------------------
+int ClipCommand(SDL_Surface *target, SDL_Surface *img, SDL_Rect *src,
+                SDL_Rect *dst, SceCommand *c)
+{
+  SDL_Rect *clip = &target->clip_rect;
+  int sx = 0, sy = 0;
+  int dx, dy, w, h, d;
+  
+  if (img)
+  {
+    dx = dst ? dst->x : 0;
+    dy = dst ? dst->y : 0;
+    if (src)
+    {
+      sx = src->x;
+      sy = src->y;
+      w  = src->w;
+      h  = src->h;
+    }
+    else
+    {
+      w  = img->w;
+      h  = img->h;
+    }
+    
+    // source must be inside the image, what is cut off the left or top moves
+    // the destination
+    if (sx < 0)
+    {
+      w  += sx;
+      dx -= sx;
+      sx  = 0;
+    }
+    if (sy < 0)
+    {
+      h  += sy;
+      dy -= sy;
+      sy  = 0;
+    }
+    if (w > img->w - sx)
+      w = img->w - sx;
+    if (h > img->h - sy)
+      h = img->h - sy;
+  }
+  else
+  {
+    dx = dst ? dst->x : clip->x;
+    dy = dst ? dst->y : clip->y;
+    w  = dst ? dst->w : clip->w;
+    h  = dst ? dst->h : clip->h;
+  }
+  
+  // destination must be inside the clip rectangle
+  d = clip->x - dx;
+  if (d > 0)
+  {
+    w  -= d;
+    dx += d;
+    sx += d;
+  }
+  d = dx + w - (clip->x + clip->w);
+  if (d > 0)
+    w -= d;
+  d = clip->y - dy;
+  if (d > 0)
+  {
+    h  -= d;
+    dy += d;
+    sy += d;
+  }
+  d = dy + h - (clip->y + clip->h);
+  if (d > 0)
+    h -= d;
+    
+  if (w <= 0 || h <= 0)
+    return(0);
+  c->src.x = sx;
+  c->src.y = sy;
+  c->src.w = w;
+  c->src.h = h;
+  c->dst.x = dx;
+  c->dst.y = dy;
+  c->dst.w = w;
+  c->dst.h = h;
+  return(1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CanKeyBlit
+// Summary:  Checks if the colorkey blitter can draw an image to a surface
+// Inputs:   1. img - image to draw
+//           2. target - surface to draw to
+// Outputs:  None
+// Returns:  1 if it can, 0 if SDL must draw it
+// Cautions: None
+//------------------------------------------------------------------------------
+int CanKeyBlit(SDL_Surface *img, SDL_Surface *target)
+{
+  SDL_PixelFormat *a = img->format;
+  SDL_PixelFormat *b = target->format;
+  
+  // same 16 bit format, so pixels are copied as is, & nothing SDL would 
+  // have to blend or decode
+  return(a->BytesPerPixel == 2 && b->BytesPerPixel == 2 && 
+         a->Rmask == b->Rmask && a->Gmask == b->Gmask && 
+         a->Bmask == b->Bmask && a->Amask == b->Amask &&
+         (img->flags & (SDL_SRCALPHA | SDL_RLEACCEL)) == 0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     KeyBlit
+// Summary:  Does a blit command with the colorkey blitter
+// Inputs:   1. c - blit command (allready clipped)
+//           2. target - surface drawn to
+// Outputs:  None
+// Returns:  None
+// Cautions: CanKeyBlit must be true for the image & target.  Like SDL, the 
+//           alpha bit is ignored when pixels are tested against the colorkey
+//------------------------------------------------------------------------------
+void KeyBlit(SceCommand *c, SDL_Surface *target)
+{
+  SDL_Surface *img = c->img;
+  Uint16 mask      = ~img->format->Amask;
+  Uint16 key       = img->format->colorkey & mask;
+  Uint8 *s, *d;
+  int y;
+  
+  if (SDL_MUSTLOCK(target) && SDL_LockSurface(target) < 0)
+    return;
+    
+  s = (Uint8 *) img->pixels + c->src.y * img->pitch + c->src.x * 2;
+  d = (Uint8 *) target->pixels + c->dst.y * target->pitch + c->dst.x * 2;
+  if (img->flags & SDL_SRCCOLORKEY)
+  {
+    for (y=0; y < c->src.h; y++)
+    {
+      KeyRow((Uint16 *) d, (Uint16 *) s, c->src.w, key, mask);
+      s += img->pitch;
+      d += target->pitch;
+    }
+  }
+  else  // no colorkey, every pixel is drawn
+  {
+    for (y=0; y < c->src.h; y++)
+    {
+      memcpy(d, s, c->src.w * 2);
+      s += img->pitch;
+      d += target->pitch;
+    }
+  }
+  
+  if (SDL_MUSTLOCK(target))
+    SDL_UnlockSurface(target);
+}
+
+//------------------------------------------------------------------------------
+// Name:     KeyRow
+// Summary:  Draws 1 row of pixels, leaving out those that are the colorkey,
+//           2 pixels at a time
+// Inputs:   1. d - first pixel drawn to
+//           2. s - first pixel drawn
+//           3. w - number of pixels
+//           4. key - colorkey (& mask)
+//           5. mask - bits of a pixel tested against the colorkey
+// Outputs:  None
+// Returns:  None
+// Cautions: s & d need only be 2 byte alligned
+//------------------------------------------------------------------------------
+void KeyRow(Uint16 *d, const Uint16 *s, int w, Uint16 key, Uint16 mask)
+{
+  KeyWord keys  = key * KEY_ONES;
+  KeyWord masks = mask * KEY_ONES;
+  KeyWord low   = 0x7FFF * KEY_ONES;
+  KeyWord sw, dw, x, m;
+  
+  // 1 pixel at a time until d is on a word boundry
+  while (w > 0 && ((unsigned long) d % sizeof(KeyWord)))
+  {
+    if ((*s & mask) != key)
+      *d = *s;
+    d++;
+    s++;
+    w--;
+  }
+  
+  for (; w >= KEY_PIXELS; w -= KEY_PIXELS)
+  {
+    memcpy(&sw, s, sizeof(KeyWord));    // s may not be on a word boundry
+    
+    // x is 0 in the pixels that are the colorkey.  Adding 0x7FFF to the low
+    // 15 bits of a pixel carries into its top bit unless they are all 0, so
+    // the top bit of each pixel ends up set if the pixel is to be drawn. 
+    x = (sw ^ keys) & masks;
+    m = (((((x & low) + low) | x) >> 15) & KEY_ONES) * 0xFFFF;
+    if (m == (KeyWord) -1)
+    {
+      memcpy(d, &sw, sizeof(KeyWord));
+    }
+    else if (m)
+    {
+      memcpy(&dw, d, sizeof(KeyWord));
+      dw = (dw & ~m) | (sw & m);
+      memcpy(d, &dw, sizeof(KeyWord));
+    }
+    d += KEY_PIXELS;
+    s += KEY_PIXELS;
+  }
+  
+  for (; w > 0; w--)
+  {
+    if ((*s & mask) != key)
+      *d = *s;
+    d++;
+    s++;
+  }
+}
+
+#ifndef __psp__
+//------------------------------------------------------------------------------
+// Name:     CopyRect
+// Summary:  Does a copy command with memcpy, what the GU does on the PSP
+// Inputs:   1. c - copy command
+//           2. target - surface copied to
+// Outputs:  None
+// Returns:  None
+// Cautions: Image & target must have the same pixel format, rows of the 
+//           image are img->w pixels apart like they are for the GU
+//------------------------------------------------------------------------------
+void CopyRect(SceCommand *c, SDL_Surface *target)
+{
+  int bpp          = target->format->BytesPerPixel;
+  int pitch        = c->img->w * bpp;
+  unsigned char *s = (unsigned char *) c->img->pixels + 
+                     c->src.y * pitch + c->src.x * bpp;
+  unsigned char *d = (unsigned char *) target->pixels + 
+                     c->dst.y * target->pitch + c->dst.x * bpp;
+  int y;
+  
+  for (y=0; y < c->src.h; y++)
+  {
+    memcpy(d, s, c->src.w * bpp);
+    s += pitch;
+    d += target->pitch;
+  }
+}
+#endif
+
+#ifdef MM_PROFILE
+//------------------------------------------------------------------------------
+// Name:     SCE_ProfileVram
+// Summary:  Benchmark & self check, runs a level's worth of sprite sized 
+//           allocations and frees (kept to PROFILE_VRAM_LIVE at once) on a 
+//           heap the size of the free VRAM, and reports the time taken and 
+//           how fragmented the heap ended up
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Uses a heap of its own, the real VRAM heap is not touched
+//------------------------------------------------------------------------------
+void SCE_ProfileVram()
+{
+  static SceVramHeap heap;
+  SCE_VramStats stats;
+  int live[PROFILE_VRAM_LIVE];
+  unsigned int seed = 12345;
+  unsigned int start, size;
+  int bad = 0;
+  int x, slot;
+  
+  HeapInit(&heap, VRAM_SIZE - VRAM_SCREEN_BYTES);
+  for (x=0; x < PROFILE_VRAM_LIVE; x++)
+    live[x] = -1;
+    
+  start = MM_GetMicroSeconds();
+  for (x=0; x < PROFILE_VRAM_OPS; x++)
+  {
+    seed = seed * 1103515245 + 12345;
+    slot = (seed >> 16) % PROFILE_VRAM_LIVE;
+    if (live[slot] >= 0)
+    {
+      HeapFree(&heap, live[slot]);
+      live[slot] = -1;
+    }
+    else
+    {
+      // 16x16 to 128x128 sprites, 2 bytes per pixel
+      seed       = seed * 1103515245 + 12345;
+      size       = 16 + ((seed >> 16) % 113);
+      live[slot] = HeapAlloc(&heap, size * size * 2);
+    }
+  }
+  start = MM_GetMicroSeconds() - start;
+  
+  if (CheckHeap(&heap) < 0)
+    bad++;
+  for (x=0; x < PROFILE_VRAM_LIVE; x++)
+    if (live[x] >= 0)
+      HeapFree(&heap, live[x]);
+  HeapGetStats(&heap, &stats);
+  if (CheckHeap(&heap) < 0 || stats.used != 0 || stats.blocks != 1)
+    bad++;
+    
+  EH_Error(EH_DEBUG, "SCE VRAM heap %d ops: %uus, %u allocs %u failed, "
+           "%u merges%s\n", PROFILE_VRAM_OPS, start, stats.allocs,
+           stats.failures, stats.merges, bad ? ", CHECK FAILED" : "");
+  HeapGetStats(&_vram, &stats);
+  EH_Error(EH_DEBUG, "SCE VRAM %uK used of %uK, %u free blocks, largest "
+           "%uK\n", stats.used / 1024, stats.size / 1024, stats.freeBlocks,
+           stats.largestFree / 1024);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CheckHeap
+// Summary:  Checks that a heap's blocks cover it with no gaps or overlaps,
+//           that no 2 free blocks are next to each other, that every 
+//           free block is on the right free list, and every allocated block
+//           in the right hash bucket
+// Inputs:   Heap
+// Outputs:  None
+// Returns:  0 if the heap is sound, -1 if not
+// Cautions: None
+//------------------------------------------------------------------------------
+int CheckHeap(SceVramHeap *h)
+{
+  unsigned int offset = 0;
+  unsigned int used   = 0;
+  int freeBlocks      = 0;
+  int listed          = 0;
+  int hashed          = 0;
+  int b, c;
+  
+  for (b=0; b >= 0; b = h->blocks[b].next)
+  {
+    if (h->blocks[b].offset != offset || h->blocks[b].offset % VRAM_ALIGN)
+      return(-1);
+    if (h->blocks[b].next >= 0 && h->blocks[h->blocks[b].next].prev != b)
+      return(-1);
+    if (h->blocks[b].free)
+    {
+      freeBlocks++;
+      if (h->blocks[b].next >= 0 && h->blocks[h->blocks[b].next].free)
+        return(-1);
+    }
+    else
+      used += h->blocks[b].size;
+    offset += h->blocks[b].size;
+  }
+  
+  for (c=0; c < VRAM_CLASSES; c++)
+  {
+    for (b=h->freeLists[c]; b >= 0; b = h->blocks[b].nextFree)
+    {
+      if (!h->blocks[b].free || SizeClass(h->blocks[b].size) != c)
+        return(-1);
+      listed++;
+    }
+  }
+  
+  for (c=0; c < VRAM_HASH_SIZE; c++)
+  {
+    for (b=h->allocated[c]; b >= 0; b = h->blocks[b].nextHash)
+    {
+      if (h->blocks[b].free || HashOffset(h->blocks[b].offset) != c)
+        return(-1);
+      hashed++;
+    }
+  }
+  
+  if (offset != h->size || used != h->stats.used || listed != freeBlocks)
+    return(-1);
+  for (b=0; b >= 0; b = h->blocks[b].next)
+    hashed -= !h->blocks[b].free;
+  if (hashed)
+    return(-1);
+  return(0);
+}
+//------------------------------------------------------------------------------
+// Name:     SCE_ProfileCommands
+// Summary:  Benchmark & self check, draws PROFILE_CMD_SPRITES colorkeyed 
+//           sprites (some partly off screen) over a cleared screen through a
+//           command list, & again 1 by 1 with SDL, then checks both give the
+//           same pixels & reports the time each took.  The sprite is an odd
+//           size & some of its pixels differ from the colorkey only in the 
+//           alpha bit, to check the colorkey blitter against SDL.
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Draws to surfaces of its own, the screen is not touched
+//------------------------------------------------------------------------------
+void SCE_ProfileCommands()
+{
+  static SCE_CmdList list;
+  SDL_PixelFormat *f = _scr->format;
+  SDL_Surface *sprite, *listDst, *sdlDst;
+  SDL_Rect dst[PROFILE_CMD_SPRITES], rect;
+  unsigned int seed     = 12345;
+  unsigned int listTime = 0;
+  unsigned int sdlTime  = 0;
+  unsigned int start;
+  Uint32 key;
+  int bad = 0;
+  int x, y, pass;
+  
+  sprite  = SDL_CreateRGBSurface(SDL_SWSURFACE, 37, 29, f->BitsPerPixel, 
+                                 f->Rmask, f->Gmask, f->Bmask, f->Amask);
+  listDst = SDL_CreateRGBSurface(SDL_SWSURFACE, _scr->w, _scr->h, 
+                                 f->BitsPerPixel, f->Rmask, f->Gmask, 
+                                 f->Bmask, f->Amask);
+  sdlDst  = SDL_CreateRGBSurface(SDL_SWSURFACE, _scr->w, _scr->h, 
+                                 f->BitsPerPixel, f->Rmask, f->Gmask, 
+                                 f->Bmask, f->Amask);
+  if (!sprite || !listDst || !sdlDst || f->BytesPerPixel != 2)
+  {
+    SDL_FreeSurface(sprite);
+    SDL_FreeSurface(listDst);
+    SDL_FreeSurface(sdlDst);
+    return;
+  }
+  
+  // random pixels, a quarter of them the colorkey (with either alpha bit)
+  key = SDL_MapRGB(sprite->format, 0xFF, 0x80, 0x80);
+  for (y=0; y < sprite->h; y++)
+  {
+    for (x=0; x < sprite->w; x++)
+    {
+      seed = seed * 1103515245 + 12345;
+      ((Uint16 *) ((Uint8 *) sprite->pixels + y * sprite->pitch))[x] = 
+        (seed >> 16) % 4 ? (seed >> 8) & 0xFFFF : 
+                           key ^ ((seed >> 20) & 1 ? f->Amask : 0);
+    }
+  }
+  SDL_SetColorKey(sprite, SDL_SRCCOLORKEY, key);
+  for (x=0; x < PROFILE_CMD_SPRITES; x++)
+  {
+    seed     = seed * 1103515245 + 12345;
+    dst[x].x = (int) ((seed >> 16) % (_scr->w + 48)) - 40;
+    seed     = seed * 1103515245 + 12345;
+    dst[x].y = (int) ((seed >> 16) % (_scr->h + 48)) - 40;
+  }
+  
+  SCE_ListStart(&list, listDst);
+  for (pass=0; pass < PROFILE_CMD_PASSES; pass++)
+  {
+    start = MM_GetMicroSeconds();
+    SCE_ListFill(&list, 0, 0);
+    for (x=0; x < PROFILE_CMD_SPRITES; x++)
+      SCE_ListBlit(&list, sprite, 0, &dst[x]);
+    SCE_ListFlush(&list);
+    listTime += MM_GetMicroSeconds() - start;
+    
+    start = MM_GetMicroSeconds();
+    SDL_FillRect(sdlDst, 0, 0);
+    for (x=0; x < PROFILE_CMD_SPRITES; x++)
+    {
+      rect = dst[x];
+      SDL_BlitSurface(sprite, 0, sdlDst, &rect);
+    }
+    sdlTime += MM_GetMicroSeconds() - start;
+  }
+  
+  for (y=0; y < _scr->h; y++)
+    if (memcmp((Uint8 *) listDst->pixels + y * listDst->pitch,
+               (Uint8 *) sdlDst->pixels + y * sdlDst->pitch, _scr->w * 2))
+      bad++;
+      
+  EH_Error(EH_DEBUG, "SCE command list %d blits: %uus, 1 by 1 %uus, %u "
+           "commands %u pixels a frame%s\n", PROFILE_CMD_SPRITES, 
+           listTime / PROFILE_CMD_PASSES, sdlTime / PROFILE_CMD_PASSES, 
+           list.frame.commands, list.frame.pixels, 
+           bad ? ", CHECK FAILED" : "");
+  SDL_FreeSurface(sprite);
+  SDL_FreeSurface(listDst);
+  SDL_FreeSurface(sdlDst);
+}
+
+//------------------------------------------------------------------------------
+// Name:     SCE_ProfileBlit
+// Summary:  Benchmark & self check of the colorkey blitter with a real 
+//           sprite, draws PROFILE_BLIT_SPRITES frames of it (some partly off
+//           screen) with the blitter & with SDL_BlitSurface, then checks 
+//           both give the same pixels & reports the pixels a second each
+//           drew
+// Inputs:   1. name - name of sprite to report
+//           2. img - sprite's image
+//           3. frames - number of frames in image, 1 above the other
+// Outputs:  None
+// Returns:  None
+// Cautions: Draws to surfaces of its own, the screen is not touched
+//------------------------------------------------------------------------------
+void SCE_ProfileBlit(const char *name, SDL_Surface *img, int frames)
+{
+  SDL_PixelFormat *f = _scr->format;
+  SDL_Surface *keyDst, *sdlDst;
+  SDL_Rect src[PROFILE_BLIT_SPRITES], dst[PROFILE_BLIT_SPRITES], rect;
+  SceCommand c;
+  unsigned int seed    = 12345;
+  unsigned int keyTime = 0;
+  unsigned int sdlTime = 0;
+  unsigned int pixels  = 0;
+  unsigned int start, keyRate, sdlRate;
+  int bad = 0;
+  int x, y, pass;
+  
+  if (!img || frames < 1)
+    return;
+  if (!CanKeyBlit(img, _scr))
+  {
+    EH_Error(EH_DEBUG, "SCE blit %s: drawn by SDL, not the colorkey "
+             "blitter\n", name);
+    return;
+  }
+  
+  keyDst = SDL_CreateRGBSurface(SDL_SWSURFACE, _scr->w, _scr->h, 
+                                f->BitsPerPixel, f->Rmask, f->Gmask, 
+                                f->Bmask, f->Amask);
+  sdlDst = SDL_CreateRGBSurface(SDL_SWSURFACE, _scr->w, _scr->h, 
+                                f->BitsPerPixel, f->Rmask, f->Gmask, 
+                                f->Bmask, f->Amask);
+  if (!keyDst || !sdlDst)
+  {
+    SDL_FreeSurface(keyDst);
+    SDL_FreeSurface(sdlDst);
+    return;
+  }
+  SDL_FillRect(keyDst, 0, 0);
+  SDL_FillRect(sdlDst, 0, 0);
+  
+  for (x=0; x < PROFILE_BLIT_SPRITES; x++)
+  {
+    src[x].x = 0;
+    src[x].w = img->w;
+    src[x].h = img->h / frames;
+    src[x].y = (x % frames) * src[x].h;
+    seed     = seed * 1103515245 + 12345;
+    dst[x].x = (int) ((seed >> 16) % (_scr->w + img->w)) - img->w / 2;
+    seed     = seed * 1103515245 + 12345;
+    dst[x].y = (int) ((seed >> 16) % (_scr->h + src[x].h)) - src[x].h / 2;
+  }
+  
+  for (pass=0; pass < PROFILE_BLIT_PASSES; pass++)
+  {
+    start = MM_GetMicroSeconds();
+    for (x=0; x < PROFILE_BLIT_SPRITES; x++)
+    {
+      c.img = img;
+      if (ClipCommand(keyDst, img, &src[x], &dst[x], &c))
+      {
+        KeyBlit(&c, keyDst);
+        pixels += c.dst.w * c.dst.h;
+      }
+    }
+    keyTime += MM_GetMicroSeconds() - start;
+    
+    start = MM_GetMicroSeconds();
+    for (x=0; x < PROFILE_BLIT_SPRITES; x++)
+    {
+      rect = dst[x];
+      SDL_BlitSurface(img, &src[x], sdlDst, &rect);
+    }
+    sdlTime += MM_GetMicroSeconds() - start;
+  }
+  
+  for (y=0; y < _scr->h; y++)
+    if (memcmp((Uint8 *) keyDst->pixels + y * keyDst->pitch,
+               (Uint8 *) sdlDst->pixels + y * sdlDst->pitch, _scr->w * 2))
+      bad++;
+  
+  // pixels a microsecond is millions of pixels a second
+  keyRate = keyTime ? pixels * 10 / keyTime : 0;
+  sdlRate = sdlTime ? pixels * 10 / sdlTime : 0;
+  EH_Error(EH_DEBUG, "SCE blit %s %dx%d: %u.%u Mpixels/s, SDL %u.%u "
+           "Mpixels/s%s\n", name, img->w, img->h / frames, keyRate / 10, 
+           keyRate % 10, sdlRate / 10, sdlRate % 10, 
+           bad ? ", CHECK FAILED" : "");
+  SDL_FreeSurface(keyDst);
+  SDL_FreeSurface(sdlDst);
+}
+
+#endif
@@ -5,15 +5,94 @@
 
 unsigned int __attribute__((aligned(16))) _SCEBgList[4096];
 
+#define SCE_MAX_COMMANDS    128   // commands a list holds before it flushes
+#define SCE_GU_LIST_WORDS   2048  // GU display list of a command list
+
+// State of the VRAM heap, see SCE_GetVramStats
+typedef struct SCE_VramStats
+{
+  unsigned int size;          // bytes managed by the heap
+  unsigned int used;          // bytes allocated
+  unsigned int largestFree;   // largest block that can be allocated
+  unsigned int freeBlocks;    // free blocks, more for the same free bytes
+                              // means more fragmented
+  unsigned int blocks;        // blocks, allocated & free
+  unsigned int allocs;        // SCE_VramAlloc calls that succeeded
+  unsigned int frees;
+  unsigned int failures;      // SCE_VramAlloc calls with no block to give
+  unsigned int merges;        // freed blocks merged with a free neighbour
+} SCE_VramStats;
+
+// Work done flushing a command list, see SCE_GetFrameStats
+typedef struct SCE_CmdStats
+{
+  unsigned int flushes;
+  unsigned int commands;
+  unsigned int blits;         // drawn by SDL (alpha, other formats)
+  unsigned int keyBlits;      // drawn by the 16 bit colorkey blitter
+  unsigned int copies;        // copied by the GU, memcpy off the PSP
+  unsigned int fills;
+  unsigned int pixels;        // pixels written
+  unsigned int guLists;       // GU display lists submitted
+  unsigned int flushUs;       // time spent flushing
+} SCE_CmdStats;
+
+// A blit, copy or fill recorded in a command list
+typedef struct SceCommand
+{
+  unsigned char type;         // SCE_CMD_BLIT, SCE_CMD_COPY or SCE_CMD_FILL
+  Uint32        color;        // fill color
+  SDL_Surface  *img;
+  SDL_Rect      src;          // allready clipped
+  SDL_Rect      dst;
+} SceCommand;
+
+// Draw commands recorded to be carried out later, all at once, by 
+// SCE_ListFlush.  Each thread drawing uses a list of its own.
+typedef struct SCE_CmdList
+{
+  unsigned int  guList[SCE_GU_LIST_WORDS] __attribute__((aligned(16)));
+  SceCommand    cmds[SCE_MAX_COMMANDS];
+  int           count;
+  SDL_Surface  *target;       // surface drawn to
+  SCE_CmdStats  frame;        // last flush
+  SCE_CmdStats  total;        // all flushes
+} SCE_CmdList;
+
 
 SDL_Surface* SCE_LoadVramImage(const char *file, unsigned int format, unsigned int flags);
 SDL_Surface* SCE_LoadBackground2(const char *file);
 SDL_Surface* SCE_LoadBackground1(const char *file);
 void         SCE_BlitSurface(SDL_Surface* l1, SDL_Rect *, SDL_Surface *, SDL_Rect*);
 void         SCE_Init();
+void         *SCE_VramAlloc(unsigned int size);
+void         SCE_VramFree(void *ptr);
+void         SCE_FreeVramImage(SDL_Surface *img);
+void         SCE_GetVramStats(SCE_VramStats *stats);
+void         SCE_ListStart(SCE_CmdList *l, SDL_Surface *target);
+int          SCE_ListBlit(SCE_CmdList *l, SDL_Surface *img, SDL_Rect *src, 
+                          SDL_Rect *dst);
+int          SCE_ListCopy(SCE_CmdList *l, SDL_Surface *img, SDL_Rect *src, 
+                          SDL_Rect *dst);
+int          SCE_ListFill(SCE_CmdList *l, SDL_Rect *dst, Uint32 color);
+void         SCE_ListFlush(SCE_CmdList *l);
+int          SCE_Blit(SDL_Surface *img, SDL_Rect *src, SDL_Rect *dst);
+int          SCE_KeyBlit(SDL_Surface *img, SDL_Rect *src, SDL_Surface *target,
+                         SDL_Rect *dst);
+void         SCE_FlushFrame();
+void         SCE_GetFrameStats(SCE_CmdStats *frame, SCE_CmdStats *total);
+#ifdef MM_PROFILE
+void         SCE_ProfileVram();
+void         SCE_ProfileCommands();
+void         SCE_ProfileBlit(const char *name, SDL_Surface *img, int frames);
+#endif
 
 #define SCE_TRANSP_FORMAT   2
 #define SCE_SCREEN_FORMAT   1
 #define SCE_NATIVE_FORMAT   0
 
+#define SCE_CMD_BLIT        0
+#define SCE_CMD_COPY        1
+#define SCE_CMD_FILL        2
+
 #endif
@@ -14,6 +14,7 @@
 #include "bg_manager.h"
 #include "resource_manager.h"
 #include "dl_manager.h"
+#include "sce_graphics.h"
 
 // Private Data
 #define MAX_SPRITES             50
@@ -899,7 +900,7 @@ int SM_DrawSprites(void *vs)
   
   scrRec.y  = s->yPos;
   sprRec.y  = s->curFrm;
-  status   += SDL_BlitSurface(s->img, &sprRec, _scr, &scrRec);      
+  status   += SCE_Blit(s->img, &sprRec, &scrRec);      
  
  return(status);
 }
@@ -0,0 +1,1004 @@
+//-----------------------------------------------------------------------------
+//  Class:
+//  Text Manager
+//
+//  Description:
+//  This class draws text that changes too often to be rendered by SDL_ttf
+//  every time (see ZIP_RenderText for strings that do not).  Each glyph of
+//  a font is rendered 1X, for a given size, style & colour, into an atlas
+//  image in the display's alpha format.  Strings are then drawn by blitting
+//  the glyphs out of the atlas, kerned as SDL_ttf would kern them.
+//
+//  TXT_WrapText breaks a block of text into lines that fit a given width,
+//  the way the load screen & error handler always have (see TXT_WrapText),
+//  and TXT_DrawLines draws them.
+//
+//  Atlases are shared & counted like fonts, each TXT_GetAtlas must be
+//  matched by a TXT_ReleaseAtlas.  Released atlases stay around for the
+//  next screen until TXT_FlushAtlases.  Main thread only.
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include <stdlib.h>
+#include "text_manager.h"
+#include "zip_manager.h"
+#include "eh_manager.h"
+
+#define FIRST_GLYPH      32     // ' '
+#define LAST_GLYPH      126     // '~'
+#define NUM_GLYPHS      (LAST_GLYPH - FIRST_GLYPH + 1)
+#define UNKNOWN_GLYPH   '?'     // drawn for characters not in the atlas
+#define ATLAS_WIDTH     512
+#define KERN_UNKNOWN   -128     // pair has not been measured yet
+
+// Where a glyph is in the atlas & how it moves the pen
+typedef struct TxtGlyph
+{
+  SDL_Rect src;         // glyph's cell in the atlas, w is 0 if not rendered
+  short    offset;      // x of cell relative to the pen (minx if < 0)
+  short    advance;
+} TxtGlyph;
+
+struct TXT_Atlas
+{
+  ZIP_Font     *font;   // the atlas holds a reference on its font
+  SDL_Color    color;
+  SDL_Surface  *img;    // every glyph, in the display's alpha format
+  int          height;  // TTF_FontHeight
+  TxtGlyph     glyph[NUM_GLYPHS];
+  signed char  kern[NUM_GLYPHS][NUM_GLYPHS]; // added to the advance between
+                                             // 2 glyphs, see Kerning
+  unsigned int refs;    // TXT_GetAtlas calls not yet released
+  struct TXT_Atlas *next;
+};
+
+// Position of the pen while walking a string, & the extent of the glyphs
+// placed so far
+typedef struct TxtPen
+{
+  int x;                // where the next glyph goes, before kerning
+  int left;             // leftmost pixel (0 or less)
+  int right;            // rightmost pixel
+  int prev;             // index of previous glyph, -1 at start of string
+} TxtPen;
+
+// Private data
+static TXT_Atlas *_atlases;   // every atlas, in use or not
+
+static TXT_Atlas *CreateAtlas(ZIP_Font *font, SDL_Color color);
+static void FreeAtlas(TXT_Atlas *a);
+static int  LayoutText(TXT_Atlas *a, const char *text, int length,
+                       SDL_Surface *dst, int x, int y);
+static void StartPen(TxtPen *pen);
+static TxtGlyph *PlaceGlyph(TXT_Atlas *a, TxtPen *pen, char c, int *cellX);
+static int  MeasureTo(TXT_Atlas *a, const char *text, TxtPen *pen, int *pos,
+                      int end);
+static int  AddLine(TXT_Atlas *a, const char *text, int start, int end,
+                    TXT_Line *lines, int count, int maxLines);
+static int  GlyphIndex(unsigned char c);
+static int  Kerning(TXT_Atlas *a, int prev, int cur);
+
+//------------------------------------------------------------------------------
+// Name:     TXT_GetAtlas
+// Summary:  Returns the glyph atlas of a font, size, style & colour,
+//           rendering it if it has not been yet
+// Inputs:   1. font - name of font file (ZIP_FONT1, ZIP_FONT2)
+//           2. ptSize - point size of font
+//           3. style - style of font (TTF_STYLE_xxx)
+//           4. color - colour to render glyphs in
+// Outputs:  None
+// Returns:  Atlas, 0 on error
+// Cautions: A zip file must be open the first time a font is used
+//------------------------------------------------------------------------------
+TXT_Atlas *TXT_GetAtlas(const char *font, int ptSize, int style,
+                        SDL_Color color)
+{
+  ZIP_Font *f = ZIP_LoadFontStyle(font, ptSize, style);
+  TXT_Atlas *a;
+
+  if (f == 0)
+    return(0);
+
+  for (a=_atlases; a; a=a->next)
+  {
+    if (a->font == f && a->color.r == color.r && a->color.g == color.g &&
+        a->color.b == color.b)
+    {
+      ZIP_CloseFont(f);  // the atlas allready holds the font
+      a->refs++;
+      return(a);
+    }
+  }
+
+  a = CreateAtlas(f, color);
+  if (a == 0)
+  {
+    EH_Error(EH_SEVERE, "TXT_GetAtlas: Could not render %s (%i).", font,
+             ptSize);
+    ZIP_CloseFont(f);
+    return(0);
+  }
+  a->refs  = 1;
+  a->next  = _atlases;
+  _atlases = a;
+  return(a);
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_ReleaseAtlas
+// Summary:  Hands back an atlas returned by TXT_GetAtlas
+// Inputs:   Atlas to release (may be 0)
+// Outputs:  None
+// Returns:  None
+// Cautions: The atlas stays around for the next screen using it, so its
+//           glyphs are not rendered again (see TXT_FlushAtlases)
+//------------------------------------------------------------------------------
+void TXT_ReleaseAtlas(TXT_Atlas *a)
+{
+  if (a && a->refs)
+    a->refs--;
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_FlushAtlases
+// Summary:  Frees every atlas not in use, and hands back their fonts
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Call before ZIP_FlushCache, or the fonts stay open
+//------------------------------------------------------------------------------
+void TXT_FlushAtlases()
+{
+  TXT_Atlas **p = &_atlases;
+  TXT_Atlas *a;
+
+  while (*p)
+  {
+    a = *p;
+    if (a->refs == 0)
+    {
+      *p = a->next;
+      FreeAtlas(a);
+    }
+    else
+    {
+      p = &a->next;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_SizeText
+// Summary:  Gets the size a string would be drawn at
+// Inputs:   1. a - atlas to draw with
+//           2. text - string
+// Outputs:  1. w - width of string
+//           2. h - height of string
+// Returns:  None
+// Cautions: Same size TTF_SizeText gives for the atlas' font
+//------------------------------------------------------------------------------
+void TXT_SizeText(TXT_Atlas *a, const char *text, int *w, int *h)
+{
+  *w = LayoutText(a, text, strlen(text), 0, 0, 0);
+  *h = a->height;
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_GetHeight
+// Summary:  Returns the height of a line of text drawn with an atlas
+// Inputs:   Atlas
+// Outputs:  None
+// Returns:  Height of a line
+// Cautions: None
+//------------------------------------------------------------------------------
+int TXT_GetHeight(TXT_Atlas *a)
+{
+  return(a->height);
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_DrawText
+// Summary:  Draws a string by blitting its glyphs from an atlas
+// Inputs:   1. a - atlas to draw with
+//           2. text - string to draw
+//           3. dst - surface to draw on
+//           4. x, y - where the top left of the string goes, the same place
+//              a surface from TTF_RenderText would be blitted to
+// Outputs:  None
+// Returns:  Width of string drawn
+// Cautions: Characters outside ' ' - '~' are drawn as UNKNOWN_GLYPH.  Only
+//           the glyphs are drawn, fill the background first for shaded text.
+//------------------------------------------------------------------------------
+int TXT_DrawText(TXT_Atlas *a, const char *text, SDL_Surface *dst,
+                 int x, int y)
+{
+  return(LayoutText(a, text, strlen(text), dst, x, y));
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_WrapText
+// Summary:  Breaks a block of text into lines no wider than the given width
+// Inputs:   1. a - atlas text will be drawn with
+//           2. text - text to break, lines end on spaces & newlines
+//           3. width - widest a line may be
+//           4. maxLines - size of lines
+// Outputs:  lines - each line found (up to maxLines)
+// Returns:  Number of lines found, may be more than maxLines
+// Cautions: Breaks exactly where the old loop in MENU_DrawLoadScreen and 
+//           EH_DrawErrors did (TXT_ProfileWrap checks it), quirks included:
+//           a word wider than width gets a line of its own, and a line that
+//           does not fit when the text ends is broken at its last space 
+//           only.  The text is not changed, each character is measured 1X
+//           (plus 1X more for the word carried over to the next line).
+//------------------------------------------------------------------------------
+int TXT_WrapText(TXT_Atlas *a, const char *text, int width, TXT_Line *lines,
+                 int maxLines)
+{
+  int length    = strlen(text);
+  int start     = 0;     // first character of current line
+  int lastSpace = 0;     // last space seen
+  int count     = 0;
+  int pos       = 0;     // first character not yet measured
+  TxtPen pen;
+  int i, c;
+
+  StartPen(&pen);
+  for (i=0; i < length+1; i++)
+  {
+    c = text[i];
+    if (c != ' ' && c != '\n' && c != 0)
+      continue;
+
+    // too long, end the line at the last space that fit (or here)
+    if (MeasureTo(a, text, &pen, &pos, i) > width)
+    {
+      if (lastSpace < start)
+        lastSpace = i;
+      count = AddLine(a, text, start, lastSpace, lines, count, maxLines);
+      start = lastSpace + 1;
+      pos   = start;
+      StartPen(&pen);
+      if (c == '\n' && lastSpace != i)
+        i--;         // the newline may still end the next line
+      else if (c == 0)
+        i = start;   // carry on after the space
+    }
+    else if (c != ' ')  // newline or end of text
+    {
+      count = AddLine(a, text, start, i, lines, count, maxLines);
+      start = i + 1;
+      pos   = start;
+      StartPen(&pen);
+    }
+
+    if (c == ' ')
+      lastSpace = i;
+  }
+  return(count);
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_DrawLines
+// Summary:  Draws the lines of a block of text found by TXT_WrapText, 1 
+//           under the other
+// Inputs:   1. a - atlas to draw with
+//           2. text - text that was wrapped
+//           3. lines - lines to draw
+//           4. count - number of lines
+//           5. dst - surface to draw on
+//           6. x, y - where the top left of the first line goes, or the top
+//              centre if center is set
+//           7. center - if set, each line is centered on x
+// Outputs:  None
+// Returns:  y below the last line drawn
+// Cautions: None
+//------------------------------------------------------------------------------
+int TXT_DrawLines(TXT_Atlas *a, const char *text, const TXT_Line *lines,
+                  int count, SDL_Surface *dst, int x, int y, int center)
+{
+  int i;
+
+  for (i=0; i < count; i++)
+  {
+    LayoutText(a, text + lines[i].start, lines[i].length, dst,
+               center ? x - lines[i].w / 2 : x, y);
+    y += a->height;
+  }
+  return(y);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CreateAtlas
+// Summary:  Renders every glyph of a font into a new atlas
+// Inputs:   1. font - font to render
+//           2. color - colour to render glyphs in
+// Outputs:  None
+// Returns:  Atlas, 0 on error
+// Cautions: Each glyph is rendered as a 1 character string, so its cell
+//           holds it placed exactly as SDL_ttf places it in a string
+//------------------------------------------------------------------------------
+TXT_Atlas *CreateAtlas(ZIP_Font *font, SDL_Color color)
+{
+  SDL_Surface *cell[NUM_GLYPHS];
+  SDL_PixelFormat *fmt = 0;
+  SDL_Surface *img;
+  TXT_Atlas *a;
+  char str[2]   = { 0, 0 };
+  int penX      = 0;
+  int penY      = 0;
+  int rowHeight = 0;
+  int x, minx, maxx, miny, maxy, advance;
+
+  a = (TXT_Atlas *) malloc(sizeof(TXT_Atlas));
+  if (a == 0)
+    return(0);
+  memset(a, 0, sizeof(TXT_Atlas));
+  memset(a->kern, KERN_UNKNOWN, sizeof(a->kern));
+  a->font   = font;
+  a->color  = color;
+  a->height = TTF_FontHeight(font->f);
+
+  // render each glyph & lay the cells out in rows, left to right
+  for (x=0; x < NUM_GLYPHS; x++)
+  {
+    str[0]  = FIRST_GLYPH + x;
+    cell[x] = TTF_RenderText_Blended(font->f, str, color);
+    if (TTF_GlyphMetrics(font->f, str[0], &minx, &maxx, &miny, &maxy,
+                         &advance) == 0)
+    {
+      a->glyph[x].offset  = minx < 0 ? minx : 0;
+      a->glyph[x].advance = advance;
+    }
+    if (cell[x] == 0)
+      continue;
+
+    if (penX + cell[x]->w > ATLAS_WIDTH)
+    {
+      penX      = 0;
+      penY     += rowHeight;
+      rowHeight = 0;
+    }
+    a->glyph[x].src.x = penX;
+    a->glyph[x].src.y = penY;
+    a->glyph[x].src.w = cell[x]->w;
+    a->glyph[x].src.h = cell[x]->h;
+    penX             += cell[x]->w;
+    if (cell[x]->h > rowHeight)
+      rowHeight = cell[x]->h;
+    fmt = cell[x]->format;
+  }
+
+  img = 0;
+  if (fmt)
+  {
+    img = SDL_CreateRGBSurface(SDL_SWSURFACE, ATLAS_WIDTH, penY + rowHeight,
+                               32, fmt->Rmask, fmt->Gmask, fmt->Bmask,
+                               fmt->Amask);
+  }
+  if (img)
+    SDL_FillRect(img, 0, 0);
+
+  // copy the cells as they are, alpha included, then convert the atlas 1X
+  for (x=0; x < NUM_GLYPHS; x++)
+  {
+    if (cell[x] == 0)
+      continue;
+    if (img)
+    {
+      SDL_SetAlpha(cell[x], 0, 0);
+      SDL_BlitSurface(cell[x], 0, img, &a->glyph[x].src);
+    }
+    SDL_FreeSurface(cell[x]);
+  }
+  if (img == 0)
+  {
+    free(a);
+    return(0);
+  }
+
+  a->img = SDL_DisplayFormatAlpha(img);
+  if (a->img)
+    SDL_FreeSurface(img);
+  else
+    a->img = img;
+  return(a);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FreeAtlas
+// Summary:  Frees an atlas created by CreateAtlas and hands back its font
+// Inputs:   Atlas to free
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void FreeAtlas(TXT_Atlas *a)
+{
+  SDL_FreeSurface(a->img);
+  ZIP_CloseFont(a->font);
+  free(a);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LayoutText
+// Summary:  Walks the glyphs of a string, measuring it and drawing it if
+//           given a surface
+// Inputs:   1. a - atlas to draw with
+//           2. text - string
+//           3. length - number of characters of string to walk
+//           4. dst - surface to draw on, 0 to only measure
+//           5. x, y - where the top left of the string goes
+// Outputs:  None
+// Returns:  Width of string
+// Cautions: None
+//------------------------------------------------------------------------------
+int LayoutText(TXT_Atlas *a, const char *text, int length, SDL_Surface *dst,
+               int x, int y)
+{
+  TxtPen pen;
+  TxtGlyph *g;
+  SDL_Rect rect;
+  int i, cellX;
+
+  StartPen(&pen);
+  for (i=0; i < length; i++)
+  {
+    g = PlaceGlyph(a, &pen, text[i], &cellX);
+    if (dst && g->src.w && text[i] != ' ')
+    {
+      rect.x = x + cellX;
+      rect.y = y;
+      SDL_BlitSurface(a->img, &g->src, dst, &rect);
+    }
+  }
+  return(pen.right - pen.left);
+}
+
+//------------------------------------------------------------------------------
+// Name:     StartPen
+// Summary:  Sets a pen up to walk a new string
+// Inputs:   None
+// Outputs:  pen - pen at the start of a string
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void StartPen(TxtPen *pen)
+{
+  pen->x     = 0;
+  pen->left  = 0;
+  pen->right = 0;
+  pen->prev  = -1;
+}
+
+//------------------------------------------------------------------------------
+// Name:     PlaceGlyph
+// Summary:  Places the next glyph of a string & moves the pen past it
+// Inputs:   1. a - atlas
+//           2. pen - pen after the previous glyph
+//           3. c - character to place
+// Outputs:  1. pen - pen after this glyph, with the extent of the string
+//           2. cellX - x of glyph's cell relative to the start of string
+// Returns:  Glyph placed
+// Cautions: None
+//------------------------------------------------------------------------------
+TxtGlyph *PlaceGlyph(TXT_Atlas *a, TxtPen *pen, char c, int *cellX)
+{
+  int cur      = GlyphIndex((unsigned char) c);
+  TxtGlyph *g  = &a->glyph[cur];
+
+  if (pen->prev >= 0)
+    pen->x += Kerning(a, pen->prev, cur);
+  *cellX = pen->x + g->offset;
+
+  // SDL_ttf's surface starts at the leftmost pixel of the string
+  if (*cellX < pen->left)
+    pen->left = *cellX;
+  if (*cellX + g->src.w > pen->right)
+    pen->right = *cellX + g->src.w;
+
+  pen->x   += g->advance;
+  pen->prev = cur;
+  return(g);
+}
+
+//------------------------------------------------------------------------------
+// Name:     MeasureTo
+// Summary:  Extends the part of a string measured by a pen
+// Inputs:   1. a - atlas
+//           2. text - string
+//           3. pen - pen walking the string
+//           4. pos - first character not yet placed on pen
+//           5. end - character to measure up to (not included)
+// Outputs:  pos - end
+// Returns:  Width of string placed on pen so far
+// Cautions: Characters are placed 1X, however often the width is asked for
+//------------------------------------------------------------------------------
+int MeasureTo(TXT_Atlas *a, const char *text, TxtPen *pen, int *pos, int end)
+{
+  int cellX;
+
+  for (; *pos < end; (*pos)++)
+    PlaceGlyph(a, pen, text[*pos], &cellX);
+  return(pen->right - pen->left);
+}
+
+//------------------------------------------------------------------------------
+// Name:     AddLine
+// Summary:  Adds a line found by TXT_WrapText to the list of lines
+// Inputs:   1. a - atlas
+//           2. text - string being wrapped
+//           3. start, end - characters of line (end not included)
+//           4. lines - list of lines
+//           5. count - number of lines found so far
+//           6. maxLines - size of list
+// Outputs:  lines - line added if there is room
+// Returns:  Number of lines found
+// Cautions: Empty lines are dropped, the menus never drew them
+//------------------------------------------------------------------------------
+int AddLine(TXT_Atlas *a, const char *text, int start, int end,
+            TXT_Line *lines, int count, int maxLines)
+{
+  if (end <= start)
+    return(count);
+  if (count < maxLines)
+  {
+    lines[count].start  = start;
+    lines[count].length = end - start;
+    lines[count].w      = LayoutText(a, text + start, end - start, 0, 0, 0);
+  }
+  return(count + 1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     GlyphIndex
+// Summary:  Returns the index in an atlas of a character's glyph
+// Inputs:   Character
+// Outputs:  None
+// Returns:  Index of glyph
+// Cautions: None
+//------------------------------------------------------------------------------
+int GlyphIndex(unsigned char c)
+{
+  if (c < FIRST_GLYPH || c > LAST_GLYPH)
+    c = UNKNOWN_GLYPH;
+  return(c - FIRST_GLYPH);
+}
+
+//------------------------------------------------------------------------------
+// Name:     Kerning
+// Summary:  Returns how far the pen moves past the advance of 1 glyph
+//           before drawing the next (kerning & bold overhang)
+// Inputs:   1. a - atlas
+//           2. prev - index of previous glyph
+//           3. cur - index of glyph about to be drawn
+// Outputs:  None
+// Returns:  Pixels to add to the advance of prev
+// Cautions: SDL_ttf does not hand out kerning, so each pair is measured with
+//           TTF_SizeText the first time it is drawn: the width of the pair
+//           is where cur starts plus the width of cur's cell.
+//------------------------------------------------------------------------------
+int Kerning(TXT_Atlas *a, int prev, int cur)
+{
+  signed char *k = &a->kern[prev][cur];
+  char pair[3];
+  int w, h, start;
+
+  if (*k == KERN_UNKNOWN)
+  {
+    pair[0] = FIRST_GLYPH + prev;
+    pair[1] = FIRST_GLYPH + cur;
+    pair[2] = 0;
+    *k      = 0;
+    if (a->glyph[cur].src.w && TTF_SizeText(a->font->f, pair, &w, &h) == 0)
+    {
+      start = w - a->glyph[cur].src.w - a->glyph[cur].offset +
+              a->glyph[prev].offset - a->glyph[prev].advance;
+      if (start > 127)
+        start = 127;
+      else if (start < -127)
+        start = -127;
+      *k = start;
+    }
+  }
+  return(*k);
+}
+
+#ifdef MM_PROFILE
+//------------------------------------------------------------------------------
+// Name:     TXT_ProfileRender
+// Summary:  Benchmark, draws a set of strings TXT_PROFILE_PASSES times with
+//           TTF_RenderText_Blended + SDL_DisplayFormatAlpha + blit (as the
+//           menus did) and with TXT_DrawText, the atlas time includes
+//           rendering the atlas
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Results are reported as EH_DEBUG messages, along with the number
+//           of strings TXT_SizeText & TTF_SizeText disagree on.  Must not be
+//           called while a zip file is open.
+//------------------------------------------------------------------------------
+void TXT_ProfileRender()
+{
+  static const char *lines[] =
+  {
+    "Now Loading...",
+    "Image: ms0:/PSP/GAME/mm/screenshot_07.png",
+    "Indy! Cover your heart! Cover your heart!",
+    "-Short Round (Indiana Jones and the Temple of Doom)",
+    "Playing with my money is like playing with my emotions, Smokey.",
+    "AV Wa To Ty yo, \"Quotes\" & {braces} [x] 0123456789 !?"
+  };
+  int numLines          = sizeof(lines) / sizeof(lines[0]);
+  int count             = TXT_PROFILE_PASSES * numLines;
+  SDL_Surface *scr      = MM_GetScreenPtr();
+  SDL_Color color       = {255,255,255};
+  unsigned int ttfTime  = 0;
+  unsigned int txtTime  = 0;
+  unsigned int makeTime = 0;
+  unsigned int start;
+  SDL_Surface *dst, *s, *conv;
+  ZIP_Font *font;
+  TXT_Atlas *a, *fresh;
+  int x, y, w1, w2, h, mismatch = 0;
+
+  ZIP_OpenZipFile(ZIP_MAIN);
+  font = ZIP_LoadFont(ZIP_FONT2, 12);
+  a    = TXT_GetAtlas(ZIP_FONT2, 12, TTF_STYLE_NORMAL, color);
+  ZIP_CloseZipFile();
+  dst  = SDL_CreateRGBSurface(SDL_SWSURFACE, scr->w, scr->h,
+                              scr->format->BitsPerPixel, scr->format->Rmask,
+                              scr->format->Gmask, scr->format->Bmask,
+                              scr->format->Amask);
+  if (font == 0 || a == 0 || dst == 0)
+  {
+    ZIP_CloseFont(font);
+    TXT_ReleaseAtlas(a);
+    if (dst)
+      SDL_FreeSurface(dst);
+    return;
+  }
+
+  // also measures every pair, so the timed passes do not include kerning
+  for (y=0; y < numLines; y++)
+  {
+    TTF_SizeText(font->f, lines[y], &w1, &h);
+    TXT_SizeText(a, lines[y], &w2, &h);
+    mismatch += (w1 != w2);
+  }
+
+  start = MM_GetMicroSeconds();
+  for (x=0; x < TXT_PROFILE_PASSES; x++)
+  {
+    for (y=0; y < numLines; y++)
+    {
+      s    = TTF_RenderText_Blended(font->f, lines[y], color);
+      conv = SDL_DisplayFormatAlpha(s);
+      SDL_BlitSurface(conv, 0, dst, 0);
+      SDL_FreeSurface(conv);
+      SDL_FreeSurface(s);
+    }
+  }
+  ttfTime = MM_GetMicroSeconds() - start;
+
+  // what a screen pays the first time it uses an atlas (the font is open),
+  // the fresh atlas holds its own reference, FreeAtlas hands it back
+  ZIP_LoadFont(ZIP_FONT2, 12);
+  start    = MM_GetMicroSeconds();
+  fresh    = CreateAtlas(font, color);
+  makeTime = MM_GetMicroSeconds() - start;
+  if (fresh)
+    FreeAtlas(fresh);
+  else
+    ZIP_CloseFont(font);
+
+  start = MM_GetMicroSeconds();
+  for (x=0; x < TXT_PROFILE_PASSES; x++)
+    for (y=0; y < numLines; y++)
+      TXT_DrawText(a, lines[y], dst, 0, 0);
+  txtTime = MM_GetMicroSeconds() - start + makeTime;
+
+  EH_Error(EH_DEBUG, "TXT %i strings: TTF render+convert %uus (%u/s), "
+           "atlas %uus (%u/s, %uus rendering it), %i sizes differ\n", count,
+           ttfTime, (unsigned int) (count * 1000000.0f / (ttfTime + 1)),
+           txtTime, (unsigned int) (count * 1000000.0f / (txtTime + 1)),
+           makeTime, mismatch);
+
+  SDL_FreeSurface(dst);
+  TXT_ReleaseAtlas(a);
+  ZIP_CloseFont(font);
+}
+#endif
+
+#ifdef MM_PROFILE
+#define WRAP_BUFFER_SIZE 500
+#define WRAP_MAX_LINES    40
+#define WRAP_CHECK_PITCH   7    // width of every glyph in the check atlas
+
+// A pair of glyphs kerned in the proportional check atlas
+typedef struct TxtKernPair
+{
+  char        prev;
+  char        cur;
+  signed char kern;
+} TxtKernPair;
+
+static const TxtKernPair _checkKerns[] =
+{
+  {'A','V',-2}, {'T','o',-1}, {'T','e',-1}, {'W','a',-2}, {'W','e',-1},
+  {'Y','o',-2}, {'y','.',-1}, {'y',',',-1}, {'r','.',-1}, {'r',',',-1},
+  {'f','f', 1}
+};
+#define NUM_CHECK_KERNS ((int) (sizeof(_checkKerns) / sizeof(_checkKerns[0])))
+
+//------------------------------------------------------------------------------
+// Name:     WrapTextTTF
+// Summary:  The word wrap loop MENU_DrawLoadScreen & EH_DrawErrors used 
+//           before TXT_WrapText, kept to check TXT_WrapText against
+// Inputs:   1. font - font to measure with
+//           2. text - text to break
+//           3. width - widest a line may be
+// Outputs:  lines - each line found (up to WRAP_MAX_LINES)
+// Returns:  Number of lines found
+// Cautions: Measures with TTF_SizeText on the whole line at every space
+//------------------------------------------------------------------------------
+static int WrapTextTTF(ZIP_Font *font, const char *text, int width,
+                       TXT_Line *lines)
+{
+  char buffer[WRAP_BUFFER_SIZE];
+  char *p       = buffer;
+  int lastSpace = 0;
+  int start     = 0;
+  int count     = 0;
+  char *line    = 0;
+  int i, w, h, length;
+
+  strncpy(buffer, text, WRAP_BUFFER_SIZE - 1);
+  buffer[WRAP_BUFFER_SIZE - 1] = 0;
+  length = strlen(p);
+
+  for (i=0; i < length+1; i++)
+  {
+    if (p[i] == ' ')
+    {
+      p[i] = 0;
+      TTF_SizeText(font->f, &p[start], &w, &h); 
+      p[i] = ' ';
+      if (w > width) 
+      {
+        if (lastSpace<start) lastSpace = i;
+        p[lastSpace] = 0; 
+        line  = &p[start];
+        start = lastSpace+1;
+      }
+      lastSpace = i;
+    }
+    else if (p[i] == '\n')
+    {
+      p[i] = 0;
+      TTF_SizeText(font->f, &p[start], &w, &h);
+      p[i] = '\n';
+      if (w > width)
+      {
+        if (lastSpace<start) lastSpace = i;
+        p[lastSpace] = 0;
+        line  = &p[start];
+        start = lastSpace+1;
+        if (lastSpace != i) i--; 
+      }
+      else
+      {
+        p[i]  = 0;
+        line  = &p[start];
+        start = i+1;
+      }
+    }
+    else if (p[i] == 0)
+    {
+      TTF_SizeText(font->f, &p[start], &w, &h);
+      if (w > width)  
+      {
+        if (lastSpace<start) lastSpace = i;
+        p[lastSpace] = 0;
+        line  = &p[start];
+        start = i = lastSpace+1;
+      }
+      else
+        line = &p[start];
+    }
+    
+    if (line && *line)
+    {
+      if (count < WRAP_MAX_LINES)
+      {
+        lines[count].start  = line - buffer;
+        lines[count].length = strlen(line);
+      }
+      count++;
+      line = 0;
+    }
+  }
+  return(count);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FixedPitchAtlas
+// Summary:  Sets up an atlas in which every glyph is the same width and no 
+//           pair of glyphs is kerned, so where text breaks does not depend
+//           on a font
+// Inputs:   pitch - width & advance of every glyph
+// Outputs:  a - atlas to measure with
+// Returns:  None
+// Cautions: The atlas has no font or image, it can only measure
+//------------------------------------------------------------------------------
+static void FixedPitchAtlas(TXT_Atlas *a, int pitch)
+{
+  int x;
+
+  memset(a, 0, sizeof(TXT_Atlas));  // every pair kerned by 0
+  for (x=0; x < NUM_GLYPHS; x++)
+  {
+    a->glyph[x].src.w   = pitch;
+    a->glyph[x].advance = pitch;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     ProportionalAtlas
+// Summary:  Sets up an atlas with glyphs of different widths, some hanging
+//           left of the pen or right of their advance, and some pairs 
+//           kerned, as a real font would measure but without one
+// Inputs:   None
+// Outputs:  a - atlas to measure with
+// Returns:  None
+// Cautions: The atlas has no font or image, it can only measure.  The 
+//           widths are made up, the expected breaks of a text measured 
+//           with them must be worked out with the same widths.
+//------------------------------------------------------------------------------
+static void ProportionalAtlas(TXT_Atlas *a)
+{
+  TxtGlyph *g;
+  int x, c;
+
+  memset(a, 0, sizeof(TXT_Atlas));  // pairs not in _checkKerns kerned by 0
+  for (x=0; x < NUM_GLYPHS; x++)
+  {
+    c          = FIRST_GLYPH + x;
+    g          = &a->glyph[x];
+    g->advance = 4 + (c * 7) % 6;
+    g->offset  = (c == 'j') ? -2 : ((c == 'f') ? -1 : 0);
+    g->src.w   = g->advance - g->offset + ((c % 3) == 0 ? 2 : 0);
+  }
+  for (x=0; x < NUM_CHECK_KERNS; x++)
+  {
+    a->kern[GlyphIndex(_checkKerns[x].prev)][GlyphIndex(_checkKerns[x].cur)]
+      = _checkKerns[x].kern;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     CheckWrap
+// Summary:  Breaks each of the given texts into lines with a check atlas, 
+//           and checks the lines against the ones expected
+// Inputs:   1. check - atlas to measure with
+//           2. name - name of atlas, for errors
+//           3. texts - list of texts to break
+//           4. count - number of texts in list
+//           5. width - widest a line may be
+//           6. numLines - number of lines each text breaks into
+//           7. expected - start & length of every line of every text, 
+//              text after text
+// Outputs:  None
+// Returns:  0 if every text breaks as expected, -1 if not
+// Cautions: A text that does not break as expected is a severe error
+//------------------------------------------------------------------------------
+static int CheckWrap(TXT_Atlas *check, const char *name, const char **texts,
+                     int count, int width, const unsigned char *numLines,
+                     const TXT_Line *expected)
+{
+  TXT_Line lines[WRAP_MAX_LINES];
+  int x, y, lineCount;
+
+  for (x=0; x < count; expected += numLines[x], x++)
+  {
+    lineCount = TXT_WrapText(check, texts[x], width, lines, WRAP_MAX_LINES);
+    if (lineCount != numLines[x])
+    {
+      EH_Error(EH_SEVERE, "TXT_ProfileWrap: Text %i has %i lines %s, "
+               "expected %i.", x, lineCount, name, numLines[x]);
+      return(-1);
+    }
+    for (y=0; y < lineCount && y < WRAP_MAX_LINES; y++)
+    {
+      if (lines[y].start  != expected[y].start ||
+          lines[y].length != expected[y].length)
+      {
+        EH_Error(EH_SEVERE, "TXT_ProfileWrap: Text %i line %i is %i+%i %s, "
+                 "expected %i+%i.", x, y, lines[y].start, lines[y].length,
+                 name, expected[y].start, expected[y].length);
+        return(-1);
+      }
+    }
+  }
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     TXT_ProfileWrap
+// Summary:  Check & benchmark.  Breaks each of the given texts into lines 
+//           with a fixed pitch atlas (every glyph WRAP_CHECK_PITCH wide), 
+//           and with a proportional, kerned atlas (see ProportionalAtlas),
+//           and checks the lines against the ones expected.  Then breaks 
+//           each text with TXT_WrapText and with the loop it replaced 
+//           (WrapTextTTF) using the given atlas, and compares them.
+// Inputs:   1. a - atlas to measure with (may be 0 to only check)
+//           2. texts - list of texts to break
+//           3. count - number of texts in list
+//           4. width - widest a line may be
+//           5. pitchLines - number of lines each text breaks into with the
+//              fixed pitch atlas
+//           6. pitchBreaks - start & length of every line of every text, 
+//              text after text, when broken with the fixed pitch atlas
+//           7. kernLines, kernBreaks - the same with the proportional atlas
+// Outputs:  None
+// Returns:  None
+// Cautions: A text that does not break as expected is a severe error.  The
+//           comparison is reported as EH_DEBUG messages, its lines only 
+//           differ if the widths measured differ (see TXT_ProfileRender).
+//------------------------------------------------------------------------------
+void TXT_ProfileWrap(TXT_Atlas *a, const char **texts, int count, int width,
+                     const unsigned char *pitchLines, 
+                     const TXT_Line *pitchBreaks,
+                     const unsigned char *kernLines, 
+                     const TXT_Line *kernBreaks)
+{
+  static TXT_Atlas check;   // too big for the stack
+  TXT_Line ttfLines[WRAP_MAX_LINES];
+  TXT_Line txtLines[WRAP_MAX_LINES];
+  unsigned int ttfTime = 0;
+  unsigned int txtTime = 0;
+  unsigned int start;
+  int x, y, ttfCount, txtCount;
+  int differ = 0;
+
+  FixedPitchAtlas(&check, WRAP_CHECK_PITCH);
+  if (CheckWrap(&check, "at fixed pitch", texts, count, width, pitchLines,
+                pitchBreaks) < 0)
+    return;
+  ProportionalAtlas(&check);
+  if (CheckWrap(&check, "kerned", texts, count, width, kernLines,
+                kernBreaks) < 0)
+    return;
+
+  if (a == 0)
+    return;
+
+  for (x=0; x < count; x++)
+  {
+    start     = MM_GetMicroSeconds();
+    ttfCount  = WrapTextTTF(a->font, texts[x], width, ttfLines);
+    ttfTime  += MM_GetMicroSeconds() - start;
+
+    start     = MM_GetMicroSeconds();
+    txtCount  = TXT_WrapText(a, texts[x], width, txtLines, WRAP_MAX_LINES);
+    txtTime  += MM_GetMicroSeconds() - start;
+
+    if (ttfCount != txtCount)
+    {
+      differ++;
+      continue;
+    }
+    for (y=0; y < txtCount && y < WRAP_MAX_LINES; y++)
+    {
+      if (ttfLines[y].start  != txtLines[y].start ||
+          ttfLines[y].length != txtLines[y].length)
+      {
+        differ++;
+        break;
+      }
+    }
+  }
+
+  EH_Error(EH_DEBUG, "TXT wrap %i texts: TTF loop %uus, TXT_WrapText %uus, "
+           "%i wrapped differently\n", count, ttfTime, txtTime, differ);
+}
+#endif
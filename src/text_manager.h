@@ -0,0 +1,39 @@
+#ifndef __TEXT_MANAGER_H__
+#define __TEXT_MANAGER_H__
+#include "common.h"
+
+typedef struct TXT_Atlas TXT_Atlas;
+
+// A line of a block of text broken up by TXT_WrapText
+typedef struct TXT_Line
+{
+  int start;       // offset of first character in text
+  int length;      // number of characters
+  int w;           // width of line
+} TXT_Line;
+
+// Public
+TXT_Atlas *TXT_GetAtlas(const char *font, int ptSize, int style,
+                        SDL_Color color);
+void      TXT_ReleaseAtlas(TXT_Atlas *a);
+void      TXT_FlushAtlases();
+void      TXT_SizeText(TXT_Atlas *a, const char *text, int *w, int *h);
+int       TXT_GetHeight(TXT_Atlas *a);
+int       TXT_DrawText(TXT_Atlas *a, const char *text, SDL_Surface *dst,
+                       int x, int y);
+int       TXT_WrapText(TXT_Atlas *a, const char *text, int width,
+                       TXT_Line *lines, int maxLines);
+int       TXT_DrawLines(TXT_Atlas *a, const char *text, const TXT_Line *lines,
+                        int count, SDL_Surface *dst, int x, int y, int center);
+
+#ifdef MM_PROFILE
+#define TXT_PROFILE_PASSES 20
+void      TXT_ProfileRender();
+void      TXT_ProfileWrap(TXT_Atlas *a, const char **texts, int count,
+                          int width, const unsigned char *pitchLines,
+                          const TXT_Line *pitchBreaks,
+                          const unsigned char *kernLines,
+                          const TXT_Line *kernBreaks);
+#endif
+
+#endif
@@ -40,6 +40,7 @@ woven in by Terry Thorsen 1/2003.
 #include <string.h>
 #include "zlib.h"
 #include "unzip.h"
+#include "lbg_lz4.h"
 
 #ifdef STDC
 #  include <stddef.h>
@@ -120,6 +121,11 @@ typedef struct
     uLong compression_method;   /* compression method (0==store) */
     uLong byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
     int   raw;
+
+    unsigned char* lz4_in;      /* compressed block (LBG_LZ4_METHOD only) */
+    unsigned char* lz4_out;     /* decompressed block */
+    uInt  lz4_out_pos;          /* bytes of lz4_out already read */
+    uInt  lz4_out_len;          /* bytes in lz4_out */
 } file_in_zip_read_info_s;
 
 
@@ -156,6 +162,136 @@ typedef struct
 #include "crypt.h"
 #endif
 
+
+/* Read contexts (the read buffer and inflate state of an open file) are not
+   freed when a file is closed, up to UNZ_CONTEXT_POOL_SIZE of them are kept
+   here and handed out again (after an inflateReset) by the next open, from
+   any unzFile.  The pool is guarded by the lock set with
+   unzSetContextPoolLock. */
+#ifndef UNZ_CONTEXT_POOL_SIZE
+#define UNZ_CONTEXT_POOL_SIZE (4)
+#endif
+
+local file_in_zip_read_info_s* unz_context_pool[UNZ_CONTEXT_POOL_SIZE];
+local int    unz_context_pool_count = 0;
+local uLong  unz_context_created = 0;
+local uLong  unz_context_reused = 0;
+local unz_lock_func unz_context_lock = NULL;
+local unz_lock_func unz_context_unlock = NULL;
+local voidpf unz_context_lock_opaque = NULL;
+
+#define UNZ_LOCK_POOL() \
+    { if (unz_context_lock!=NULL) (*unz_context_lock)(unz_context_lock_opaque); }
+#define UNZ_UNLOCK_POOL() \
+    { if (unz_context_unlock!=NULL) (*unz_context_unlock)(unz_context_lock_opaque); }
+
+/* Take a context from the pool, or allocate one (with its read buffer) if
+   the pool is empty.  Return NULL if there is no memory */
+local file_in_zip_read_info_s* unzlocal_GetContext OF((void));
+
+local file_in_zip_read_info_s* unzlocal_GetContext ()
+{
+    file_in_zip_read_info_s* ctx = NULL;
+
+    UNZ_LOCK_POOL();
+    if (unz_context_pool_count>0)
+    {
+        ctx = unz_context_pool[--unz_context_pool_count];
+        unz_context_reused++;
+    }
+    UNZ_UNLOCK_POOL();
+    if (ctx!=NULL)
+        return ctx;
+
+    ctx = (file_in_zip_read_info_s*)ALLOC(sizeof(file_in_zip_read_info_s));
+    if (ctx==NULL)
+        return NULL;
+    ctx->read_buffer=(char*)ALLOC(UNZ_BUFSIZE);
+    if (ctx->read_buffer==NULL)
+    {
+        TRYFREE(ctx);
+        return NULL;
+    }
+    ctx->stream_initialised=0;
+    ctx->lz4_in=NULL;
+    ctx->lz4_out=NULL;
+
+    UNZ_LOCK_POOL();
+    unz_context_created++;
+    UNZ_UNLOCK_POOL();
+    return ctx;
+}
+
+/* Free a context, and its inflate state if it has 1 */
+local void unzlocal_FreeContext OF((file_in_zip_read_info_s* ctx));
+
+local void unzlocal_FreeContext (ctx)
+    file_in_zip_read_info_s* ctx;
+{
+    TRYFREE(ctx->read_buffer);
+    TRYFREE(ctx->lz4_in);
+    TRYFREE(ctx->lz4_out);
+    if (ctx->stream_initialised)
+        inflateEnd(&ctx->stream);
+    TRYFREE(ctx);
+}
+
+/* Give a context back to the pool, freeing it if the pool is full */
+local void unzlocal_ReleaseContext OF((file_in_zip_read_info_s* ctx));
+
+local void unzlocal_ReleaseContext (ctx)
+    file_in_zip_read_info_s* ctx;
+{
+    UNZ_LOCK_POOL();
+    if (unz_context_pool_count<UNZ_CONTEXT_POOL_SIZE)
+    {
+        unz_context_pool[unz_context_pool_count++] = ctx;
+        ctx = NULL;
+    }
+    UNZ_UNLOCK_POOL();
+    if (ctx!=NULL)
+        unzlocal_FreeContext(ctx);
+}
+
+extern void ZEXPORT unzSetContextPoolLock (lock, unlock, opaque)
+    unz_lock_func lock;
+    unz_lock_func unlock;
+    voidpf opaque;
+{
+    unz_context_lock = lock;
+    unz_context_unlock = unlock;
+    unz_context_lock_opaque = opaque;
+}
+
+extern void ZEXPORT unzFreeContextPool ()
+{
+    file_in_zip_read_info_s* ctx;
+
+    for (;;)
+    {
+        ctx = NULL;
+        UNZ_LOCK_POOL();
+        if (unz_context_pool_count>0)
+            ctx = unz_context_pool[--unz_context_pool_count];
+        UNZ_UNLOCK_POOL();
+        if (ctx==NULL)
+            break;
+        unzlocal_FreeContext(ctx);
+    }
+}
+
+extern void ZEXPORT unzGetContextPoolStats (pcreated, preused)
+    uLong* pcreated;
+    uLong* preused;
+{
+    UNZ_LOCK_POOL();
+    if (pcreated!=NULL)
+        *pcreated = unz_context_created;
+    if (preused!=NULL)
+        *preused = unz_context_reused;
+    UNZ_UNLOCK_POOL();
+}
+
 /* ===========================================================================
      Read a byte from a gz_stream; update next_in and avail_in. Return EOF
    for end of file.
@@ -257,6 +393,63 @@ local int unzlocal_getLong (pzlib_filefunc_def,filestream,pX)
     return err;
 }
 
+#ifdef MM_PROFILE
+/* 0 while headers are read a byte at a time, as unzlocal_getShort /
+   unzlocal_getLong read them before unzlocal_getRecord, so a benchmark can
+   count the IO calls both ways */
+local int unz_record_reads = 1;
+
+extern void ZEXPORT unzSetRecordReads (on)
+    int on;
+{
+    unz_record_reads = on;
+}
+#endif
+
+/* ===========================================================================
+   Reads a whole fixed size record (a zip header) in 1 call, its fields are
+   then decoded from memory with unzlocal_bufShort / unzlocal_bufLong.
+   Returns the same codes as unzlocal_getByte.
+*/
+local int unzlocal_getRecord OF((
+    const zlib_filefunc_def* pzlib_filefunc_def,
+    voidpf filestream,
+    unsigned char *buf,
+    uLong size));
+
+local int unzlocal_getRecord (pzlib_filefunc_def,filestream,buf,size)
+    const zlib_filefunc_def* pzlib_filefunc_def;
+    voidpf filestream;
+    unsigned char *buf;
+    uLong size;
+{
+#ifdef MM_PROFILE
+    if (!unz_record_reads)
+    {
+        uLong i;
+        int c,err;
+        for (i=0;i<size;i++)
+        {
+            err = unzlocal_getByte(pzlib_filefunc_def,filestream,&c);
+            if (err!=UNZ_OK)
+                return err;
+            buf[i] = (unsigned char)c;
+        }
+        return UNZ_OK;
+    }
+#endif
+    if (ZREAD(*pzlib_filefunc_def,filestream,buf,size)==size)
+        return UNZ_OK;
+    if (ZERROR(*pzlib_filefunc_def,filestream))
+        return UNZ_ERRNO;
+    return UNZ_EOF;
+}
+
+/* Read a short / long in LSB order from a record read by unzlocal_getRecord */
+#define unzlocal_bufShort(p) ((uLong)(p)[0] | ((uLong)(p)[1]<<8))
+#define unzlocal_bufLong(p)  (unzlocal_bufShort(p) | \
+                              (unzlocal_bufShort((p)+2)<<16))
+
 
 /* My own strcmpi / strcasecmp */
 local int strcmpcasenosensitive_internal (fileName1,fileName2)
@@ -593,8 +786,8 @@ local int unzlocal_GetCurrentFileInfoInternal (file,
     unz_s* s;
     unz_file_info file_info;
     unz_file_info_internal file_info_internal;
+    unsigned char header[SIZECENTRALDIRITEM];
     int err=UNZ_OK;
-    uLong uMagic;
     long lSeek=0;
 
     if (file==NULL)
@@ -605,60 +798,37 @@ local int unzlocal_GetCurrentFileInfoInternal (file,
               ZLIB_FILEFUNC_SEEK_SET)!=0)
         err=UNZ_ERRNO;
 
-
-    /* we check the magic */
+    /* read the whole fixed part of the entry, then decode it */
     if (err==UNZ_OK)
-        if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uMagic) != UNZ_OK)
+        if (unzlocal_getRecord(&s->z_filefunc, s->filestream,header,
+                               SIZECENTRALDIRITEM) != UNZ_OK)
             err=UNZ_ERRNO;
-        else if (uMagic!=0x02014b50)
-            err=UNZ_BADZIPFILE;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.version) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.version_needed) != UNZ_OK)
-        err=UNZ_ERRNO;
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.flag) != UNZ_OK)
-        err=UNZ_ERRNO;
+    if (err!=UNZ_OK)
+        return err;
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.compression_method) != UNZ_OK)
-        err=UNZ_ERRNO;
+    /* we check the magic */
+    if (unzlocal_bufLong(header) != 0x02014b50)
+        err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.dosDate) != UNZ_OK)
-        err=UNZ_ERRNO;
+    file_info.version            = unzlocal_bufShort(header+4);
+    file_info.version_needed     = unzlocal_bufShort(header+6);
+    file_info.flag               = unzlocal_bufShort(header+8);
+    file_info.compression_method = unzlocal_bufShort(header+10);
+    file_info.dosDate            = unzlocal_bufLong(header+12);
 
     unzlocal_DosDateToTmuDate(file_info.dosDate,&file_info.tmu_date);
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.crc) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.compressed_size) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.uncompressed_size) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.size_filename) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.size_file_extra) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.size_file_comment) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.disk_num_start) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.internal_fa) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.external_fa) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info_internal.offset_curfile) != UNZ_OK)
-        err=UNZ_ERRNO;
+    file_info.crc                = unzlocal_bufLong(header+16);
+    file_info.compressed_size    = unzlocal_bufLong(header+20);
+    file_info.uncompressed_size  = unzlocal_bufLong(header+24);
+    file_info.size_filename      = unzlocal_bufShort(header+28);
+    file_info.size_file_extra    = unzlocal_bufShort(header+30);
+    file_info.size_file_comment  = unzlocal_bufShort(header+32);
+    file_info.disk_num_start     = unzlocal_bufShort(header+34);
+    file_info.internal_fa        = unzlocal_bufShort(header+36);
+    file_info.external_fa        = unzlocal_bufLong(header+38);
+    file_info_internal.offset_curfile = unzlocal_bufLong(header+42);
 
     lSeek+=file_info.size_filename;
     if ((err==UNZ_OK) && (szFileName!=NULL))
@@ -962,9 +1132,10 @@ local int unzlocal_CheckCurrentFileCoherencyHeader (s,piSizeVar,
     uLong *poffset_local_extrafield;
     uInt  *psize_local_extrafield;
 {
-    uLong uMagic,uData,uFlags;
+    uLong uFlags;
     uLong size_filename;
     uLong size_extra_field;
+    unsigned char header[SIZEZIPLOCALHEADER];
     int err=UNZ_OK;
 
     *piSizeVar = 0;
@@ -975,62 +1146,52 @@ local int unzlocal_CheckCurrentFileCoherencyHeader (s,piSizeVar,
                                 s->byte_before_the_zipfile,ZLIB_FILEFUNC_SEEK_SET)!=0)
         return UNZ_ERRNO;
 
+    /* read the whole fixed part of the local header, then decode it */
+    if (unzlocal_getRecord(&s->z_filefunc, s->filestream,header,
+                           SIZEZIPLOCALHEADER) != UNZ_OK)
+        return UNZ_ERRNO;
 
-    if (err==UNZ_OK)
-        if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uMagic) != UNZ_OK)
-            err=UNZ_ERRNO;
-        else if (uMagic!=0x04034b50)
-            err=UNZ_BADZIPFILE;
+    if (unzlocal_bufLong(header) != 0x04034b50)
+        err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&uData) != UNZ_OK)
-        err=UNZ_ERRNO;
 /*
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.wVersion))
+    else if ((err==UNZ_OK) && (unzlocal_bufShort(header+4)!=s->cur_file_info.wVersion))
         err=UNZ_BADZIPFILE;
 */
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&uFlags) != UNZ_OK)
-        err=UNZ_ERRNO;
+    uFlags = unzlocal_bufShort(header+6);
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&uData) != UNZ_OK)
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compression_method))
+    if ((err==UNZ_OK) &&
+        (unzlocal_bufShort(header+8)!=s->cur_file_info.compression_method))
         err=UNZ_BADZIPFILE;
 
     if ((err==UNZ_OK) && (s->cur_file_info.compression_method!=0) &&
-                         (s->cur_file_info.compression_method!=Z_DEFLATED))
+                         (s->cur_file_info.compression_method!=Z_DEFLATED) &&
+                         (s->cur_file_info.compression_method!=LBG_LZ4_METHOD))
         err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* date/time */
-        err=UNZ_ERRNO;
+    /* header+10 is the date/time */
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* crc */
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.crc) &&
-                              ((uFlags & 8)==0))
+    if ((err==UNZ_OK) && (unzlocal_bufLong(header+14)!=s->cur_file_info.crc) &&
+                         ((uFlags & 8)==0))
         err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* size compr */
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compressed_size) &&
-                              ((uFlags & 8)==0))
+    if ((err==UNZ_OK) &&
+        (unzlocal_bufLong(header+18)!=s->cur_file_info.compressed_size) &&
+        ((uFlags & 8)==0))
         err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* size uncompr */
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.uncompressed_size) &&
-                              ((uFlags & 8)==0))
+    if ((err==UNZ_OK) &&
+        (unzlocal_bufLong(header+22)!=s->cur_file_info.uncompressed_size) &&
+        ((uFlags & 8)==0))
         err=UNZ_BADZIPFILE;
 
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&size_filename) != UNZ_OK)
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (size_filename!=s->cur_file_info.size_filename))
+    size_filename = unzlocal_bufShort(header+26);
+    if ((err==UNZ_OK) && (size_filename!=s->cur_file_info.size_filename))
         err=UNZ_BADZIPFILE;
 
     *piSizeVar += (uInt)size_filename;
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&size_extra_field) != UNZ_OK)
-        err=UNZ_ERRNO;
+    size_extra_field = unzlocal_bufShort(header+28);
     *poffset_local_extrafield= s->cur_file_info_internal.offset_curfile +
                                     SIZEZIPLOCALHEADER + size_filename;
     *psize_local_extrafield = (uInt)size_extra_field;
@@ -1077,25 +1238,15 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
                 &offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
         return UNZ_BADZIPFILE;
 
-    pfile_in_zip_read_info = (file_in_zip_read_info_s*)
-                                        ALLOC(sizeof(file_in_zip_read_info_s));
+    pfile_in_zip_read_info = unzlocal_GetContext();
     if (pfile_in_zip_read_info==NULL)
         return UNZ_INTERNALERROR;
 
-    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(UNZ_BUFSIZE);
     pfile_in_zip_read_info->offset_local_extrafield = offset_local_extrafield;
     pfile_in_zip_read_info->size_local_extrafield = size_local_extrafield;
     pfile_in_zip_read_info->pos_local_extrafield=0;
     pfile_in_zip_read_info->raw=raw;
 
-    if (pfile_in_zip_read_info->read_buffer==NULL)
-    {
-        TRYFREE(pfile_in_zip_read_info);
-        return UNZ_INTERNALERROR;
-    }
-
-    pfile_in_zip_read_info->stream_initialised=0;
-
     if (method!=NULL)
         *method = (int)s->cur_file_info.compression_method;
 
@@ -1111,7 +1262,8 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
     }
 
     if ((s->cur_file_info.compression_method!=0) &&
-        (s->cur_file_info.compression_method!=Z_DEFLATED))
+        (s->cur_file_info.compression_method!=Z_DEFLATED) &&
+        (s->cur_file_info.compression_method!=LBG_LZ4_METHOD))
         err=UNZ_BADZIPFILE;
 
     pfile_in_zip_read_info->crc32_wait=s->cur_file_info.crc;
@@ -1127,17 +1279,36 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
     if ((s->cur_file_info.compression_method==Z_DEFLATED) &&
         (!raw))
     {
-      pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
-      pfile_in_zip_read_info->stream.zfree = (free_func)0;
-      pfile_in_zip_read_info->stream.opaque = (voidpf)0;
       pfile_in_zip_read_info->stream.next_in = (voidpf)0;
       pfile_in_zip_read_info->stream.avail_in = 0;
 
-      err=inflateInit2(&pfile_in_zip_read_info->stream, -MAX_WBITS);
+      /* a context from the pool may already have an inflate state, if it
+         can not be reset it is ended and a new one made */
+      if (pfile_in_zip_read_info->stream_initialised)
+      {
+        err=inflateReset(&pfile_in_zip_read_info->stream);
+        if (err != Z_OK)
+        {
+          inflateEnd(&pfile_in_zip_read_info->stream);
+          pfile_in_zip_read_info->stream_initialised=0;
+        }
+      }
+      if (!pfile_in_zip_read_info->stream_initialised)
+      {
+        pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
+        pfile_in_zip_read_info->stream.zfree = (free_func)0;
+        pfile_in_zip_read_info->stream.opaque = (voidpf)0;
+        err=inflateInit2(&pfile_in_zip_read_info->stream, -MAX_WBITS);
+      }
       if (err == Z_OK)
         pfile_in_zip_read_info->stream_initialised=1;
       else
+      {
+        /* inflateInit2 frees what it allocated when it fails */
+        pfile_in_zip_read_info->stream_initialised=0;
+        unzlocal_FreeContext(pfile_in_zip_read_info);
         return err;
+      }
         /* windowBits is passed < 0 to tell that there is no zlib header.
          * Note that in this case inflate *requires* an extra "dummy" byte
          * after the compressed stream in order to complete decompression and
@@ -1146,6 +1317,25 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
          * size of both compressed and uncompressed data
          */
     }
+    else if ((s->cur_file_info.compression_method==LBG_LZ4_METHOD) &&
+             (!raw))
+    {
+      /* block buffers are kept with the context, like the inflate state */
+      if (pfile_in_zip_read_info->lz4_in==NULL)
+        pfile_in_zip_read_info->lz4_in = (unsigned char*)
+                              ALLOC(LBG_LZ4_BOUND(LBG_LZ4_BLOCK_SIZE));
+      if (pfile_in_zip_read_info->lz4_out==NULL)
+        pfile_in_zip_read_info->lz4_out = (unsigned char*)
+                              ALLOC(LBG_LZ4_BLOCK_SIZE);
+      if ((pfile_in_zip_read_info->lz4_in==NULL) ||
+          (pfile_in_zip_read_info->lz4_out==NULL))
+      {
+        unzlocal_FreeContext(pfile_in_zip_read_info);
+        return UNZ_INTERNALERROR;
+      }
+      pfile_in_zip_read_info->lz4_out_pos = 0;
+      pfile_in_zip_read_info->lz4_out_len = 0;
+    }
     pfile_in_zip_read_info->rest_read_compressed =
             s->cur_file_info.compressed_size ;
     pfile_in_zip_read_info->rest_read_uncompressed =
@@ -1208,6 +1398,84 @@ extern int ZEXPORT unzOpenCurrentFile2 (file,method,level,raw)
     return unzOpenCurrentFile3(file, method, level, raw, NULL);
 }
 
+/*
+  Read bytes from the current file compressed with LBG_LZ4_METHOD, decoding
+    it 1 block at a time (see lbg_lz4.h).  Same returns as unzReadCurrentFile
+*/
+local int unzlocal_ReadLz4 OF((file_in_zip_read_info_s* info,
+                               voidp buf,
+                               unsigned len));
+
+local int unzlocal_ReadLz4 (info, buf, len)
+    file_in_zip_read_info_s* info;
+    voidp buf;
+    unsigned len;
+{
+    unsigned char header[LBG_LZ4_BLOCK_HEADER];
+    uInt iRead = 0;
+    uInt uDoCopy;
+    uLong uBlock;
+    int stored;
+    int size;
+
+    if (len>info->rest_read_uncompressed)
+        len = (unsigned)info->rest_read_uncompressed;
+
+    while (iRead<len)
+    {
+        if (info->lz4_out_pos==info->lz4_out_len)
+        {
+            /* decode the next block */
+            if (info->rest_read_compressed<LBG_LZ4_BLOCK_HEADER)
+                return UNZ_BADZIPFILE;
+            if (ZSEEK(info->z_filefunc, info->filestream,
+                      info->pos_in_zipfile + info->byte_before_the_zipfile,
+                      ZLIB_FILEFUNC_SEEK_SET)!=0)
+                return UNZ_ERRNO;
+            if (unzlocal_getRecord(&info->z_filefunc, info->filestream,
+                                   header, LBG_LZ4_BLOCK_HEADER)!=UNZ_OK)
+                return UNZ_ERRNO;
+
+            uBlock = unzlocal_bufLong(header);
+            stored = (uBlock & LBG_LZ4_STORED)!=0;
+            uBlock &= ~(uLong)LBG_LZ4_STORED;
+            if ((uBlock>info->rest_read_compressed-LBG_LZ4_BLOCK_HEADER) ||
+                (uBlock>(stored ? LBG_LZ4_BLOCK_SIZE
+                                : LBG_LZ4_BOUND(LBG_LZ4_BLOCK_SIZE))))
+                return UNZ_BADZIPFILE;
+
+            if (ZREAD(info->z_filefunc, info->filestream,
+                      stored ? info->lz4_out : info->lz4_in,
+                      uBlock)!=uBlock)
+                return UNZ_ERRNO;
+
+            size = (int)uBlock;
+            if (!stored)
+                size = LBG_LZ4Decompress(info->lz4_in, (int)uBlock,
+                                         info->lz4_out, LBG_LZ4_BLOCK_SIZE);
+            if (size<=0)
+                return Z_DATA_ERROR;
+
+            info->pos_in_zipfile += LBG_LZ4_BLOCK_HEADER + uBlock;
+            info->rest_read_compressed -= LBG_LZ4_BLOCK_HEADER + uBlock;
+            info->lz4_out_pos = 0;
+            info->lz4_out_len = (uInt)size;
+        }
+
+        uDoCopy = info->lz4_out_len - info->lz4_out_pos;
+        if (uDoCopy>len-iRead)
+            uDoCopy = len-iRead;
+        memcpy((Bytef*)buf+iRead, info->lz4_out+info->lz4_out_pos, uDoCopy);
+
+        info->crc32 = crc32(info->crc32, (Bytef*)buf+iRead, uDoCopy);
+        info->lz4_out_pos += uDoCopy;
+        info->rest_read_uncompressed -= uDoCopy;
+        info->stream.total_out += uDoCopy;
+        iRead += uDoCopy;
+    }
+    return iRead;
+}
+
 /*
   Read bytes from the current file.
   buf contain buffer where data must be copied
@@ -1241,6 +1509,10 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
     if (len==0)
         return 0;
 
+    if ((pfile_in_zip_read_info->compression_method==LBG_LZ4_METHOD) &&
+        (!pfile_in_zip_read_info->raw))
+        return unzlocal_ReadLz4(pfile_in_zip_read_info, buf, len);
+
     pfile_in_zip_read_info->stream.next_out = (Bytef*)buf;
 
     pfile_in_zip_read_info->stream.avail_out = (uInt)len;
@@ -1396,6 +1668,27 @@ extern z_off_t ZEXPORT unztell (file)
 }
 
 
+/*
+  Give the offset in the zip file of the data of the current file not read yet
+*/
+extern uLong ZEXPORT unzGetCurrentFileZStreamPos (file)
+    unzFile file;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+    if (file==NULL)
+        return 0;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info==NULL)
+        return 0;
+
+    return pfile_in_zip_read_info->pos_in_zipfile +
+           pfile_in_zip_read_info->byte_before_the_zipfile;
+}
+
+
 /*
   return 1 if the end of file was reached, 0 elsewhere
 */
@@ -1507,13 +1800,8 @@ extern int ZEXPORT unzCloseCurrentFile (file)
     }
 
 
-    TRYFREE(pfile_in_zip_read_info->read_buffer);
-    pfile_in_zip_read_info->read_buffer = NULL;
-    if (pfile_in_zip_read_info->stream_initialised)
-        inflateEnd(&pfile_in_zip_read_info->stream);
-
-    pfile_in_zip_read_info->stream_initialised = 0;
-    TRYFREE(pfile_in_zip_read_info);
+    /* the read buffer & inflate state are kept for the next file opened */
+    unzlocal_ReleaseContext(pfile_in_zip_read_info);
 
     s->pfile_in_zip_read=NULL;
 
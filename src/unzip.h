@@ -319,6 +319,14 @@ extern int ZEXPORT unzeof OF((unzFile file));
   return 1 if the end of file was reached, 0 elsewhere
 */
 
+extern uLong ZEXPORT unzGetCurrentFileZStreamPos OF((unzFile file));
+/*
+  Give the offset, in the zip file, of the (compressed) data of the current
+    file that has not been read yet. Just after unzOpenCurrentFile this is
+    the start of the file data.
+  return 0 if no file is opened
+*/
+
 extern int ZEXPORT unzGetLocalExtrafield OF((unzFile file,
                                              voidp buf,
                                              unsigned len));
@@ -335,6 +343,42 @@ extern int ZEXPORT unzGetLocalExtrafield OF((unzFile file,
     the error code
 */
 
+/***************************************************************************/
+/* Pool of read contexts shared by every unzFile */
+
+typedef void (ZCALLBACK *unz_lock_func) OF((voidpf opaque));
+
+extern void ZEXPORT unzSetContextPoolLock OF((unz_lock_func lock,
+                                              unz_lock_func unlock,
+                                              voidpf opaque));
+/*
+  The read buffer and inflate state of a file are kept when it is closed, and
+    reused (after an inflateReset) by the next file opened with any unzFile.
+  If several threads open or close files at the same time, set a lock 
+    (a mutex) for the pool before opening any file.  lock and unlock are 
+    called with opaque.
+*/
+
+extern void ZEXPORT unzFreeContextPool OF((void));
+/*
+  Free the read contexts kept in the pool.  Files still open keep theirs.
+*/
+
+extern void ZEXPORT unzGetContextPoolStats OF((uLong* pcreated,
+                                               uLong* preused));
+/*
+  Give the number of read contexts allocated so far, and the number of times
+    a file was opened with a context from the pool instead.
+*/
+
+#ifdef MM_PROFILE
+extern void ZEXPORT unzSetRecordReads OF((int on));
+/*
+  1 (the default) to read zip headers as whole records, 0 to read them a byte
+    at a time as unzip used to.  For benchmarks only.
+*/
+#endif
+
 /***************************************************************************/
 
 /* Get the current file offset */
@@ -3,63 +3,327 @@
 //  Zip Manager
 //
 //  Description:
-//  This class manages the zip archive used to hold all program resources.
-//  All classes wishing to access data in the resource file must use this
+//  This class manages the zip archives used to hold all program resources.
+//  All classes wishing to access data in the resource files must use this
 //  class as an interface.  It should be easy to modify this class to load
 //  files straight from a disk for systems where zip files support does not
 //  exists (or for which the zip source code is not readily available)
+//
+//  data.lbg holds the files shared by every part of the game, each level
+//  may have an archive of its own holding the files only it uses.  Any set
+//  of archives can be opened at once, files are looked up in the level 
+//  archives first, then in data.lbg.  A level archive that does not exist
+//  is skipped, so its files can just as well be left in data.lbg.
+//
+//  The archives are opened 1X by ZIP_Init and stay open (along with the
+//  filename index of their central directories) until ZIP_Quit.  
+//  ZIP_OpenZipFile & ZIP_CloseZipFile only mark the start and end of a 
+//  session, and pick which of the open archives files are looked up in.
+//
+//  ZIP_GetImage & ZIP_GetMusic load through a cache of decoded images and
+//  sounds, so screens entered again and again (the main menu) do not 
+//  inflate & decode the same files every time.  Cached assets are shared
+//  and counted, each ZIP_Get... must be matched by a ZIP_Release... .  
+//  Released assets stay cached until the cache goes over its budget, then
+//  the least recently used are freed.  ZIP_ReadImage & ZIP_ReadMusic load
+//  without the cache, for callers that keep (and free) assets themselves.
+//
+//  Fonts are shared the same way, each font file is inflated once and each
+//  size & style of it opened once.  ZIP_CloseFont only hands a font back,
+//  fonts no longer used stay open until ZIP_FlushCache (or ZIP_Quit).
+//  Strings rendered with ZIP_RenderText are cached too (up to TEXT_BUDGET
+//  bytes), until their font is closed.
 //-----------------------------------------------------------------------------
 
 
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <unzip.h>
 #include "SDL.h"
 #include "SDL_image.h"
 #include "SDL_mixer.h"
+#include "SDL_mutex.h"
 #include "zip_manager.h"
 #include "eh_manager.h"
+#include "lbg_image.h"
+#include "common.h"
+#ifdef MM_PROFILE
+#include "lbg_lz4.h"
+#endif
 
 
 #define MAX_PATH                255
 #define RESOURCE_FILE    "data.lbg"
+#define LEVEL1_FILE      "level1.lbg"
+#define NUM_ARCHIVES              2
+#define MIN_INDEX_SIZE           64
+#define SKIP_BUFFER_SIZE        512
+#define TRACE_FILE  "load_trace.txt"
+#define CACHE_SLOTS             128
+#define MAX_FONT_FILES            4
+#define CACHE_BUDGET  (4*1024*1024)     // bytes of decoded assets kept
+#define TEXT_SLOTS               64
+#define TEXT_LENGTH             128     // longer strings are not cached
+#define TEXT_BUDGET     (512*1024)      // bytes of rendered text kept
+#define ERROR_LENGTH             96
 
-static unzFile _zipFile;
-static int _fileOpen;
-static void *LoadZipData(const char *filename, unzFile *zip, int *size);
+// Kinds of asset held by the cache.  Images are keyed on the ZIP_IMG_xxx
+// flags they were prepared with, so the same file loaded with different
+// flags is cached once for each.
+#define CACHE_IMAGE               0     // image as loaded
+#define CACHE_SCREEN_IMAGE        ZIP_IMG_SCREEN  // converted to screen format
+#define CACHE_TRANSP_IMAGE        ZIP_IMG_TRANSP  // transparent colorkey set
+#define CACHE_SOUND               4
+
+// One slot in the filename index.  The index is an open addressed hash table
+// (linear probing) keyed on the lower case filename, built 1X when the 
+// archives are opened so a lookup no longer has to walk the central 
+// directory.  Names are kept back to back in 1 block (_indexNames).
+typedef struct ZipIndexEntry
+{
+  unsigned int  name;     // offset of name in _indexNames
+  unsigned int  hash;
+  unsigned int  archives; // bit x set if _archives[x] holds entry, 0 if empty
+  unz_file_pos  pos[NUM_ARCHIVES]; // position of entry in each central dir.
+} ZipIndexEntry;
+
+// A font file inflated 1X and shared by every size & style opened from it
+typedef struct ZipFontFile
+{
+  char name[MAX_PATH];
+  void *data;             // 0 if slot is free
+  int  size;
+} ZipFontFile;
+
+// One decoded image or sound in the asset cache, keyed by the name of the
+// file, the archive it came from & the kind of asset it was loaded as
+typedef struct ZipCacheEntry
+{
+  void         *item;     // SDL_Surface or Mix_Chunk, 0 if slot is free
+  char         name[MAX_PATH];
+  unsigned int hash;      // HashName(name)
+  int          archive;   // index in _archives of archive file came from
+  int          kind;      // CACHE_xxx
+  unsigned int bytes;     // size of decoded pixels or samples
+  unsigned int refs;      // ZIP_Get... calls not yet released
+  unsigned int lastUsed;  // _cacheTick when last handed out
+} ZipCacheEntry;
+
+// One string rendered by ZIP_RenderText, keyed by the font (which stands for
+// the font file, size & style), the colour & the string itself
+typedef struct ZipTextEntry
+{
+  SDL_Surface  *img;      // 0 if slot is free
+  ZIP_Font     *font;     // 0 once the font is closed, img is then freed
+  Uint32       color;     // r, g, b packed as 0x00RRGGBB
+  unsigned int hash;      // HashName(text)
+  char         text[TEXT_LENGTH];
+  unsigned int bytes;     // size of img's pixels
+  unsigned int refs;      // ZIP_RenderText calls not yet released
+  unsigned int lastUsed;  // _textTick when last handed out
+} ZipTextEntry;
+
+// An archive ZIP_OpenZipFile can open
+typedef struct ZipArchive
+{
+  unsigned int id;       // ZIP_MAIN, ZIP_LEVEL1...
+  const char   *name;    // file name of archive
+} ZipArchive;
+
+// State of an SDL_RWops that inflates a zip entry as it is read
+typedef struct ZipStream
+{
+  unzFile       zip;     // zip file with the entry open as its current file
+  unsigned long size;    // uncompressed size of entry
+  unsigned long offset;  // current position in uncompressed data
+} ZipStream;
+
+// Handles on each open archive.  The zip manager has 1, each thread loading
+// resources at the same time uses another (see ZIP_OpenReader)
+struct ZIP_Reader
+{
+  unzFile zip[NUM_ARCHIVES];       // 0 if the archive is not open
+  int     backend[NUM_ARCHIVES];   // IO backend each archive was opened with
+  char    error[ERROR_LENGTH];     // why the last load failed, "" if it did not
+  struct ZIP_Reader *next;         // next closed reader in _freeReaders
+};
+
+// Archives in the order files are looked up, level archives come before 
+// data.lbg so a level can replace a shared file with its own copy
+static const ZipArchive _archives[NUM_ARCHIVES] =
+{
+  { ZIP_LEVEL1, LEVEL1_FILE   },
+  { ZIP_MAIN,   RESOURCE_FILE }
+};
+
+static ZIP_Reader _zipFile;
+static int _resident;                   // set while the archives are open
+static int _residentBackend;            // backend they were opened with
+static unsigned int _openFiles;         // ZIP_xxx IDs passed to ZIP_OpenZipFile
+#ifdef __psp__
+static int _ioBackend = ZIP_IO_STDIO;   // no mmap, archives would be malloced
+#else
+static int _ioBackend = ZIP_IO_MEMORY;  // backend to try first
+#endif
+static ZipIndexEntry *_index;
+static unsigned int  _indexSize;
+static char          *_indexNames;
+static ZIP_Reader    *_freeReaders;     // readers kept open for reuse
+static ZIP_Stats     _stats;
+static SDL_mutex     *_poolLock;        // guards unzip's read context pool
+static ZipCacheEntry _cache[CACHE_SLOTS];
+static unsigned int  _cacheBytes;       // bytes held by the cache
+static unsigned int  _cacheBudget = CACHE_BUDGET;
+static unsigned int  _cacheTick;
+static SDL_mutex     *_cacheLock;       // load threads use the cache too
+static ZipFontFile   _fontFiles[MAX_FONT_FILES];
+static ZIP_Font      *_fonts;           // every font open, in use or not
+static ZipTextEntry  _text[TEXT_SLOTS];
+static unsigned int  _textBytes;        // bytes held by the text cache
+static unsigned int  _textTick;
+#ifdef MM_TRACE_LOADS
+static FILE          *_trace;           // names of files in the order loaded
+static SDL_mutex     *_traceLock;
+#endif
+
+static void *LoadZipData(const char *filename, ZIP_Reader *r, int *size);
+static int  OpenZipEntry(const char *filename, ZIP_Reader *r, unz_file_info *zinfo);
+static void *ReadZipEntry(unzFile *zip, unz_file_info *zinfo);
+static SDL_RWops *OpenZipRW(ZIP_Reader *r, const char *filename);
+static SDL_Surface *ReadImage(ZIP_Reader *r, const char *img);
+static Mix_Chunk *ReadMusic(ZIP_Reader *r, const char *name);
+static int LoadBakedImage(ZIP_Reader *r, SDL_RWops *rw, const char *img,
+                          SDL_Surface **image);
+static int ZipStreamSeek(SDL_RWops *context, int offset, int whence);
+static int ZipStreamRead(SDL_RWops *context, void *ptr, int size, int maxnum);
+static int ZipStreamWrite(SDL_RWops *context, const void *ptr, int size, int num);
+static int ZipStreamClose(SDL_RWops *context);
+static unzFile OpenArchive(const char *filename, int *backend);
+static void CloseArchives(ZIP_Reader *r);
+static int  OpenResident();
+static void CloseResident();
+static void ZCALLBACK LockContextPool(voidpf lock);
+static void ZCALLBACK UnlockContextPool(voidpf lock);
+static unsigned int HashName(const char *name);
+static void BuildIndex(ZIP_Reader *r);
+static void FreeIndex();
+static int  FindFileHashed(const char *filename, ZIP_Reader *r);
+static int  FindFileLinear(const char *filename, ZIP_Reader *r);
+static int  FindFileInArchive(const char *filename, unzFile zip);
+static void *GetCached(ZIP_Reader *r, const char *name, int kind);
+static void *LoadCacheItem(ZIP_Reader *r, const char *name, int kind, 
+                           unsigned int *bytes);
+static SDL_Surface *PrepareImage(SDL_Surface *img, int flags);
+static void ReleaseCached(void *item, int sound);
+static ZipCacheEntry *FindCached(unsigned int hash, const char *name, 
+                                 int archive, int kind);
+static void EvictCached(unsigned int budget);
+static ZipCacheEntry *EvictOne();
+static void FreeCacheItem(void *item, int kind);
+static ZipFontFile *OpenFontFile(const char *name);
+static void CloseFontFile(void *data);
+static ZipTextEntry *FindText(ZIP_Font *font, Uint32 color, 
+                              unsigned int hash, const char *text);
+static void EvictText(unsigned int budget);
+static ZipTextEntry *EvictOneText();
+static void DropFontText(ZIP_Font *font);
+static void CloseFont(ZIP_Font *z);
+static void FlushFonts();
+static void LoadError(ZIP_Reader *r, const char *format, ...);
+#ifdef MM_TRACE_LOADS
+static void TraceLoad(const char *filename);
+#endif
 
 //------------------------------------------------------------------------------
+// Name:     ZIP_Init
+// Summary:  Called 1X, opens every archive and indexes their central 
+//           directories.  They stay open for the rest of the game.
+// Inputs:   None
+// Outputs:  None
+// Returns:  Status value of 0 on success, non-zero on error
+// Cautions: If this fails, the first ZIP_OpenZipFile tries again
+//------------------------------------------------------------------------------
+int ZIP_Init()
+{
+  // load threads open & close zip entries at the same time, so unzip's 
+  // pool of read contexts must be locked
+  if (_poolLock == 0)
+  {
+    _poolLock = SDL_CreateMutex();
+    if (_poolLock)
+      unzSetContextPoolLock(LockContextPool, UnlockContextPool, _poolLock);
+  }
+  if (_cacheLock == 0)
+    _cacheLock = SDL_CreateMutex();
+#ifdef MM_TRACE_LOADS
+  if (_trace == 0)
+  {
+    _trace     = fopen(TRACE_FILE, "w");
+    _traceLock = SDL_CreateMutex();
+  }
+#endif
+  return(OpenResident());
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_Quit
+// Summary:  Closes the archives opened by ZIP_Init
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Ends any open session.  Nothing may be loaded afterwards.
+//------------------------------------------------------------------------------
+void ZIP_Quit()
+{
+  _openFiles = 0;
+  ZIP_FlushCache();
+  CloseResident();
+  unzFreeContextPool();
+#ifdef MM_TRACE_LOADS
+  if (_trace)
+    fclose(_trace);
+  if (_traceLock)
+    SDL_DestroyMutex(_traceLock);
+  _trace     = 0;
+  _traceLock = 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
 // Name:     ZIP_OpenZipFile
-// Summary:  Opens the specified ZIP file for use
-// Inputs:   ID of zip file you wish to open (only 1 exists, but the framework
-//           for multiple zip files is present)
+// Summary:  Starts a session on the specified ZIP files, files are looked up
+//           in them until ZIP_CloseZipFile
+// Inputs:   IDs of zip files you wish to open, ORed together (ZIP_MAIN, 
+//           ZIP_LEVEL1...)
 // Outputs:  None
-// Returns:  Status value of 0 on success, non-zero on error
-// Cautions: None
+// Returns:  Status value of 0 on success, non-zero on error (3 if data.lbg
+//           could not be opened, no session is started then)
+// Cautions: Level archives that do not exist are skipped, their files are
+//           then loaded from data.lbg (if ZIP_MAIN was opened).  The 
+//           archives are only really opened here if ZIP_Init failed or the
+//           IO backend has been changed since they were.
 //------------------------------------------------------------------------------
-int ZIP_OpenZipFile(unsigned int file)
+int ZIP_OpenZipFile(unsigned int files)
 {
   int status = 0;
 
-  if (_fileOpen)
+  if (_openFiles)
   {
     status = 1;
   }
-  else
+  else if (files == 0 || (files & ~ZIP_ALL))
   {
-    switch(file)
-    {
-       case ZIP_MAIN:
-       _zipFile = unzOpen(RESOURCE_FILE);
-       break;
-       
-       default:
-       status = 2;
-       break;
-    } 
+    status = 2;
   }
-  
-  if (!(status))
+  else if ((!_resident || _residentBackend != _ioBackend) && OpenResident())
   {
-    _fileOpen = 1;
+    status = 3;
+  }
+  else
+  {
+    _openFiles = files;
+    _stats.sessions++;
   }
     
   return(status);
@@ -67,19 +331,18 @@ int ZIP_OpenZipFile(unsigned int file)
 
 //------------------------------------------------------------------------------
 // Name:     ZIP_CloseZipFile
-// Summary:  Closes the specified zip file
+// Summary:  Ends the session started by ZIP_OpenZipFile
 // Inputs:   None
 // Outputs:  None
 // Returns:  Status value of 0 on success, non-zero on error
-// Cautions: None
+// Cautions: The archives themselves stay open (see ZIP_Quit)
 //------------------------------------------------------------------------------
 int ZIP_CloseZipFile()
 {
   int status = 0;
-  if (_fileOpen)
+  if (_openFiles)
   {
-    unzClose(_zipFile);
-    _fileOpen = 0;
+    _openFiles = 0;
   }
   else
   {
@@ -88,61 +351,462 @@ int ZIP_CloseZipFile()
   return(status);
 }
 
+//------------------------------------------------------------------------------
+// Name:     ZIP_GetStats
+// Summary:  Returns how many sessions have been opened, how many times an
+//           archive was really opened (and its central directory read), how
+//           many entries were opened with a new or a reused read context, and
+//           how the asset & text caches are doing
+// Inputs:   None
+// Outputs:  stats - counters since the game started
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void ZIP_GetStats(ZIP_Stats *stats)
+{
+  uLong created, reused;
+  
+  unzGetContextPoolStats(&created, &reused);
+  if (_cacheLock)
+    SDL_mutexP(_cacheLock);
+  *stats                 = _stats;
+  stats->cacheBytes      = _cacheBytes;
+  if (_cacheLock)
+    SDL_mutexV(_cacheLock);
+  stats->textBytes       = _textBytes;
+  stats->contextsCreated = created;
+  stats->contextsReused  = reused;
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_SetIoBackend
+// Summary:  Selects how zip files opened from now on are read.  ZIP_IO_MEMORY
+//           keeps the whole archive in memory (mapped where possible) so 
+//           reads are simple memory copies, ZIP_IO_STDIO reads through the
+//           C library file functions.
+// Inputs:   ZIP_IO_MEMORY or ZIP_IO_STDIO
+// Outputs:  None
+// Returns:  The backend that was selected before this call
+// Cautions: Does not affect a zip file that is already open.  If the memory
+//           backend can not be used, the stdio backend is used instead.
+//           The PSP defaults to stdio, it has no mmap so the memory backend
+//           would read each archive onto the heap (see ioapi.h).
+//------------------------------------------------------------------------------
+int ZIP_SetIoBackend(int backend)
+{
+  int old    = _ioBackend;
+  _ioBackend = backend;
+  return(old);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_GetIoBackend
+// Summary:  Returns the backend being used to read the open zip files
+// Inputs:   None
+// Outputs:  None
+// Returns:  ZIP_IO_MEMORY or ZIP_IO_STDIO (if any open file uses stdio)
+// Cautions: Value is meaningless if no zip file is open
+//------------------------------------------------------------------------------
+int ZIP_GetIoBackend()
+{
+  int backend = ZIP_IO_MEMORY;
+  int x;
+  
+  for (x=0; x < NUM_ARCHIVES; x++)
+    if (_zipFile.zip[x] && (_openFiles & _archives[x].id) &&
+        _zipFile.backend[x] == ZIP_IO_STDIO)
+      backend = ZIP_IO_STDIO;
+  return(backend);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_GetOpenZipFiles
+// Summary:  Returns the IDs of the zip files opened by ZIP_OpenZipFile
+// Inputs:   None
+// Outputs:  None
+// Returns:  IDs of open zip files ORed together, 0 if none are open
+// Cautions: Includes level archives skipped because they do not exist
+//------------------------------------------------------------------------------
+unsigned int ZIP_GetOpenZipFiles()
+{
+  return(_openFiles);
+}
+
 //------------------------------------------------------------------------------
 // Name:     ZIP_LoadImage
 // Summary:  Loads an image from the ZIP file and stores it into an SDL_Surface
 // Inputs:   Name of file to extract from zip
 // Outputs:  None
-// Returns:  SDL_Surface pointer to image data loaded from zip
-// Cautions: None
+// Returns:  SDL_Surface pointer to image data loaded from zip, 0 on error
+// Cautions: Failures are reported as warnings
 //------------------------------------------------------------------------------
 SDL_Surface *ZIP_LoadImage(const char *img)
 {
-  int size;
-  SDL_Surface *image;
-  void *data = LoadZipData(img, &_zipFile, &size);
-  if (data)
+  return(ReadImage(&_zipFile, img));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_LoadMusic
+// Summary:  Loads the specified SFX and stores it into Mix_Chunk
+// Inputs:   Name of file to extract from zip
+// Outputs:  None
+// Returns:  Mix_Chunk pointer to sfx data loaded from zip, 0 on error
+// Cautions: Failures are reported as warnings
+//------------------------------------------------------------------------------
+Mix_Chunk *ZIP_LoadMusic(const char *name)
+{
+  return(ReadMusic(&_zipFile, name));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_OpenReader
+// Summary:  Returns an extra handle on each open zip file.  Each thread 
+//           loading resources at the same time needs a reader of its own.
+// Inputs:   None
+// Outputs:  None
+// Returns:  Pointer to reader, 0 on error
+// Cautions: Open & close readers from the main thread only, and close them
+//           before the zip files are closed.  A reader can only be used by 1
+//           thread at a time.  Loads that fail through a reader are not
+//           reported, see ZIP_GetReaderError.
+//------------------------------------------------------------------------------
+ZIP_Reader *ZIP_OpenReader()
+{
+  ZIP_Reader *r = 0;
+  int x;
+  
+  if (!_openFiles)
+    return(0);
+    
+  // closed readers are kept open on the archives, reuse one if we can
+  if (_freeReaders)
+  {
+    r            = _freeReaders;
+    _freeReaders = r->next;
+    r->next      = 0;
+    return(r);
+  }
+  
+  r = (ZIP_Reader *) calloc(1, sizeof(ZIP_Reader));
+  for (x=0; r && x < NUM_ARCHIVES; x++)
+  {
+    if (_zipFile.zip[x] == 0)
+      continue;
+    r->backend[x] = _zipFile.backend[x];
+    r->zip[x]     = OpenArchive(_archives[x].name, &r->backend[x]);
+    if (r->zip[x] == 0)
+    {
+      CloseArchives(r);
+      free(r);
+      r = 0;
+    }
+  }
+  return(r);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_CloseReader
+// Summary:  Closes a reader opened with ZIP_OpenReader
+// Inputs:   Reader to close
+// Outputs:  None
+// Returns:  None
+// Cautions: The reader's archives stay open until ZIP_Quit so the next 
+//           ZIP_OpenReader can hand it out again
+//------------------------------------------------------------------------------
+void ZIP_CloseReader(ZIP_Reader *r)
+{
+  if (r)
+  {
+    r->next      = _freeReaders;
+    _freeReaders = r;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_GetReaderError
+// Summary:  Returns why the last load through a reader failed
+// Inputs:   Reader
+// Outputs:  None
+// Returns:  Message, "" if the last load did not fail
+// Cautions: Loads through a reader are not reported to the error handler 
+//           (load threads must not use it), the thread that opened the 
+//           reader reports them
+//------------------------------------------------------------------------------
+const char *ZIP_GetReaderError(ZIP_Reader *r)
+{
+  return(r->error);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ReadImage
+// Summary:  Same as ZIP_GetImage, but the image is not cached
+// Inputs:   1. r - reader to load with, 0 for the zip manager's own handle
+//           2. img - name of file to extract from zip
+//           3. flags - ZIP_IMG_xxx, see ZIP_GetImage
+// Outputs:  None
+// Returns:  SDL_Surface pointer to image data loaded from zip, 0 on error
+// Cautions: The surface belongs to the caller, free it with SDL_FreeSurface
+//------------------------------------------------------------------------------
+SDL_Surface *ZIP_ReadImage(ZIP_Reader *r, const char *img, int flags)
+{
+  return(PrepareImage(ReadImage(r ? r : &_zipFile, img), flags));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ReadMusic
+// Summary:  Same as ZIP_GetMusic, but the SFX is not cached
+// Inputs:   1. r - reader to load with, 0 for the zip manager's own handle
+//           2. name - name of file to extract from zip
+// Outputs:  None
+// Returns:  Mix_Chunk pointer to sfx data loaded from zip, 0 on error
+// Cautions: The chunk belongs to the caller, free it with Mix_FreeChunk
+//------------------------------------------------------------------------------
+Mix_Chunk *ZIP_ReadMusic(ZIP_Reader *r, const char *name)
+{
+  return(ReadMusic(r ? r : &_zipFile, name));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_GetImage
+// Summary:  Returns an image from the asset cache, loading it if it is not
+//           cached yet
+// Inputs:   1. r - reader to load with, 0 for the zip manager's own handle
+//           2. img - name of file to extract from zip
+//           3. flags - ZIP_IMG_SCREEN to convert the image to the screen's
+//              format (baked images allready are), ZIP_IMG_TRANSP to set the
+//              transparent colorkey
+// Outputs:  None
+// Returns:  SDL_Surface pointer to image, 0 on error
+// Cautions: The surface is shared by every caller asking for the same 
+//           flags, do not free it (use ZIP_ReleaseImage) or change its 
+//           pixels.  Anything else done to it (colorkey, alpha) is seen by
+//           those callers too.
+//------------------------------------------------------------------------------
+SDL_Surface *ZIP_GetImage(ZIP_Reader *r, const char *img, int flags)
+{
+  return((SDL_Surface *) GetCached(r, img, 
+                                   flags & (ZIP_IMG_SCREEN | ZIP_IMG_TRANSP)));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_GetMusic
+// Summary:  Returns a SFX from the asset cache, loading it if it is not
+//           cached yet
+// Inputs:   1. r - reader to load with, 0 for the zip manager's own handle
+//           2. name - name of file to extract from zip
+// Outputs:  None
+// Returns:  Mix_Chunk pointer to sfx, 0 on error
+// Cautions: The chunk is shared, do not free it (use ZIP_ReleaseMusic)
+//------------------------------------------------------------------------------
+Mix_Chunk *ZIP_GetMusic(ZIP_Reader *r, const char *name)
+{
+  return((Mix_Chunk *) GetCached(r, name, CACHE_SOUND));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ReleaseImage
+// Summary:  Hands back an image returned by ZIP_GetImage
+// Inputs:   Image to release (may be 0)
+// Outputs:  None
+// Returns:  None
+// Cautions: Images that could not be cached are freed
+//------------------------------------------------------------------------------
+void ZIP_ReleaseImage(SDL_Surface *img)
+{
+  ReleaseCached(img, 0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ReleaseMusic
+// Summary:  Hands back a SFX returned by ZIP_GetMusic
+// Inputs:   SFX to release (may be 0)
+// Outputs:  None
+// Returns:  None
+// Cautions: Sounds that could not be cached are freed
+//------------------------------------------------------------------------------
+void ZIP_ReleaseMusic(Mix_Chunk *sound)
+{
+  ReleaseCached(sound, 1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_SetCacheBudget
+// Summary:  Sets how many bytes of decoded assets the cache may hold
+// Inputs:   Budget in bytes
+// Outputs:  None
+// Returns:  Budget before this call
+// Cautions: Assets in use are never freed, so the cache may go over budget
+//           until they are released
+//------------------------------------------------------------------------------
+unsigned int ZIP_SetCacheBudget(unsigned int bytes)
+{
+  unsigned int old = _cacheBudget;
+  
+  if (_cacheLock)
+    SDL_mutexP(_cacheLock);
+  _cacheBudget = bytes;
+  EvictCached(_cacheBudget);
+  if (_cacheLock)
+    SDL_mutexV(_cacheLock);
+  return(old);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_FlushCache
+// Summary:  Frees every cached asset, rendered string & font not in use
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Main thread only (rendered strings & fonts are not locked)
+//------------------------------------------------------------------------------
+void ZIP_FlushCache()
+{
+  if (_cacheLock)
+    SDL_mutexP(_cacheLock);
+  EvictCached(0);
+  if (_cacheLock)
+    SDL_mutexV(_cacheLock);
+  EvictText(0);
+  FlushFonts();
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadImage
+// Summary:  Loads an image from the given zip handles into an SDL_Surface
+// Inputs:   1. Zip handles to load from
+//           2. Name of file to extract from zip
+// Outputs:  None
+// Returns:  SDL_Surface pointer to image data loaded from zip, 0 on error
+// Cautions: Failures are reported as warnings (see LoadError), the caller
+//           decides what to do without the image
+//------------------------------------------------------------------------------
+SDL_Surface *ReadImage(ZIP_Reader *r, const char *img)
+{
+  SDL_Surface *image = 0;
+  SDL_RWops *zipRw;
+  
+  r->error[0] = 0;
+  zipRw       = OpenZipRW(r, img);
+  if (zipRw)
   {
-    SDL_RWops *zipRw = SDL_RWFromConstMem(data, size);
-    if (zipRw)
+    // Images baked by lbg_bake are allready in screen format, everything 
+    // else goes through SDL_image
+    if (LoadBakedImage(r, zipRw, img, &image))
+    {
+      SDL_RWclose(zipRw);  // a bad baked image has allready been reported
+    }
+    else  // 1 means free the RWops after the surface is created 
     {
-      // 1 means free data after the surface is created 
       image = IMG_Load_RW(zipRw, 1);  
       if (image == 0)
-        EH_Error(EH_SEVERE,  
-                 "LBG_LoadImage(image): Could not load file %s.", img); 
-        
+        LoadError(r, "LBG_LoadImage(image): Could not load file %s.\n", img); 
     }
-    else
+  }
+  return(image);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LoadBakedImage
+// Summary:  Creates an SDL_Surface from an image baked by lbg_bake (see 
+//           lbg_image.h).  The pixels are read straight into the surface.
+// Inputs:   1. Zip handles the image is loaded with (for LoadError)
+//           2. RWops positioned at the start of the image file
+//           3. Name of the file (for LoadError)
+// Outputs:  4. SDL_Surface in screen format, 0 if the baked image is bad
+// Returns:  1 if the file is a baked image, 0 if not (the RWops is rewound
+//           to the start of the file and the output is not set)
+// Cautions: Does not close the RWops.  A bad baked image is reported as a
+//           warning, it is not passed on to SDL_image.
+//------------------------------------------------------------------------------
+int LoadBakedImage(ZIP_Reader *r, SDL_RWops *rw, const char *img,
+                   SDL_Surface **image)
+{
+  unsigned char hdr[LBG_IMG_HEADER_SIZE];
+  int w, h, pitch, flags, y, ok;
+  
+  #define HDR_SHORT(ofs) (hdr[ofs] | (hdr[(ofs)+1] << 8))
+  
+  if (SDL_RWread(rw, hdr, LBG_IMG_HEADER_SIZE, 1) != 1 ||
+      memcmp(hdr, LBG_IMG_MAGIC, 4) != 0)
+  {
+    SDL_RWseek(rw, 0, RW_SEEK_SET);
+    return(0);
+  }
+  
+  w     = HDR_SHORT(LBG_IMG_OFS_WIDTH);
+  h     = HDR_SHORT(LBG_IMG_OFS_HEIGHT);
+  pitch = HDR_SHORT(LBG_IMG_OFS_PITCH);
+  flags = HDR_SHORT(LBG_IMG_OFS_FLAGS);
+  
+  *image = 0;
+  if (w == 0 || h == 0 || pitch < w * 2)
+  {
+    LoadError(r, "LoadBakedImage: Bad image %s, w=%i, h=%i, pitch=%i.\n", 
+              img, w, h, pitch);
+    return(1);
+  }
+  
+  *image = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, LBG_IMG_BPP, 
+                                LBG_IMG_RMASK, LBG_IMG_GMASK, 
+                                LBG_IMG_BMASK, LBG_IMG_AMASK);
+  if (*image == 0)
+  {
+    LoadError(r, "LoadBakedImage: Could not create %ix%i surface for %s.\n",
+              w, h, img);
+    return(1);
+  }
+  
+  if (pitch == (*image)->pitch)
+  {
+    ok = SDL_RWread(rw, (*image)->pixels, pitch, h) == h;
+  }
+  else  // row padding differs, read 1 row at a time
+  {
+    for (y=0, ok=1; ok && y < h; y++)
     {
-      EH_Error(EH_SEVERE, 
-               "LBG_LoadImage(zipRw): Could not load file %s.", img); 
+      ok = SDL_RWread(rw, (unsigned char *) (*image)->pixels + 
+                      y * (*image)->pitch, w * 2, 1) == 1;
+      SDL_RWseek(rw, pitch - w * 2, RW_SEEK_CUR);
     }
   }
-  else
+  
+  if (!ok)  // file is shorter than the header says
   {
-    EH_Error(EH_SEVERE, "LBG_LoadImage(data): Could not load file %s.", img); 
+    SDL_FreeSurface(*image);
+    *image = 0;
+    LoadError(r, "LoadBakedImage: Bad image %s, pixel data is short.\n", img);
+    return(1);
   }
-  free(data);
-  return(image);
+  
+  if (flags & LBG_IMG_COLORKEY)
+    SDL_SetColorKey(*image, SDL_SRCCOLORKEY, HDR_SHORT(LBG_IMG_OFS_COLORKEY));
+  
+  #undef HDR_SHORT
+  return(1);
 }
 
-//------------------------------------------------------------------------------
-// Name:     ZIP_LoadMusic
-// Summary:  Loads the specified SFX and stores it into Mix_Chunk
-// Inputs:   Name of file to extract from zip
-// Outputs:  None
-// Returns:  Mix_Chunk pointer to sfx data loaded from zip
-// Cautions: None
 //------------------------------------------------------------------------------
-Mix_Chunk *ZIP_LoadMusic(const char *name)
+// Name:     ReadMusic
+// Summary:  Loads the specified SFX from the given zip handles into Mix_Chunk
+// Inputs:   1. Zip handles to load from
+//           2. Name of file to extract from zip
+// Outputs:  None
+// Returns:  Mix_Chunk pointer to sfx data loaded from zip, 0 on error
+// Cautions: Failures are reported as warnings (see LoadError)
+//------------------------------------------------------------------------------
+Mix_Chunk *ReadMusic(ZIP_Reader *r, const char *name)
 {
-  int size         = 0;
-  void *data       = LoadZipData(name, &_zipFile, &size);
-	SDL_RWops *zipRw = SDL_RWFromConstMem(data, size);
-	Mix_Chunk *sound = Mix_LoadWAV_RW(zipRw, 1);
+	SDL_RWops *zipRw;
+	Mix_Chunk *sound = 0;
   
-	free(data);
+  r->error[0] = 0;
+  zipRw       = OpenZipRW(r, name);
+  if (zipRw)
+  {
+    sound = Mix_LoadWAV_RW(zipRw, 1);
+    if (sound == 0)
+      LoadError(r, "LBG_LoadMusic: Could not load file %s.\n", name);
+  }
   return(sound);
 }
 
@@ -154,110 +818,1597 @@ Mix_Chunk *ZIP_LoadMusic(const char *name)
 //           2. point size of font
 // Outputs:  None
 // Returns:  ZIP_Font pointer to font data loaded from zip
+// Cautions: Same as ZIP_LoadFontStyle with TTF_STYLE_NORMAL
+//------------------------------------------------------------------------------
+ZIP_Font *ZIP_LoadFont(const char *name, int ptSize)
+{
+  return(ZIP_LoadFontStyle(name, ptSize, TTF_STYLE_NORMAL));
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_LoadFontStyle
+// Summary:  Returns the font opened from the given file with the given size
+//           & style, opening it if it has not been yet
+// Inputs:   1. Name of file to extract from zip
+//           2. point size of font
+//           3. style of font (TTF_STYLE_xxx)
+// Outputs:  None
+// Returns:  ZIP_Font pointer to font, 0 on error
 // Cautions: We use a special ZIP_Font structure to wrap up the normal SDL 
 //           TTF_Font structure.  Attempring to free TTF loaded into the
 //           SDL TTF structure does not work correctly, it seems the PSP SDL
 //           port is lacking in this area.  We must use our own font structure
 //           wrapper to ensure the memroy allocated for the font gets freed
 //           when it is time to free this font.
+//           The font is shared by every caller asking for the same file, 
+//           size & style, do not change its style.  Main thread only.
 //------------------------------------------------------------------------------
-ZIP_Font *ZIP_LoadFont(const char *name, int ptSize)
+ZIP_Font *ZIP_LoadFontStyle(const char *name, int ptSize, int style)
 {
-  ZIP_Font *z = (ZIP_Font*) malloc(sizeof(ZIP_Font));
-  int size;
-  void *data       = LoadZipData(name, &_zipFile, &size);
-	SDL_RWops *zipRw = SDL_RWFromConstMem(data, size);
-	TTF_Font *font   = TTF_OpenFontRW(zipRw, 1, ptSize);
-  // use me if loading font from a zip file acts up
-  //TTF_Font *font = TTF_OpenFont(name, ptSize);
-  
-  // NOTE: the data value cannot be freed here as it can with other calls to 
-  //ZIP_Load.  For TTF files, it seems the TTF_Font structure created needs 
-  //access to the data held by the data pointer.  If we free it here, the
-  // font structure only works 1/2 the time.  So, we return a structure with 
-  //both the font and the data pointer.  Then, when finished instead of 
-  //calling TTF_CloseFont, we call ZIP_CloseFOnt and it frees the data, 
-  //font, and Font Struct for us.  This should be a permanant solution,
-  // but if it starts acting up, simply replace this code with the 
-  // TTF_OpenFont call and remove the ttf file from the zip file.
-  
-  z->f = font;  // font to be freed when font is no longer in use
-  z->d = data;  // data to be freed when font is finished
+  ZipFontFile *file = OpenFontFile(name);
+  SDL_RWops *zipRw;
+  TTF_Font *font;
+  ZIP_Font *z;
+  
+  if (file == 0)
+    return(0);
+  
+  for (z=_fonts; z; z=z->next)
+  {
+    if (z->d == file->data && z->ptSize == ptSize && z->style == style)
+    {
+      z->refs++;
+      return(z);
+    }
+  }
+  
+  // NOTE: the font data cannot be freed while the font is open, the 
+  // TTF_Font structure keeps reading it.  So ZIP_Font holds both the font
+  // and its data, and FlushFonts frees the data once no font uses it.
+  // Fonts are not streamed (see OpenZipRW) since they are read long after
+  // the zip file is closed, and FreeType jumps all over the file.
+  zipRw = SDL_RWFromConstMem(file->data, file->size);
+  font  = TTF_OpenFontRW(zipRw, 1, ptSize);
+  if (font == 0)
+  {
+    CloseFontFile(file->data);
+    EH_Error(EH_SEVERE, "ZIP_LoadFont: Could not open %s (%i).", name, 
+             ptSize);
+    return(0);
+  }
+  TTF_SetFontStyle(font, style);
+  
+  z = (ZIP_Font*) malloc(sizeof(ZIP_Font));
+  if (z == 0)
+  {
+    TTF_CloseFont(font);
+    CloseFontFile(file->data);
+    EH_Error(EH_SEVERE, "ZIP_LoadFont: Out of memory for %s (%i).", name, 
+             ptSize);
+    return(0);
+  }
+  z->f      = font;
+  z->d      = file->data;
+  z->ptSize = ptSize;
+  z->style  = style;
+  z->refs   = 1;
+  z->next   = _fonts;
+  _fonts    = z;
   return(z);
 }
 
 //------------------------------------------------------------------------------
 // Name:     ZIP_CloseFont
-// Summary:  Special wrapper funstion used to close a font and free its memory
-// Inputs:   Pointer to ZIP_Font structure to free
+// Summary:  Hands back a font returned by ZIP_LoadFont
+// Inputs:   Pointer to ZIP_Font structure to close
 // Outputs:  None
 // Returns:  NONE
-// Cautions: None
+// Cautions: The font stays open, so the next screen using it does not have
+//           to inflate & open it again (see ZIP_FlushCache)
 //------------------------------------------------------------------------------
 void ZIP_CloseFont(ZIP_Font *z)
 {
-  if (z)  
+  if (z && z->refs)
+    z->refs--;
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_RenderText
+// Summary:  Returns a string rendered (anti-aliased) with the given font & 
+//           colour, from the text cache if it was rendered before
+// Inputs:   1. font - font to render with
+//           2. text - string to render
+//           3. color - colour to render in
+// Outputs:  None
+// Returns:  SDL_Surface pointer to rendered string, 0 on error
+// Cautions: The surface is shared, do not free it (use ZIP_ReleaseText) or
+//           change it.  It is in the display's alpha format, ready to be 
+//           blitted to the screen.  Released strings stay cached, so the 
+//           next screen drawing them does not render them again, until 
+//           newer strings push them out or their font is closed by 
+//           ZIP_FlushCache.  Main thread only.
+//------------------------------------------------------------------------------
+SDL_Surface *ZIP_RenderText(ZIP_Font *font, const char *text, 
+                            SDL_Color color)
+{
+  Uint32 rgb          = (color.r << 16) | (color.g << 8) | color.b;
+  unsigned int hash   = HashName(text);
+  ZipTextEntry *entry = FindText(font, rgb, hash, text);
+  ZipTextEntry *slot  = 0;
+  SDL_Surface *blended;
+  SDL_Surface *img;
+  int x;
+  
+  if (entry)
+  {
+    entry->refs++;
+    entry->lastUsed = ++_textTick;
+    _stats.textHits++;
+    return(entry->img);
+  }
+  _stats.textMisses++;
+  
+  blended = TTF_RenderText_Blended(font->f, text, color);
+  if (blended == 0)
+    return(0);
+  
+  // SDL_ttf renders 32 bit RGBA, converting it 1X here saves SDL from
+  // converting every pixel each time the string is blitted
+  img = SDL_DisplayFormatAlpha(blended);
+  if (img)
+    SDL_FreeSurface(blended);
+  else
+    img = blended;
+  
+  // strings too long to key on are not cached, releasing frees them
+  if (strlen(text) >= TEXT_LENGTH)
+    return(img);
+  
+  for (x=0; x < TEXT_SLOTS && slot == 0; x++)
+    if (_text[x].img == 0)
+      slot = &_text[x];
+  if (slot == 0)
+    slot = EvictOneText();
+  if (slot)
+  {
+    slot->img      = img;
+    slot->font     = font;
+    slot->color    = rgb;
+    slot->hash     = hash;
+    slot->bytes    = img->pitch * img->h;
+    slot->refs     = 1;
+    slot->lastUsed = ++_textTick;
+    strcpy(slot->text, text);
+    _textBytes += slot->bytes;
+    EvictText(TEXT_BUDGET);
+  }
+  return(img);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ReleaseText
+// Summary:  Hands back a string returned by ZIP_RenderText
+// Inputs:   Rendered string to release (may be 0)
+// Outputs:  None
+// Returns:  None
+// Cautions: Strings that could not be cached, or whose font has been closed,
+//           are freed
+//------------------------------------------------------------------------------
+void ZIP_ReleaseText(SDL_Surface *img)
+{
+  int x;
+  
+  if (img == 0)
+    return;
+  
+  for (x=0; x < TEXT_SLOTS; x++)
   {
-    // close font
-    TTF_CloseFont(z->f);
-    if (z->d)  // free font data if it exists (it allways should)
+    if (_text[x].img == img)
     {
-      free(z->d);
+      if (_text[x].refs)
+        _text[x].refs--;
+      if (_text[x].font == 0 && _text[x].refs == 0)
+      {
+        SDL_FreeSurface(img);
+        _textBytes   -= _text[x].bytes;
+        _text[x].img  = 0;
+      }
+      EvictText(TEXT_BUDGET);
+      return;
     }
-    free(z);  // free wrapper font structure
   }
+  SDL_FreeSurface(img);
 }
 
+
 //------------------------------------------------------------------------------
 // Name:     LoadZipData
 // Summary:  Loads specified file from zip into memory
 // Inputs:   1. Name of file to extract from zip
-//           2. Pointer to zip file structure to extract from
+//           2. Zip handles to extract from
 // Outputs:  size - the size of the data extracted from the ZIP archive
 // Returns:  Pointer to data extracted from zip archive
 // Cautions: None
 //------------------------------------------------------------------------------
-void *LoadZipData(const char *filename, unzFile *zip, int *size)
+void *LoadZipData(const char *filename, ZIP_Reader *r, int *size)
 {
   unz_file_info zinfo;
-  char zipfilename[MAX_PATH];
   unsigned char *data = NULL;
-  int found           = 0;
+  int archive         = OpenZipEntry(filename, r, &zinfo);
   
-  if (unzGoToFirstFile(*zip) != UNZ_OK)
-  {
-    EH_Error(EH_SEVERE, 
-       "LoadLbgData: Could not go to first file when loading file %s.", 
-       filename);
-    return(NULL);
-  }
-
-  do
-  {
-    zipfilename[0] = 0;
-    if (unzGetCurrentFileInfo(*zip, &zinfo, zipfilename, MAX_PATH, 
-                              NULL, 0, NULL, 0) != UNZ_OK)
-        continue;
-    if (!strcasecmp(filename, zipfilename))
-        found = 1;
-  }
-  while (!found && (unzGoToNextFile(*zip) == UNZ_OK));
-  if (!found || (unzOpenCurrentFile(*zip) != UNZ_OK))
-  {
-    EH_Error(EH_SEVERE, 
-             "LoadLbgData: Could not load file %s.", 
-             filename);
-     return(NULL);
-  }
+  if (archive < 0)
+     return(NULL);
   
-  data = (unsigned char *) malloc(zinfo.uncompressed_size);
-  if (unzReadCurrentFile(*zip, data, zinfo.uncompressed_size) != 
-      zinfo.uncompressed_size)
-      goto end_load;
-
-  end_load:
-  unzCloseCurrentFile(*zip);
+  data = ReadZipEntry(&r->zip[archive], &zinfo);
+  unzCloseCurrentFile(r->zip[archive]);
   *size = zinfo.uncompressed_size;
   return(data);
 }
-
+
+//------------------------------------------------------------------------------
+// Name:     OpenZipEntry
+// Summary:  Finds the specified file in the open zips and opens it for 
+//           reading
+// Inputs:   1. Name of file to open
+//           2. Zip handles to open it from
+// Outputs:  zinfo - information on the file opened
+// Returns:  Archive holding the file (its zip handle is r->zip[archive]),
+//           -1 on error (reported as a warning, see LoadError)
+// Cautions: Caller must call unzCloseCurrentFile when finished
+//------------------------------------------------------------------------------
+int OpenZipEntry(const char *filename, ZIP_Reader *r, unz_file_info *zinfo)
+{
+  int archive;
+  
+  // Use the filename index when we have one, fall back on walking the
+  // central directories if the index could not be built.  Readers are 
+  // opened on the same archives, so the index is good for them too.
+  if (_index)
+    archive = FindFileHashed(filename, r);
+  else
+    archive = FindFileLinear(filename, r);
+
+  if (archive < 0 || 
+      (unzGetCurrentFileInfo(r->zip[archive], zinfo, 
+                             NULL, 0, NULL, 0, NULL, 0) != UNZ_OK) ||
+      (unzOpenCurrentFile(r->zip[archive]) != UNZ_OK))
+  {
+    LoadError(r, "LoadLbgData: Could not load file %s.\n", filename);
+     return(-1);
+  }
+#ifdef MM_TRACE_LOADS
+  TraceLoad(filename);
+#endif
+  return(archive);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReadZipEntry
+// Summary:  Reads (and decompresses) the open file in the zip into memory
+// Inputs:   1. Pointer to zip file structure with a file open
+//           2. Information on the open file
+// Outputs:  None
+// Returns:  Pointer to the data read, caller must free it
+// Cautions: None
+//------------------------------------------------------------------------------
+void *ReadZipEntry(unzFile *zip, unz_file_info *zinfo)
+{
+  unsigned char *data = (unsigned char *) malloc(zinfo->uncompressed_size);
+  
+  if (data)
+    unzReadCurrentFile(*zip, data, zinfo->uncompressed_size);
+  return(data);
+}
+
+//------------------------------------------------------------------------------
+// Name:     OpenZipRW
+// Summary:  Creates an SDL_RWops to read the specified file from the zip.
+//           Files stored uncompressed in an archive held in memory are read
+//           in place, all others are inflated a piece at a time as SDL reads
+//           them, so the whole file never has to be held in memory.
+// Inputs:   1. Zip handles to read from
+//           2. Name of file to read
+// Outputs:  None
+// Returns:  SDL_RWops pointer, 0 on error
+// Cautions: The zip file can not be used for anything else until the RWops
+//           is closed, and the RWops must be closed before the zip file is.
+//           This rules out fonts, SDL_ttf keeps reading them for as long as
+//           the font is open.
+//------------------------------------------------------------------------------
+SDL_RWops *OpenZipRW(ZIP_Reader *r, const char *filename)
+{
+  unz_file_info zinfo;
+  const unsigned char *base = NULL;
+  SDL_RWops *rw             = 0;
+  ZipStream *stream         = 0;
+  unzFile zip;
+  int archive               = OpenZipEntry(filename, r, &zinfo);
+  
+  if (archive < 0)
+    return(0);
+    
+  zip = r->zip[archive];
+  if (zinfo.compression_method == 0 && r->backend[archive] == ZIP_IO_MEMORY)
+    base = (const unsigned char *) memory_filefunc_data(_archives[archive].name,
+                                                         NULL);
+    
+  if (base)
+  {
+    rw = SDL_RWFromConstMem(base + unzGetCurrentFileZStreamPos(zip),
+                            zinfo.uncompressed_size);
+    unzCloseCurrentFile(zip);
+    return(rw);
+  }
+  
+  rw     = SDL_AllocRW();
+  stream = (ZipStream *) malloc(sizeof(ZipStream));
+  if (rw == 0 || stream == 0)
+  {
+    if (rw)
+      SDL_FreeRW(rw);
+    free(stream);
+    unzCloseCurrentFile(zip);
+    return(0);
+  }
+  
+  stream->zip    = zip;
+  stream->size   = zinfo.uncompressed_size;
+  stream->offset = 0;
+  rw->seek  = ZipStreamSeek;
+  rw->read  = ZipStreamRead;
+  rw->write = ZipStreamWrite;
+  rw->close = ZipStreamClose;
+  rw->hidden.unknown.data1 = stream;
+  return(rw);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZipStreamSeek
+// Summary:  SDL_RWops seek callback for a zip stream.  Seeking forward reads
+//           (and throws away) data up to the new position, seeking backward
+//           re-opens the entry and inflates it again from the start.
+// Inputs:   1. RWops to seek
+//           2. offset to seek to
+//           3. RW_SEEK_SET, RW_SEEK_CUR or RW_SEEK_END
+// Outputs:  None
+// Returns:  New position in stream, -1 on error
+// Cautions: Backward seeks are expensive, the image and sound loaders only
+//           use them to rewind a few bytes after checking a file's type
+//------------------------------------------------------------------------------
+int ZipStreamSeek(SDL_RWops *context, int offset, int whence)
+{
+  ZipStream *s = (ZipStream *) context->hidden.unknown.data1;
+  char skip[SKIP_BUFFER_SIZE];
+  long target;
+  int  read;
+  
+  switch (whence)
+  {
+    case RW_SEEK_SET: target = offset;                  break;
+    case RW_SEEK_CUR: target = (long) s->offset + offset; break;
+    case RW_SEEK_END: target = (long) s->size + offset;   break;
+    default:
+      SDL_SetError("ZipStreamSeek: Unknown value for 'whence'");
+      return(-1);
+  }
+  
+  if (target < 0)
+    target = 0;
+  if (target > (long) s->size)
+    target = s->size;
+    
+  if (target < (long) s->offset)
+  {
+    unzCloseCurrentFile(s->zip);
+    if (unzOpenCurrentFile(s->zip) != UNZ_OK)
+    {
+      SDL_SetError("ZipStreamSeek: Could not rewind file");
+      return(-1);
+    }
+    s->offset = 0;
+  }
+  
+  while ((long) s->offset < target)
+  {
+    read = target - s->offset;
+    if (read > SKIP_BUFFER_SIZE)
+      read = SKIP_BUFFER_SIZE;
+    read = unzReadCurrentFile(s->zip, skip, read);
+    if (read <= 0)
+    {
+      SDL_SetError("ZipStreamSeek: Error reading file");
+      return(-1);
+    }
+    s->offset += read;
+  }
+  return(s->offset);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZipStreamRead
+// Summary:  SDL_RWops read callback for a zip stream, inflates the requested
+//           data straight into the caller's buffer
+// Inputs:   1. RWops to read from
+//           2. buffer to read into
+//           3. size of each object to read
+//           4. maximum number of objects to read
+// Outputs:  None
+// Returns:  Number of (whole) objects read, -1 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+int ZipStreamRead(SDL_RWops *context, void *ptr, int size, int maxnum)
+{
+  ZipStream *s = (ZipStream *) context->hidden.unknown.data1;
+  unsigned long total = (unsigned long) size * maxnum;
+  int read;
+  
+  if (size <= 0 || maxnum <= 0)
+    return(0);
+  if (total > s->size - s->offset)
+    total = ((s->size - s->offset) / size) * size;
+  if (total == 0)
+    return(0);
+    
+  read = unzReadCurrentFile(s->zip, ptr, total);
+  if (read < 0)
+  {
+    SDL_SetError("ZipStreamRead: Error reading file");
+    return(-1);
+  }
+  s->offset += read;
+  return(read / size);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZipStreamWrite
+// Summary:  SDL_RWops write callback for a zip stream, always fails
+// Inputs:   Unused
+// Outputs:  None
+// Returns:  -1
+// Cautions: None
+//------------------------------------------------------------------------------
+int ZipStreamWrite(SDL_RWops *context, const void *ptr, int size, int num)
+{
+  SDL_SetError("ZipStreamWrite: Zip files are read only");
+  return(-1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZipStreamClose
+// Summary:  SDL_RWops close callback for a zip stream, closes the zip entry
+//           and frees the RWops
+// Inputs:   RWops to close
+// Outputs:  None
+// Returns:  0
+// Cautions: None
+//------------------------------------------------------------------------------
+int ZipStreamClose(SDL_RWops *context)
+{
+  if (context)
+  {
+    ZipStream *s = (ZipStream *) context->hidden.unknown.data1;
+    unzCloseCurrentFile(s->zip);
+    free(s);
+    SDL_FreeRW(context);
+  }
+  return(0);
+}
+
+
+//------------------------------------------------------------------------------
+// Name:     OpenArchive
+// Summary:  Opens a zip file using the given IO backend, falling back on 
+//           stdio if the memory backend can not map the file
+// Inputs:   1. Name of zip file to open
+//           2. backend - IO backend to try first
+// Outputs:  backend - IO backend actually used
+// Returns:  Handle to opened zip file, 0 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+unzFile OpenArchive(const char *filename, int *backend)
+{
+  zlib_filefunc_def funcs;
+  unzFile zip = 0;
+  
+  if (*backend == ZIP_IO_MEMORY)
+  {
+    fill_memory_filefunc(&funcs);
+    zip = unzOpen2(filename, &funcs);
+  }
+  
+  if (zip == 0)
+  {
+    zip      = unzOpen(filename);
+    *backend = ZIP_IO_STDIO;
+  }
+  
+  if (zip)
+    _stats.archiveOpens++;
+  return(zip);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CloseArchives
+// Summary:  Closes every archive open in a set of zip handles
+// Inputs:   Zip handles to close
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void CloseArchives(ZIP_Reader *r)
+{
+  int x;
+  
+  for (x=0; x < NUM_ARCHIVES; x++)
+  {
+    if (r->zip[x])
+      unzClose(r->zip[x]);
+    r->zip[x] = 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     OpenResident
+// Summary:  (Re)opens every archive with the selected IO backend, and builds
+//           the filename index over them
+// Inputs:   None
+// Outputs:  None
+// Returns:  Status value of 0 on success, non-zero if data.lbg could not be
+//           opened (the archives are then not marked resident, so the next
+//           session tries again)
+// Cautions: Readers are closed too, none may be in use
+//------------------------------------------------------------------------------
+int OpenResident()
+{
+  int x;
+  
+  CloseResident();
+  for (x=0; x < NUM_ARCHIVES; x++)
+  {
+    _zipFile.backend[x] = _ioBackend;
+    _zipFile.zip[x]     = OpenArchive(_archives[x].name, &_zipFile.backend[x]);
+  }
+  _residentBackend = _ioBackend;
+  BuildIndex(&_zipFile);
+  
+  for (x=0; x < NUM_ARCHIVES; x++)
+    if (_archives[x].id == ZIP_MAIN && _zipFile.zip[x] == 0)
+      return(1);
+  _resident = 1;
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CloseResident
+// Summary:  Closes the archives opened by OpenResident, any readers kept for
+//           reuse, and frees the filename index
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void CloseResident()
+{
+  ZIP_Reader *r;
+  
+  while (_freeReaders)
+  {
+    r            = _freeReaders;
+    _freeReaders = r->next;
+    CloseArchives(r);
+    free(r);
+  }
+  FreeIndex();
+  CloseArchives(&_zipFile);
+  _resident = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name:     LockContextPool
+// Summary:  Lock callback for unzip's read context pool
+// Inputs:   SDL_mutex guarding the pool
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void ZCALLBACK LockContextPool(voidpf lock)
+{
+  SDL_mutexP((SDL_mutex *) lock);
+}
+
+//------------------------------------------------------------------------------
+// Name:     UnlockContextPool
+// Summary:  Unlock callback for unzip's read context pool
+// Inputs:   SDL_mutex guarding the pool
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void ZCALLBACK UnlockContextPool(voidpf lock)
+{
+  SDL_mutexV((SDL_mutex *) lock);
+}
+
+//------------------------------------------------------------------------------
+// Name:     HashName
+// Summary:  Case insensitive (FNV-1a) hash of a filename
+// Inputs:   Filename to hash
+// Outputs:  None
+// Returns:  Hash value of filename
+// Cautions: None
+//------------------------------------------------------------------------------
+unsigned int HashName(const char *name)
+{
+  unsigned int hash = 2166136261u;
+  
+  while (*name)
+  {
+    hash ^= (unsigned char) tolower((unsigned char) *name++);
+    hash *= 16777619u;
+  }
+  return(hash);
+}
+
+//------------------------------------------------------------------------------
+// Name:     BuildIndex
+// Summary:  Walks the central directory of each open zip file 1X and stores
+//           the position of every entry, in each archive holding it, in the
+//           filename index.  The index is the manifest of which archives each
+//           file can be loaded from.
+// Inputs:   Zip handles to index
+// Outputs:  None
+// Returns:  None
+// Cautions: If the index can not be built, _index is left at 0 and all 
+//           lookups fall back on the linear search.  If an archive holds the
+//           same name twice, its first entry wins (same as the linear search).
+//------------------------------------------------------------------------------
+void BuildIndex(ZIP_Reader *r)
+{
+  unz_global_info ginfo;
+  unz_file_info   finfo;
+  char zipfilename[MAX_PATH];
+  unsigned int slot;
+  unsigned int hash;
+  unsigned int size     = MIN_INDEX_SIZE;
+  unsigned int used     = 0;   // bytes of _indexNames in use
+  unsigned int capacity = 0;   // bytes allocated for _indexNames
+  unsigned int length;
+  unsigned long number  = 0;
+  char *names;
+  unzFile zip;
+  int status;
+  int x;
+  
+  FreeIndex();
+  for (x=0; x < NUM_ARCHIVES; x++)
+  {
+    if (r->zip[x] == 0)
+      continue;
+    if (unzGetGlobalInfo(r->zip[x], &ginfo) != UNZ_OK)
+      return;
+    number += ginfo.number_entry;
+  }
+  
+  // keep the table at most 1/2 full so probe chains stay short
+  while (size < number * 2)
+    size <<= 1;
+    
+  _index = (ZipIndexEntry *) calloc(size, sizeof(ZipIndexEntry));
+  if (_index == 0)
+  {
+    EH_Error(EH_WARN, "ZIP_OpenZipFile: No memory for index\n");
+    return;
+  }
+  _indexSize = size;
+  
+  for (x=0; x < NUM_ARCHIVES; x++)
+  {
+    zip = r->zip[x];
+    if (zip == 0)
+      continue;
+      
+    for (status = unzGoToFirstFile(zip); status == UNZ_OK; 
+         status = unzGoToNextFile(zip))
+    {
+      if (unzGetCurrentFileInfo(zip, &finfo, zipfilename, MAX_PATH, 
+                                NULL, 0, NULL, 0) != UNZ_OK)
+        continue;
+        
+      hash = HashName(zipfilename);
+      for (slot = hash & (_indexSize - 1); _index[slot].archives; 
+           slot = (slot + 1) & (_indexSize - 1))
+      {
+        if (_index[slot].hash == hash && 
+            !strcasecmp(_indexNames + _index[slot].name, zipfilename))
+          break;
+      }
+      
+      if (_index[slot].archives & (1 << x))  // duplicate within the archive
+        continue;
+        
+      if (_index[slot].archives == 0)
+      {
+        length = strlen(zipfilename) + 1;
+        if (used + length > capacity)
+        {
+          capacity = (capacity + length) * 2;
+          names    = (char *) realloc(_indexNames, capacity);
+          if (names == 0)
+          {
+            EH_Error(EH_WARN, "ZIP_OpenZipFile: No memory for index\n");
+            FreeIndex();
+            return;
+          }
+          _indexNames = names;
+        }
+        memcpy(_indexNames + used, zipfilename, length);
+        _index[slot].name = used;
+        _index[slot].hash = hash;
+        used += length;
+      }
+      _index[slot].archives |= 1 << x;
+      unzGetFilePos(zip, &_index[slot].pos[x]);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     FreeIndex
+// Summary:  Frees the filename index of the open zip files
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void FreeIndex()
+{
+  free(_index);
+  free(_indexNames);
+  _index      = 0;
+  _indexNames = 0;
+  _indexSize  = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name:     FindFileHashed
+// Summary:  Uses the filename index to move the archive holding the given
+//           file to its entry
+// Inputs:   1. Name of file to find
+//           2. Zip handles to search (must be on the indexed files)
+// Outputs:  None
+// Returns:  Archive holding the file (it is now that archive's current 
+//           file), -1 if not found
+// Cautions: Only archives in the current session are searched
+//------------------------------------------------------------------------------
+int FindFileHashed(const char *filename, ZIP_Reader *r)
+{
+  unsigned int hash = HashName(filename);
+  unsigned int slot;
+  int archive;
+  
+  for (slot = hash & (_indexSize - 1); _index[slot].archives; 
+       slot = (slot + 1) & (_indexSize - 1))
+  {
+    if (_index[slot].hash == hash && 
+        !strcasecmp(_indexNames + _index[slot].name, filename))
+    {
+      // first archive in lookup order that holds the file & is in session
+      for (archive=0; archive < NUM_ARCHIVES; archive++)
+      {
+        if ((_index[slot].archives & (1 << archive)) && r->zip[archive] &&
+            (_openFiles & _archives[archive].id))
+        {
+          if (unzGoToFilePos(r->zip[archive], 
+                             &_index[slot].pos[archive]) == UNZ_OK)
+            return(archive);
+          return(-1);
+        }
+      }
+      return(-1);
+    }
+  }
+  return(-1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FindFileLinear
+// Summary:  Searches the archives in the current session, in lookup order, 
+//           for the given file
+// Inputs:   1. Name of file to find
+//           2. Zip handles to search
+// Outputs:  None
+// Returns:  Archive holding the file (it is now that archive's current 
+//           file), -1 if not found
+// Cautions: Slow, only used when no index exists (and for profiling)
+//------------------------------------------------------------------------------
+int FindFileLinear(const char *filename, ZIP_Reader *r)
+{
+  int x;
+  
+  for (x=0; x < NUM_ARCHIVES; x++)
+    if (r->zip[x] && (_openFiles & _archives[x].id) && 
+        FindFileInArchive(filename, r->zip[x]))
+      return(x);
+  return(-1);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FindFileInArchive
+// Summary:  Walks the central directory from the first entry until the given
+//           file is found
+// Inputs:   1. Name of file to find
+//           2. Zip file to search
+// Outputs:  None
+// Returns:  1 if the file was found (and is now the current file), else 0
+// Cautions: None
+//------------------------------------------------------------------------------
+int FindFileInArchive(const char *filename, unzFile zip)
+{
+  char zipfilename[MAX_PATH];
+  int found = 0;
+  
+  // not reported here, the caller reports the file as not found
+  if (unzGoToFirstFile(zip) != UNZ_OK)
+    return(0);
+
+  do
+  {
+    zipfilename[0] = 0;
+    if (unzGetCurrentFileInfo(zip, NULL, zipfilename, MAX_PATH, 
+                              NULL, 0, NULL, 0) != UNZ_OK)
+        continue;
+    if (!strcasecmp(filename, zipfilename))
+        found = 1;
+  }
+  while (!found && (unzGoToNextFile(zip) == UNZ_OK));
+  
+  return(found);
+}
+
+//------------------------------------------------------------------------------
+// Name:     OpenFontFile
+// Summary:  Returns a font file, inflating it if it has not been yet
+// Inputs:   Name of file to extract from zip
+// Outputs:  None
+// Returns:  Font file, 0 on error
+// Cautions: A zip file must be open the first time a font file is used
+//------------------------------------------------------------------------------
+ZipFontFile *OpenFontFile(const char *name)
+{
+  ZipFontFile *slot = 0;
+  int x;
+  
+  for (x=0; x < MAX_FONT_FILES; x++)
+  {
+    if (_fontFiles[x].data && !strcasecmp(_fontFiles[x].name, name))
+      return(&_fontFiles[x]);
+    if (_fontFiles[x].data == 0 && slot == 0)
+      slot = &_fontFiles[x];
+  }
+  
+  if (slot == 0)
+  {
+    EH_Error(EH_SEVERE, "ZIP_LoadFont: Too many font files (%s).", name);
+    return(0);
+  }
+  // the menus can not do without their fonts
+  slot->data = LoadZipData(name, &_zipFile, &slot->size);
+  if (slot->data == 0)
+  {
+    EH_Error(EH_SEVERE, "ZIP_LoadFont: Could not load %s.", name);
+    return(0);
+  }
+  strncpy(slot->name, name, MAX_PATH - 1);
+  slot->name[MAX_PATH - 1] = 0;
+  return(slot);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CloseFontFile
+// Summary:  Frees the data of a font file, if no open font uses it
+// Inputs:   Data of the font file
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void CloseFontFile(void *data)
+{
+  ZIP_Font *z;
+  int x;
+  
+  for (z=_fonts; z && z->d != data; z=z->next)
+    ;
+  for (x=0; z == 0 && x < MAX_FONT_FILES; x++)
+  {
+    if (_fontFiles[x].data == data)
+    {
+      free(_fontFiles[x].data);
+      _fontFiles[x].data = 0;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     GetCached
+// Summary:  Returns an asset from the cache, loading & adding it if it is 
+//           not there
+// Inputs:   1. r - reader to load with, 0 for the zip manager's own handle
+//           2. name - name of file to extract from zip
+//           3. kind - CACHE_xxx
+// Outputs:  None
+// Returns:  SDL_Surface or Mix_Chunk, 0 on error
+// Cautions: The cache is only locked while it is searched & updated, 
+//           threads load at the same time.  If 2 load the same file, the
+//           second copy is freed.
+//------------------------------------------------------------------------------
+void *GetCached(ZIP_Reader *r, const char *name, int kind)
+{
+  ZipCacheEntry *entry;
+  ZipCacheEntry *slot = 0;
+  unsigned int hash   = HashName(name);
+  unsigned int bytes  = 0;
+  void *item          = 0;
+  int archive, x;
+  
+  if (r == 0)
+    r = &_zipFile;
+  
+  // the same name can come from a level archive or data.lbg
+  archive = _index ? FindFileHashed(name, r) : FindFileLinear(name, r);
+  
+  if (_cacheLock)
+    SDL_mutexP(_cacheLock);
+  entry = FindCached(hash, name, archive, kind);
+  if (entry)
+  {
+    entry->refs++;
+    entry->lastUsed = ++_cacheTick;
+    item            = entry->item;
+    _stats.cacheHits++;
+  }
+  else
+  {
+    _stats.cacheMisses++;
+  }
+  if (_cacheLock)
+    SDL_mutexV(_cacheLock);
+  
+  if (item)
+    return(item);
+    
+  item = LoadCacheItem(r, name, kind, &bytes);
+  if (item == 0 || archive < 0)
+    return(item);
+  
+  if (_cacheLock)
+    SDL_mutexP(_cacheLock);
+  entry = FindCached(hash, name, archive, kind);
+  if (entry)  // another thread got there first, use its copy
+  {
+    entry->refs++;
+    entry->lastUsed = ++_cacheTick;
+    FreeCacheItem(item, kind);
+    item = entry->item;
+  }
+  else
+  {
+    for (x=0; x < CACHE_SLOTS && slot == 0; x++)
+      if (_cache[x].item == 0)
+        slot = &_cache[x];
+    if (slot == 0)
+      slot = EvictOne();
+    
+    // with every slot in use the asset is not cached, releasing frees it
+    if (slot)
+    {
+      slot->item     = item;
+      slot->hash     = hash;
+      slot->archive  = archive;
+      slot->kind     = kind;
+      slot->bytes    = bytes;
+      slot->refs     = 1;
+      slot->lastUsed = ++_cacheTick;
+      strncpy(slot->name, name, MAX_PATH - 1);
+      slot->name[MAX_PATH - 1] = 0;
+      _cacheBytes += bytes;
+      EvictCached(_cacheBudget);
+    }
+  }
+  if (_cacheLock)
+    SDL_mutexV(_cacheLock);
+  return(item);
+}
+
+//------------------------------------------------------------------------------
+// Name:     LoadCacheItem
+// Summary:  Loads an asset for the cache
+// Inputs:   1. r - reader to load with
+//           2. name - name of file to extract from zip
+//           3. kind - CACHE_xxx
+// Outputs:  bytes - size of the decoded pixels or samples
+// Returns:  SDL_Surface or Mix_Chunk, 0 on error
+// Cautions: None
+//------------------------------------------------------------------------------
+void *LoadCacheItem(ZIP_Reader *r, const char *name, int kind, 
+                    unsigned int *bytes)
+{
+  SDL_Surface *img;
+  Mix_Chunk *sound;
+  
+  if (kind == CACHE_SOUND)
+  {
+    sound  = ReadMusic(r, name);
+    *bytes = sound ? sound->alen : 0;
+    return(sound);
+  }
+  
+  img    = PrepareImage(ReadImage(r, name), kind);
+  *bytes = img ? img->pitch * img->h : 0;
+  return(img);
+}
+
+//------------------------------------------------------------------------------
+// Name:     PrepareImage
+// Summary:  Converts an image to the screen's format and sets its colorkey,
+//           as asked for by ZIP_IMG_xxx flags
+// Inputs:   1. img - image loaded by ReadImage (may be 0)
+//           2. flags - ZIP_IMG_xxx
+// Outputs:  None
+// Returns:  SDL_Surface prepared, 0 on error
+// Cautions: img is freed if it has to be converted
+//------------------------------------------------------------------------------
+SDL_Surface *PrepareImage(SDL_Surface *img, int flags)
+{
+  SDL_Surface *conv;
+  
+  if (img && (flags & ZIP_IMG_SCREEN) && !MM_IsScreenFormat(img))
+  {
+    conv = SDL_ConvertSurface(img, MM_GetScreenPtr()->format, SDL_SWSURFACE);
+    SDL_FreeSurface(img);
+    img  = conv;
+  }
+  if (img && (flags & ZIP_IMG_TRANSP))
+    SDL_SetColorKey(img, SDL_SRCCOLORKEY, 
+                    SDL_MapRGB(img->format, 0xFF, 0x80, 0x80));
+  return(img);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ReleaseCached
+// Summary:  Hands back an asset returned by GetCached
+// Inputs:   1. item - SDL_Surface or Mix_Chunk to release (may be 0)
+//           2. sound - set if item is a Mix_Chunk
+// Outputs:  None
+// Returns:  None
+// Cautions: Assets that are not in the cache are freed
+//------------------------------------------------------------------------------
+void ReleaseCached(void *item, int sound)
+{
+  int x;
+  
+  if (item == 0)
+    return;
+  
+  if (_cacheLock)
+    SDL_mutexP(_cacheLock);
+  for (x=0; x < CACHE_SLOTS; x++)
+  {
+    if (_cache[x].item == item)
+    {
+      if (_cache[x].refs)
+        _cache[x].refs--;
+      EvictCached(_cacheBudget);
+      break;
+    }
+  }
+  if (_cacheLock)
+    SDL_mutexV(_cacheLock);
+  
+  if (x == CACHE_SLOTS)
+    FreeCacheItem(item, sound ? CACHE_SOUND : CACHE_IMAGE);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FindCached
+// Summary:  Looks for an asset in the cache
+// Inputs:   1. hash - HashName(name)
+//           2. name - name of file
+//           3. archive - archive file comes from
+//           4. kind - CACHE_xxx
+// Outputs:  None
+// Returns:  Cache entry, 0 if the asset is not cached
+// Cautions: Cache must be locked
+//------------------------------------------------------------------------------
+ZipCacheEntry *FindCached(unsigned int hash, const char *name, int archive,
+                          int kind)
+{
+  int x;
+  
+  for (x=0; x < CACHE_SLOTS; x++)
+  {
+    if (_cache[x].item && _cache[x].hash == hash && 
+        _cache[x].archive == archive && _cache[x].kind == kind &&
+        !strcasecmp(_cache[x].name, name))
+      return(&_cache[x]);
+  }
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     EvictCached
+// Summary:  Frees the least recently used assets not in use until the cache
+//           holds no more than the given number of bytes
+// Inputs:   Bytes the cache may hold
+// Outputs:  None
+// Returns:  None
+// Cautions: Cache must be locked
+//------------------------------------------------------------------------------
+void EvictCached(unsigned int budget)
+{
+  while ((_cacheBytes > budget || budget == 0) && EvictOne())
+    ;
+}
+
+//------------------------------------------------------------------------------
+// Name:     EvictOne
+// Summary:  Frees the least recently used asset not in use
+// Inputs:   None
+// Outputs:  None
+// Returns:  Cache entry freed, 0 if every cached asset is in use
+// Cautions: Cache must be locked
+//------------------------------------------------------------------------------
+ZipCacheEntry *EvictOne()
+{
+  ZipCacheEntry *lru = 0;
+  int x;
+  
+  for (x=0; x < CACHE_SLOTS; x++)
+    if (_cache[x].item && _cache[x].refs == 0 &&
+        (lru == 0 || _cache[x].lastUsed < lru->lastUsed))
+      lru = &_cache[x];
+      
+  if (lru)
+  {
+    FreeCacheItem(lru->item, lru->kind);
+    _cacheBytes -= lru->bytes;
+    lru->item    = 0;
+    _stats.cacheEvictions++;
+  }
+  return(lru);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FreeCacheItem
+// Summary:  Frees an asset loaded by LoadCacheItem
+// Inputs:   1. item - SDL_Surface or Mix_Chunk
+//           2. kind - CACHE_xxx
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void FreeCacheItem(void *item, int kind)
+{
+  if (kind == CACHE_SOUND)
+    Mix_FreeChunk((Mix_Chunk *) item);
+  else
+    SDL_FreeSurface((SDL_Surface *) item);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FindText
+// Summary:  Looks for a rendered string in the text cache
+// Inputs:   1. font - font string was rendered with
+//           2. color - colour string was rendered in (0x00RRGGBB)
+//           3. hash - HashName(text)
+//           4. text - string
+// Outputs:  None
+// Returns:  Text cache entry, 0 if the string is not cached
+// Cautions: None
+//------------------------------------------------------------------------------
+ZipTextEntry *FindText(ZIP_Font *font, Uint32 color, unsigned int hash,
+                       const char *text)
+{
+  int x;
+  
+  for (x=0; x < TEXT_SLOTS; x++)
+  {
+    if (_text[x].img && _text[x].font == font && _text[x].color == color &&
+        _text[x].hash == hash && !strcmp(_text[x].text, text))
+      return(&_text[x]);
+  }
+  return(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:     EvictText
+// Summary:  Frees the least recently used strings not in use until the text
+//           cache holds no more than the given number of bytes
+// Inputs:   Bytes the text cache may hold
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void EvictText(unsigned int budget)
+{
+  while ((_textBytes > budget || budget == 0) && EvictOneText())
+    ;
+}
+
+//------------------------------------------------------------------------------
+// Name:     EvictOneText
+// Summary:  Frees the least recently used string not in use
+// Inputs:   None
+// Outputs:  None
+// Returns:  Text cache entry freed, 0 if every cached string is in use
+// Cautions: None
+//------------------------------------------------------------------------------
+ZipTextEntry *EvictOneText()
+{
+  ZipTextEntry *lru = 0;
+  int x;
+  
+  for (x=0; x < TEXT_SLOTS; x++)
+    if (_text[x].img && _text[x].refs == 0 &&
+        (lru == 0 || _text[x].lastUsed < lru->lastUsed))
+      lru = &_text[x];
+  
+  if (lru)
+  {
+    SDL_FreeSurface(lru->img);
+    _textBytes -= lru->bytes;
+    lru->img    = 0;
+    _stats.textEvictions++;
+  }
+  return(lru);
+}
+
+//------------------------------------------------------------------------------
+// Name:     CloseFont
+// Summary:  Closes a font no longer in use, and frees its font file's data
+//           if no other font uses it
+// Inputs:   Font to close
+// Outputs:  None
+// Returns:  None
+// Cautions: The font is freed
+//------------------------------------------------------------------------------
+void CloseFont(ZIP_Font *z)
+{
+  ZIP_Font **p;
+  
+  for (p=&_fonts; *p && *p != z; p=&(*p)->next)
+    ;
+  if (*p)
+    *p = z->next;
+  
+  DropFontText(z);
+  TTF_CloseFont(z->f);
+  CloseFontFile(z->d);
+  free(z);
+}
+
+//------------------------------------------------------------------------------
+// Name:     FlushFonts
+// Summary:  Closes every font not in use
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: None
+//------------------------------------------------------------------------------
+void FlushFonts()
+{
+  ZIP_Font *z = _fonts;
+  ZIP_Font *next;
+  
+  while (z)
+  {
+    next = z->next;
+    if (z->refs == 0)
+      CloseFont(z);
+    z = next;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     DropFontText
+// Summary:  Removes the strings rendered with a font from the text cache, 
+//           the font is being closed
+// Inputs:   Font being closed
+// Outputs:  None
+// Returns:  None
+// Cautions: Strings still in use stay in their slot but no longer match 
+//           anything (a new font may get the same address), 
+//           ZIP_ReleaseText frees them
+//------------------------------------------------------------------------------
+void DropFontText(ZIP_Font *font)
+{
+  int x;
+  
+  for (x=0; x < TEXT_SLOTS; x++)
+  {
+    if (_text[x].img && _text[x].font == font)
+    {
+      _text[x].font = 0;
+      if (_text[x].refs == 0)
+      {
+        SDL_FreeSurface(_text[x].img);
+        _textBytes   -= _text[x].bytes;
+        _text[x].img  = 0;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Name:     LoadError
+// Summary:  Records why a load failed in the reader it was loaded through, 
+//           and reports it as a warning if that is the zip manager's own 
+//           handle
+// Inputs:   1. r - reader load failed on
+//           2. format - message (same as is used by sprintf/printf)
+// Outputs:  None
+// Returns:  None
+// Cautions: Readers are used by the load threads, which must not touch the
+//           error handler (or the screen it draws to).  Their failures are
+//           only recorded, see ZIP_GetReaderError.
+//------------------------------------------------------------------------------
+void LoadError(ZIP_Reader *r, const char *format, ...)
+{
+  va_list opt;
+  
+  va_start(opt, format);
+  vsnprintf(r->error, ERROR_LENGTH, format, opt);
+  va_end(opt);
+  if (r == &_zipFile)
+    EH_Error(EH_WARN, "%s", r->error);
+}
+
+#ifdef MM_TRACE_LOADS
+//------------------------------------------------------------------------------
+// Name:     TraceLoad
+// Summary:  Adds the name of a file being loaded to TRACE_FILE.  lbg_pack
+//           reads the trace back to lay the archives out in load order.
+// Inputs:   Name of file being loaded
+// Outputs:  None
+// Returns:  None
+// Cautions: Called from the load threads too.  The benchmarks run with
+//           MM_PROFILE load files out of their normal order, so build the
+//           trace without it.
+//------------------------------------------------------------------------------
+void TraceLoad(const char *filename)
+{
+  if (_trace == 0)
+    return;
+  
+  if (_traceLock)
+    SDL_mutexP(_traceLock);
+  fprintf(_trace, "%s\n", filename);
+  fflush(_trace);   // the game is often left with the home button
+  if (_traceLock)
+    SDL_mutexV(_traceLock);
+}
+#endif
+
+#ifdef MM_PROFILE
+// IO callbacks counted by ZIP_ProfileDirectory, they pass every call on to
+// the memory backend
+static zlib_filefunc_def _countedFuncs;
+static unsigned int      _countedReads;
+static unsigned int      _countedSeeks;
+
+static voidpf ZCALLBACK CountedOpen(voidpf opaque, const char *filename, int mode)
+  { return(_countedFuncs.zopen_file(_countedFuncs.opaque, filename, mode)); }
+static uLong ZCALLBACK CountedRead(voidpf opaque, voidpf stream, void *buf, uLong size)
+  { _countedReads++; return(_countedFuncs.zread_file(_countedFuncs.opaque, stream, buf, size)); }
+static uLong ZCALLBACK CountedWrite(voidpf opaque, voidpf stream, const void *buf, uLong size)
+  { return(_countedFuncs.zwrite_file(_countedFuncs.opaque, stream, buf, size)); }
+static long ZCALLBACK CountedTell(voidpf opaque, voidpf stream)
+  { return(_countedFuncs.ztell_file(_countedFuncs.opaque, stream)); }
+static long ZCALLBACK CountedSeek(voidpf opaque, voidpf stream, uLong offset, int origin)
+  { _countedSeeks++; return(_countedFuncs.zseek_file(_countedFuncs.opaque, stream, offset, origin)); }
+static int ZCALLBACK CountedClose(voidpf opaque, voidpf stream)
+  { return(_countedFuncs.zclose_file(_countedFuncs.opaque, stream)); }
+static int ZCALLBACK CountedError(voidpf opaque, voidpf stream)
+  { return(_countedFuncs.zerror_file(_countedFuncs.opaque, stream)); }
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ProfileDirectory
+// Summary:  Benchmark, walks the whole central directory of data.lbg and 
+//           opens (then closes) every entry, counting the IO callback calls
+//           it takes to parse the central directory & local headers.  Done
+//           with the headers read a byte at a time (as before) & as records.
+// Inputs:   None
+// Outputs:  None
+// Returns:  None
+// Cautions: Results are reported as EH_DEBUG messages.  Opens its own handle
+//           on data.lbg with the memory backend.
+//------------------------------------------------------------------------------
+void ZIP_ProfileDirectory()
+{
+  static const char *how[2] = { "byte", "record" };
+  zlib_filefunc_def funcs;
+  char zipfilename[MAX_PATH];
+  unsigned int dirReads, dirSeeks, start, dirTime;
+  unsigned int entries;
+  unzFile zip;
+  int status, records;
+  
+  fill_memory_filefunc(&_countedFuncs);
+  funcs.zopen_file  = CountedOpen;
+  funcs.zread_file  = CountedRead;
+  funcs.zwrite_file = CountedWrite;
+  funcs.ztell_file  = CountedTell;
+  funcs.zseek_file  = CountedSeek;
+  funcs.zclose_file = CountedClose;
+  funcs.zerror_file = CountedError;
+  funcs.opaque      = 0;
+  
+  zip = unzOpen2(RESOURCE_FILE, &funcs);
+  if (zip == 0)
+    return;
+  
+  for (records=0; records < 2; records++)
+  {
+    unzSetRecordReads(records);
+    
+    // central directory entries
+    entries       = 0;
+    _countedReads = _countedSeeks = 0;
+    start = MM_GetMicroSeconds();
+    for (status = unzGoToFirstFile(zip); status == UNZ_OK; 
+         status = unzGoToNextFile(zip))
+    {
+      unzGetCurrentFileInfo(zip, NULL, zipfilename, MAX_PATH, NULL, 0, 
+                            NULL, 0);
+      entries++;
+    }
+    dirTime  = MM_GetMicroSeconds() - start;
+    dirReads = _countedReads;
+    dirSeeks = _countedSeeks;
+    
+    // local headers
+    _countedReads = _countedSeeks = 0;
+    start = MM_GetMicroSeconds();
+    for (status = unzGoToFirstFile(zip); status == UNZ_OK; 
+         status = unzGoToNextFile(zip))
+    {
+      if (unzOpenCurrentFile(zip) == UNZ_OK)
+        unzCloseCurrentFile(zip);
+    }
+    
+    EH_Error(EH_DEBUG, "ZIP dir %u entries by %s: %u reads %u seeks %uus, "
+             "open: %u reads %u seeks %uus\n", entries, how[records], 
+             dirReads, dirSeeks, dirTime, _countedReads, _countedSeeks, 
+             MM_GetMicroSeconds() - start);
+  }
+  unzClose(zip);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ProfileLookups
+// Summary:  Benchmark, times finding each of the given files in the open zip
+//           files using the linear search and the filename index
+// Inputs:   1. List of filenames to look up
+//           2. Number of filenames in list
+// Outputs:  None
+// Returns:  None
+// Cautions: Results are reported as EH_DEBUG messages.  The zip file must be
+//           open.
+//------------------------------------------------------------------------------
+void ZIP_ProfileLookups(const char **names, int count)
+{
+  unsigned int linear, hashed, start;
+  int x, pass;
+  int missed = 0;
+  
+  if (!_openFiles || _index == 0)
+    return;
+  
+  start = MM_GetMicroSeconds();
+  for (pass=0; pass < ZIP_PROFILE_PASSES; pass++)
+    for (x=0; x < count; x++)
+      missed += (FindFileLinear(names[x], &_zipFile) < 0);
+  linear = MM_GetMicroSeconds() - start;
+  
+  start = MM_GetMicroSeconds();
+  for (pass=0; pass < ZIP_PROFILE_PASSES; pass++)
+    for (x=0; x < count; x++)
+      missed += (FindFileHashed(names[x], &_zipFile) < 0);
+  hashed = MM_GetMicroSeconds() - start;
+  
+  EH_Error(EH_DEBUG, "ZIP lookup x%d: linear %uus hashed %uus (%d missed)\n",
+           count * ZIP_PROFILE_PASSES, linear, hashed, missed);
+}
+
+//------------------------------------------------------------------------------
+// Name:     ZIP_ProfileCodecs
+// Summary:  Benchmark, compresses each of the given files with deflate and
+//           with LZ4 (see lbg_pack), then times decompressing them from
+//           memory with inflate and LBG_LZ4Unpack
+// Inputs:   1. List of filenames to load
+//           2. Number of filenames in list
+// Outputs:  None
+// Returns:  None
+// Cautions: Results are reported as EH_DEBUG messages, speeds are in MB/s of
+//           decompressed data.  The zip file must be open.
+//------------------------------------------------------------------------------
+void ZIP_ProfileCodecs(const char **names, int count)
+{
+  unsigned char *data, *packed, *out;
+  unsigned int inflateTime = 0;
+  unsigned int lz4Time     = 0;
+  unsigned int total       = 0;
+  unsigned int deflated    = 0;
+  unsigned int lz4ed       = 0;
+  unsigned int start;
+  z_stream stream;
+  int x, size, bound, packedSize;
+  int bad = 0;
+  
+  if (!_openFiles)
+    return;
+  
+  for (x=0; x < count; x++)
+  {
+    data = (unsigned char *) LoadZipData(names[x], &_zipFile, &size);
+    if (data == NULL)
+      continue;
+    
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                 Z_DEFAULT_STRATEGY);
+    bound = deflateBound(&stream, size);
+    if (bound < LBG_LZ4PackBound(size))
+      bound = LBG_LZ4PackBound(size);
+    packed = (unsigned char *) malloc(bound);
+    out    = (unsigned char *) malloc(size + 1);
+    if (packed == NULL || out == NULL)
+    {
+      deflateEnd(&stream);
+      free(packed);
+      free(out);
+      free(data);
+      continue;
+    }
+    
+    // deflate, as data.lbg is normally packed
+    stream.next_in   = data;
+    stream.avail_in  = size;
+    stream.next_out  = packed;
+    stream.avail_out = bound;
+    deflate(&stream, Z_FINISH);
+    packedSize = stream.total_out;
+    deflateEnd(&stream);
+    
+    start = MM_GetMicroSeconds();
+    memset(&stream, 0, sizeof(stream));
+    inflateInit2(&stream, -MAX_WBITS);
+    stream.next_in   = packed;
+    stream.avail_in  = packedSize;
+    stream.next_out  = out;
+    stream.avail_out = size + 1;
+    inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    inflateTime += MM_GetMicroSeconds() - start;
+    bad         += (stream.total_out != (uLong) size || memcmp(out, data, size));
+    deflated    += packedSize;
+    
+    // LZ4
+    packedSize = LBG_LZ4Pack(data, size, packed, bound);
+    start      = MM_GetMicroSeconds();
+    bad       += (LBG_LZ4Unpack(packed, packedSize, out, size) != size);
+    lz4Time   += MM_GetMicroSeconds() - start;
+    bad       += (memcmp(out, data, size) != 0);
+    lz4ed     += packedSize;
+    
+    total += size;
+    free(packed);
+    free(out);
+    free(data);
+  }
+  
+  EH_Error(EH_DEBUG, "ZIP codecs %uK: inflate %uK %uus %uMB/s, "
+           "lz4 %uK %uus %uMB/s (%d bad)\n", total / 1024,
+           deflated / 1024, inflateTime, total / (inflateTime + 1),
+           lz4ed / 1024, lz4Time, total / (lz4Time + 1), bad);
+}
+#endif
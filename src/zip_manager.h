@@ -3,25 +3,87 @@
 #include "SDL/SDL_mixer.h"
 #include "SDL/SDL_ttf.h"
 
-#define ZIP_MAIN     1
-#define ZIP_LEVEL1   2
+// Zip files opened by ZIP_OpenZipFile, OR them together to open several
+#define ZIP_MAIN     1              // data.lbg, shared by the whole game
+#define ZIP_LEVEL1   2              // level1.lbg, files used only by level 1
+#define ZIP_ALL      (ZIP_MAIN | ZIP_LEVEL1)
+
+#define ZIP_IO_MEMORY 0
+#define ZIP_IO_STDIO  1
+
+// How ZIP_GetImage & ZIP_ReadImage prepare an image, OR them together
+#define ZIP_IMG_SCREEN 1            // convert to the screen's format
+#define ZIP_IMG_TRANSP 2            // use the 0xFF8080 transparent colorkey
 
 #define ZIP_FONT1    "free_sans.ttf"
 #define ZIP_FONT2    "oposs.ttf"
 
+// Fonts are shared, every ZIP_LoadFont of the same file, size & style gets
+// the same ZIP_Font (do not change its style, use ZIP_LoadFontStyle)
 typedef struct ZIP_Font
 {
   TTF_Font *f;
-  void     *d;
+  void     *d;            // font file data, shared by every size & style
+  int      ptSize;
+  int      style;         // TTF_STYLE_xxx
+  unsigned int refs;      // ZIP_LoadFont calls not yet closed
+  struct ZIP_Font *next;  // next font opened
 } ZIP_Font;
 
+typedef struct ZIP_Reader ZIP_Reader;
+
+// Counters kept by the zip manager (see ZIP_GetStats)
+typedef struct ZIP_Stats
+{
+  unsigned int sessions;        // calls to ZIP_OpenZipFile that succeeded
+  unsigned int archiveOpens;    // archives opened & central directories read
+  unsigned int contextsCreated; // read contexts (buffer + inflate) allocated
+  unsigned int contextsReused;  // entries opened with a pooled read context
+  unsigned int cacheHits;       // ZIP_Get... calls served from the cache
+  unsigned int cacheMisses;     // ZIP_Get... calls that had to load the file
+  unsigned int cacheEvictions;  // cached assets freed to stay in budget
+  unsigned int cacheBytes;      // bytes of decoded assets cached right now
+  unsigned int textHits;        // ZIP_RenderText calls served from the cache
+  unsigned int textMisses;      // ZIP_RenderText calls that had to render
+  unsigned int textEvictions;   // rendered strings freed to stay in budget
+  unsigned int textBytes;       // bytes of rendered strings cached right now
+} ZIP_Stats;
+
 
 
 SDL_Surface *ZIP_LoadImage(const char *);
 Mix_Chunk   *ZIP_LoadMusic(const char *name);
 ZIP_Font    *ZIP_LoadFont(const char *name, int ptSize);
 void        ZIP_CloseFont(ZIP_Font *z);
+int         ZIP_Init();
+void        ZIP_Quit();
 int         ZIP_OpenZipFile(unsigned int);
 int         ZIP_CloseZipFile();
+void        ZIP_GetStats(ZIP_Stats *stats);
+int         ZIP_SetIoBackend(int backend);
+int         ZIP_GetIoBackend();
+unsigned int ZIP_GetOpenZipFiles();
+ZIP_Reader  *ZIP_OpenReader();
+void        ZIP_CloseReader(ZIP_Reader *r);
+const char  *ZIP_GetReaderError(ZIP_Reader *r);
+SDL_Surface *ZIP_ReadImage(ZIP_Reader *r, const char *img, int flags);
+Mix_Chunk   *ZIP_ReadMusic(ZIP_Reader *r, const char *name);
+SDL_Surface *ZIP_GetImage(ZIP_Reader *r, const char *img, int flags);
+Mix_Chunk   *ZIP_GetMusic(ZIP_Reader *r, const char *name);
+void        ZIP_ReleaseImage(SDL_Surface *img);
+void        ZIP_ReleaseMusic(Mix_Chunk *sound);
+unsigned int ZIP_SetCacheBudget(unsigned int bytes);
+void        ZIP_FlushCache();
+ZIP_Font    *ZIP_LoadFontStyle(const char *name, int ptSize, int style);
+SDL_Surface *ZIP_RenderText(ZIP_Font *font, const char *text, 
+                            SDL_Color color);
+void        ZIP_ReleaseText(SDL_Surface *img);
+
+#ifdef MM_PROFILE
+#define ZIP_PROFILE_PASSES 10
+void        ZIP_ProfileLookups(const char **names, int count);
+void        ZIP_ProfileDirectory();
+void        ZIP_ProfileCodecs(const char **names, int count);
+#endif
 
 #endif